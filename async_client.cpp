@@ -0,0 +1,200 @@
+//async_client.cpp
+
+#include "async_client.h"
+#include "async_transfer.h"
+#include "event_loop.h"
+#include "http2_multiplexer.h"
+#include "resolver.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/// @brief One event loop thread and the requests it runs.
+/// Other threads only touch the inbox (under the mutex) and the eventfd; everything else belongs
+/// to the loop thread.
+struct AsyncHttpClient::Worker {
+    /// @brief A request to start or cancel, queued for the loop thread.
+    struct Command {
+        uint64_t id;
+        bool cancel;
+        HttpRequest request;
+        Callback onDone;
+        std::chrono::milliseconds deadline;
+        BodySink sink;
+    };
+
+    /// @brief A request in flight.
+    struct Running {
+        std::unique_ptr<AsyncTransfer> transfer;
+        Callback onDone;
+    };
+
+    SSL_CTX* ctx;
+    std::chrono::milliseconds connectTimeout;
+    EventLoop loop;
+    AsyncResolver resolver;
+    Http2Multiplexer multiplexer;
+    int wakeFd;
+    std::mutex mutex;                 ///< Guards inbox and stopping.
+    std::deque<Command> inbox;
+    bool stopping = false;
+    bool stopped = false;             ///< The thread has cancelled everything and may exit.
+    std::map<uint64_t, Running> running;
+    std::vector<uint64_t> finished;   ///< Requests completed during the current loop iteration.
+    std::thread thread;
+
+    Worker(SSL_CTX* ctx, Resolver& dns, std::chrono::milliseconds connectTimeout)
+        : ctx(ctx), connectTimeout(connectTimeout), resolver(loop, dns), multiplexer(loop),
+          wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (wakeFd == -1) {
+            throw std::runtime_error("Failed to create eventfd: " + std::string(strerror(errno)));
+        }
+        loop.add(wakeFd, EPOLLIN, [this](uint32_t) { onWake(); });
+        thread = std::thread(&Worker::run, this);
+    }
+
+    ~Worker() {
+        loop.remove(wakeFd);
+        close(wakeFd);
+    }
+
+    /// @brief Queues a command and wakes the loop.
+    void post(Command command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inbox.push_back(std::move(command));
+        }
+        wake();
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            // The counter can only overflow after 2^64 - 1 unread signals; nothing to do.
+        }
+    }
+
+    /// @brief Tells the thread to cancel everything and exit, and waits for it.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake();
+        thread.join();
+    }
+
+    void run() {
+        while (!stopped) {
+            loop.poll(-1);
+            reap();
+        }
+    }
+
+    /// @brief Runs the queued commands on the loop thread.
+    void onWake() {
+        uint64_t count;
+        if (read(wakeFd, &count, sizeof(count)) < 0) {
+            // EAGAIN: another wakeup already drained the counter.
+        }
+        std::deque<Command> commands;
+        bool stop;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.swap(inbox);
+            stop = stopping;
+        }
+        for (auto& command : commands) {
+            if (command.cancel) {
+                auto it = running.find(command.id);
+                if (it != running.end()) {
+                    it->second.transfer->cancel("Request cancelled");
+                }
+            } else {
+                begin(command);
+            }
+        }
+        if (stop) {
+            for (auto& entry : running) {
+                entry.second.transfer->cancel("Request cancelled");
+            }
+            stopped = true;
+        }
+    }
+
+    void begin(Command& command) {
+        uint64_t id = command.id;
+        auto transfer = std::make_unique<AsyncTransfer>(loop, ctx, resolver, connectTimeout, multiplexer,
+            command.request, [this, id](AsyncTransfer&) { finished.push_back(id); });
+        transfer->setDeadline(command.deadline);
+        transfer->setBodySink(std::move(command.sink));
+        AsyncTransfer* raw = transfer.get();
+        running.emplace(id, Running{std::move(transfer), std::move(command.onDone)});
+        try {
+            raw->start();
+        } catch (const std::exception& e) {
+            raw->cancel(e.what());
+        }
+    }
+
+    /// @brief Reports and destroys the transfers that finished. They complete from inside their own
+    /// handlers, so this only happens once the loop iteration is over.
+    void reap() {
+        std::vector<uint64_t> done;
+        done.swap(finished);
+        for (uint64_t id : done) {
+            auto it = running.find(id);
+            AsyncTransfer& transfer = *it->second.transfer;
+            FetchResult result{transfer.response(), transfer.error(), transfer.bodyBytes(), transfer.elapsed()};
+            Callback onDone = std::move(it->second.onDone);
+            running.erase(it);
+            onDone(result);
+        }
+    }
+};
+
+AsyncHttpClient::AsyncHttpClient(HttpClient& client, size_t threads) {
+    try {
+        for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+            workers.push_back(std::make_unique<Worker>(client.ctx, client.resolver, client.connectTimeout));
+        }
+    } catch (...) {
+        for (auto& worker : workers) {
+            worker->stop();
+        }
+        throw;
+    }
+}
+
+AsyncHttpClient::~AsyncHttpClient() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+}
+
+uint64_t AsyncHttpClient::start(const HttpRequest& request, Callback onDone, std::chrono::milliseconds deadline,
+                               BodySink sink) {
+    uint64_t id = nextId++;
+    workerFor(id).post({id, false, request, std::move(onDone), deadline, std::move(sink)});
+    return id;
+}
+
+AsyncHttpClient::Pending AsyncHttpClient::fetch(const HttpRequest& request, std::chrono::milliseconds deadline,
+                                                BodySink sink) {
+    auto promise = std::make_shared<std::promise<FetchResult>>();
+    std::future<FetchResult> future = promise->get_future();
+    uint64_t id = start(request, [promise](FetchResult& result) { promise->set_value(std::move(result)); }, deadline,
+                        std::move(sink));
+    return Pending{id, std::move(future)};
+}
+
+void AsyncHttpClient::cancel(uint64_t id) {
+    workerFor(id).post({id, true, HttpRequest(), nullptr, std::chrono::milliseconds::zero(), nullptr});
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "http_client.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+/// @brief Non-blocking front end to an HttpClient for embedding in services.
+/// Requests may be started from any thread and return at once; they run as AsyncTransfers on a
+/// small fixed set of worker threads, each with its own epoll loop, so thousands of requests can
+/// be in flight without a thread each. Every request may carry a deadline and can be cancelled.
+/// Configuration (TLS, HTTP/2, DNS cache, connect timeout) comes from the HttpClient, which must
+/// outlive this object.
+class AsyncHttpClient {
+public:
+    /// @brief Receives the outcome of a request, on one of the worker threads. It must not throw,
+    /// and should hand off any lengthy work since it holds up the other requests of its thread.
+    using Callback = std::function<void(FetchResult& result)>;
+
+    /// @brief A request started with fetch().
+    struct Pending {
+        uint64_t id;                      ///< Identifies the request for cancel().
+        std::future<FetchResult> result;  ///< Becomes ready when the request finishes, fails or is cancelled.
+    };
+
+    /// @brief Starts the worker threads.
+    /// @param client Supplies the TLS context, resolver and connect timeout.
+    /// @param threads Number of event loop threads; requests are spread across them round-robin.
+    AsyncHttpClient(HttpClient& client, size_t threads = 1);
+
+    /// @brief Cancels the requests still running (their callbacks report it) and stops the threads.
+    ~AsyncHttpClient();
+
+    AsyncHttpClient(const AsyncHttpClient&) = delete;
+    AsyncHttpClient& operator=(const AsyncHttpClient&) = delete;
+
+    /// @brief Starts a request and reports its result to a callback.
+    /// @param request The request; a body is written to `request.outputFile` if one is set.
+    /// @param onDone Called once with the result.
+    /// @param deadline Limit for the whole request, from when it starts until its body is complete; zero for none.
+    /// @param sink If set, receives the body on the worker thread as it arrives, and the result's body stays empty.
+    /// @return The request id, for cancel().
+    uint64_t start(const HttpRequest& request, Callback onDone,
+                   std::chrono::milliseconds deadline = std::chrono::milliseconds::zero(), BodySink sink = nullptr);
+
+    /// @brief Starts a request whose result is delivered through a future.
+    Pending fetch(const HttpRequest& request, std::chrono::milliseconds deadline = std::chrono::milliseconds::zero(),
+                  BodySink sink = nullptr);
+
+    /// @brief Cancels a request that has not finished; it then completes with the error "Request cancelled".
+    /// Ids of finished requests are ignored.
+    void cancel(uint64_t id);
+
+private:
+    struct Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint64_t> nextId{1};
+
+    /// @brief Returns the worker that runs request `id`.
+    Worker& workerFor(uint64_t id) { return *workers[id % workers.size()]; }
+};
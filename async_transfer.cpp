@@ -0,0 +1,381 @@
+//async_transfer.cpp
+
+#include "async_transfer.h"
+#include "io_util.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+
+AsyncTransfer::AsyncTransfer(EventLoop& loop, SSL_CTX* ctx, AsyncResolver& resolver,
+                             std::chrono::milliseconds connectTimeout, Http2Multiplexer& multiplexer,
+                             const HttpRequest& request, DoneCallback onDone)
+    : loop(loop), ctx(ctx), resolver(resolver), connector(loop, connectionAttemptDelay, connectTimeout),
+      multiplexer(multiplexer), request(request), originKey(ConnectionPool::originKey(request.url)),
+      onDone(std::move(onDone)),
+      parser(resp, [this](const char* data, size_t length) { onBody(data, length); }) {
+    parser.setHeadersCallback([this]() { onHeaders(); });
+    parser.setNoBody(this->request.method == HttpMethod::HEAD);
+}
+
+AsyncTransfer::~AsyncTransfer() {
+    if (outFd != -1) {
+        close(outFd);
+    }
+}
+
+void AsyncTransfer::useConnection(std::unique_ptr<Connection> idle) {
+    conn.sock = idle->sock;
+    conn.ssl = idle->ssl;
+    conn.requestsServed = idle->requestsServed;
+    idle->sock = -1;
+    idle->ssl = nullptr;
+    reusing = true;
+}
+
+std::unique_ptr<Connection> AsyncTransfer::takeConnection() {
+    if (!kept) {
+        return nullptr;
+    }
+    kept = false;
+    auto idle = std::make_unique<Connection>();
+    idle->origin = originKey;
+    idle->sock = conn.sock;
+    idle->ssl = conn.ssl;
+    idle->requestsServed = conn.requestsServed;
+    conn.sock = -1;
+    conn.ssl = nullptr;
+    return idle;
+}
+
+void AsyncTransfer::start() {
+    if (!keepAlive) {
+        // The connection is not reused, so let the server know it need not keep it open.
+        request.headers["Connection"] = "close";
+    }
+    serialized = std::make_unique<SerializedRequest>(request);
+    resp.timing.start = std::chrono::steady_clock::now();
+    if (deadline.count() > 0) {
+        deadlineTimer = loop.addTimer(static_cast<int>(deadline.count()), [this] {
+            deadlineTimer = -1;
+            cancel("Request timed out after " + std::to_string(deadline.count()) + " ms");
+        });
+    }
+    if (!request.outputFile.empty()) {
+        outFd = open(request.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (outFd == -1) {
+            finish("Failed to open output file: " + request.outputFile);
+            return;
+        }
+    }
+
+    if (reusing) {
+        resp.timing.nameLookup = resp.timing.connect = resp.timing.tlsHandshake = resp.timing.elapsed();
+        resp.timing.connectionReused = true;
+        loop.add(conn.sock, EPOLLOUT, [this](uint32_t events) { onEvents(events); });
+        state = State::Sending;
+        sendRequest();
+        return;
+    }
+    if (request.url.protocol == "https" && multiplexer.join(*this)) {
+        if (state == State::Idle) {
+            state = State::Waiting;
+        }
+        return;
+    }
+    connect();
+}
+
+void AsyncTransfer::connect() {
+    state = State::Resolving;
+    // A cancelled transfer may be gone by the time a slow lookup completes.
+    std::weak_ptr<bool> token = alive;
+    resolver.resolve(request.url.host, request.url.port,
+        [this, token](const std::vector<ResolvedAddress>& addresses, const std::string& error) {
+            if (token.expired() || state != State::Resolving) {
+                return;
+            }
+            if (!error.empty()) {
+                finish(error);
+                return;
+            }
+            resp.timing.nameLookup = resp.timing.elapsed();
+            state = State::Connecting;
+            connector.start(addresses, [this](int sock, const std::string& error) {
+                if (sock == -1) {
+                    finish(error);
+                } else {
+                    onConnected(sock);
+                }
+            });
+        });
+}
+
+uint32_t AsyncTransfer::attachStream(Http2Session& session, bool reused) {
+    if (reused) {
+        resp.timing.nameLookup = resp.timing.connect = resp.timing.tlsHandshake = resp.timing.elapsed();
+        resp.timing.connectionReused = true;
+    }
+    state = State::Streaming;
+    Http2Session::StreamHandler handler;
+    // Decoding errors end this stream only, never the connection it shares.
+    handler.onHeaders = [this]() {
+        resp.timing.firstByte = resp.timing.elapsed();
+        try {
+            onHeaders();
+        } catch (const std::exception& e) {
+            finish(e.what());
+        }
+    };
+    handler.onData = [this](const char* data, size_t length) {
+        try {
+            onBody(data, length);
+        } catch (const std::exception& e) {
+            finish(e.what());
+        }
+    };
+    handler.onClose = [this](const std::string& error) {
+        if (error.empty() && decoder) {
+            try {
+                decoder->finish();
+            } catch (const std::exception& e) {
+                finish(e.what());
+                return;
+            }
+        }
+        finish(error);
+    };
+    uint32_t streamId = session.submit(request, resp, std::move(handler));
+    resp.timing.requestSent = resp.timing.elapsed();
+    return streamId;
+}
+
+void AsyncTransfer::onHeaders() {
+    if (request.compressed) {
+        decoder = ContentDecoder::create(std::string(resp.headers.get(KnownHeader::ContentEncoding)),
+                                         [this](const char* data, size_t length) { deliver(data, length); });
+    }
+}
+
+void AsyncTransfer::onBody(const char* data, size_t length) {
+    resp.bodyBytes += length;
+    if (decoder) {
+        decoder->decode(data, length);
+    } else {
+        deliver(data, length);
+    }
+}
+
+void AsyncTransfer::deliver(const char* data, size_t length) {
+    if (outFd != -1) {
+        writeAll(outFd, data, length);
+    } else if (sink) {
+        sink(data, length);
+    } else if (!discardBody) {
+        resp.body.append(data, length);
+    }
+}
+
+void AsyncTransfer::onEvents(uint32_t) {
+    switch (state) {
+        case State::Handshaking: handshake();     break;
+        case State::Sending:     sendRequest();   break;
+        case State::Receiving:   receive();       break;
+        default: break;
+    }
+}
+
+void AsyncTransfer::onConnected(int sock) {
+    conn.sock = sock;
+    resp.timing.connect = resp.timing.elapsed();
+    loop.add(conn.sock, EPOLLOUT, [this](uint32_t events) { onEvents(events); });
+
+    if (request.url.protocol != "https") {
+        state = State::Sending;
+        sendRequest();
+        return;
+    }
+
+    conn.ssl = SSL_new(ctx);
+    if (!conn.ssl) {
+        finish("Failed to create SSL structure");
+        return;
+    }
+    SSL_set_fd(conn.ssl, conn.sock);
+    SSL_set_tlsext_host_name(conn.ssl, request.url.host.c_str());
+    // Checked by OpenSSL during the handshake, which fails on a mismatch.
+    SSL_set1_host(conn.ssl, request.url.host.c_str());
+    TlsSessionCache::prepare(conn.ssl, originKey);
+    state = State::Handshaking;
+    handshake();
+}
+
+bool AsyncTransfer::waitForSSL(int result) {
+    switch (SSL_get_error(conn.ssl, result)) {
+        case SSL_ERROR_WANT_READ:
+            loop.modify(conn.sock, EPOLLIN);
+            return true;
+        case SSL_ERROR_WANT_WRITE:
+            loop.modify(conn.sock, EPOLLOUT);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void AsyncTransfer::handshake() {
+    int rc = SSL_connect(conn.ssl);
+    if (rc == 1) {
+        if (SSL_get_verify_result(conn.ssl) != X509_V_OK) {
+            finish("SSL Certificate Verification Failed");
+            return;
+        }
+        resp.timing.tlsHandshake = resp.timing.elapsed();
+        if (multiplexer.negotiated(*this, conn)) {
+            return; // Now a stream on the connection, which the multiplexer took over.
+        }
+        state = State::Sending;
+        sendRequest();
+        return;
+    }
+    if (!waitForSSL(rc)) {
+        finish("Failed to establish SSL connection: " + std::string(ERR_error_string(ERR_get_error(), nullptr)));
+    }
+}
+
+void AsyncTransfer::sendRequest() {
+    if (conn.ssl) {
+        if (tlsPlan.empty() && sent == 0) {
+            tlsPlan = serialized->tlsSegments(tlsStorage);
+        }
+        while (!tlsPlan.empty()) {
+            // After WANT_READ/WANT_WRITE, SSL_write must be repeated with the same buffer.
+            int n = SSL_write(conn.ssl, tlsPlan.front().data(), static_cast<int>(tlsPlan.front().size()));
+            if (n <= 0) {
+                if (!waitForSSL(n)) {
+                    finish("Failed to send Request!");
+                }
+                return;
+            }
+            sent += n;
+            tlsPlan.erase(tlsPlan.begin());
+        }
+    } else {
+        while (sent < serialized->size()) {
+            ssize_t n = serialized->send(conn.sock, sent);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    loop.modify(conn.sock, EPOLLOUT);
+                } else if (errno != EINTR) {
+                    finish("Failed to send Request!");
+                }
+                if (errno != EINTR) {
+                    return;
+                }
+                continue;
+            }
+            sent += n;
+        }
+    }
+    resp.timing.requestSent = resp.timing.elapsed();
+    state = State::Receiving;
+    loop.modify(conn.sock, EPOLLIN);
+    receive();
+}
+
+void AsyncTransfer::receive() {
+    char buffer[16384];
+    try {
+        while (!parser.done()) {
+            int n;
+            if (conn.ssl) {
+                n = SSL_read(conn.ssl, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    if (SSL_get_error(conn.ssl, n) != SSL_ERROR_ZERO_RETURN) {
+                        if (!waitForSSL(n)) {
+                            finish("SSL error: " + std::string(ERR_error_string(ERR_get_error(), nullptr)));
+                        }
+                        return;
+                    }
+                    n = 0;
+                }
+            } else {
+                n = recv(conn.sock, buffer, sizeof(buffer), 0);
+                if (n < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        finish("Failed to receive response: " + std::string(strerror(errno)));
+                    }
+                    return;
+                }
+            }
+            if (n == 0) {
+                parser.finish();
+                break;
+            }
+            if (resp.timing.firstByte.count() == 0) {
+                resp.timing.firstByte = resp.timing.elapsed();
+            }
+            parser.feed(buffer, n);
+        }
+        if (decoder) {
+            decoder->finish();
+        }
+    } catch (const std::exception& e) {
+        finish(e.what());
+        return;
+    }
+    finish("");
+}
+
+void AsyncTransfer::cancel(const std::string& reason) {
+    if (state == State::Done) {
+        return;
+    }
+    connector.cancel();
+    finish(reason);
+}
+
+void AsyncTransfer::finish(const std::string& error) {
+    if (state == State::Done) {
+        return;
+    }
+    state = State::Done;
+    if (deadlineTimer != -1) {
+        loop.cancelTimer(deadlineTimer);
+        deadlineTimer = -1;
+    }
+    resp.timing.total = resp.timing.elapsed();
+    err = error;
+    multiplexer.leave(*this);
+    if (outFd != -1) {
+        // Delayed write errors (e.g. on NFS) surface only here.
+        if (close(outFd) == -1 && err.empty()) {
+            err = "Failed to write output file: " + std::string(strerror(errno));
+        }
+        outFd = -1;
+    }
+    if (conn.sock != -1) {
+        loop.remove(conn.sock);
+    }
+    if (error.empty() && keepAlive && conn.sock != -1 && parser.keepAlive()) {
+        // Left for takeConnection(); otherwise it closes with the transfer.
+        conn.requestsServed++;
+        kept = true;
+    }
+    // Release the socket now rather than when the transfer is destroyed, so that a long
+    // list of fetches never holds more descriptors open than are in flight.
+    if (!kept && conn.ssl) {
+        SSL_free(conn.ssl);
+        conn.ssl = nullptr;
+    }
+    if (!kept && conn.sock != -1) {
+        close(conn.sock);
+        conn.sock = -1;
+    }
+    if (onDone) {
+        onDone(*this);
+    }
+}
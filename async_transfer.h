@@ -0,0 +1,170 @@
+#pragma once
+#include "http_client.h"
+#include "connection_pool.h"
+#include "content_decoder.h"
+#include "event_loop.h"
+#include "happy_eyeballs.h"
+#include "http2_multiplexer.h"
+#include "http2_session.h"
+#include "resolver.h"
+#include "response_parser.h"
+#include "request_serializer.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <openssl/ssl.h>
+
+/// @brief A single HTTP request driven to completion by an EventLoop on a non-blocking socket.
+/// The transfer walks through name resolution, connect, TLS handshake, request write and response read,
+/// each step resuming whenever the loop reports the lookup finished or the socket ready. HTTPS transfers
+/// may instead run as a stream on an HTTP/2 connection shared through an Http2Multiplexer.
+class AsyncTransfer {
+public:
+    using DoneCallback = std::function<void(AsyncTransfer&)>;
+
+    /// @brief Prepares a transfer; nothing happens until start() is called.
+    /// @param loop The event loop that drives the socket.
+    /// @param ctx The SSL context used for HTTPS requests.
+    /// @param resolver Resolves the host without blocking the loop.
+    /// @param connectTimeout Limit for establishing the TCP connection.
+    /// @param multiplexer Shares HTTP/2 connections with the other transfers on the loop.
+    /// @param request The request to send. Over HTTP/1.1 it is sent with "Connection: close" unless
+    /// setKeepAlive() asks for the connection to be kept.
+    /// @param onDone Called once when the transfer has succeeded or failed.
+    AsyncTransfer(EventLoop& loop, SSL_CTX* ctx, AsyncResolver& resolver, std::chrono::milliseconds connectTimeout,
+                  Http2Multiplexer& multiplexer, const HttpRequest& request, DoneCallback onDone);
+
+    /// @brief Closes the output file if the transfer never finished.
+    ~AsyncTransfer();
+
+    AsyncTransfer(const AsyncTransfer&) = delete;
+    AsyncTransfer& operator=(const AsyncTransfer&) = delete;
+
+    /// @brief Starts the transfer: HTTPS requests first try to join an HTTP/2 connection to the origin,
+    /// otherwise the host is resolved and connected.
+    void start();
+
+    /// @brief Resolves the host and connects on a connection of the transfer's own.
+    void connect();
+
+    /// @brief Sends the request as a stream on a shared HTTP/2 connection; the response and completion
+    /// are delivered by the session.
+    /// @param session The connection's session.
+    /// @param reused True if the connection was established by another transfer.
+    /// @return The stream id.
+    uint32_t attachStream(Http2Session& session, bool reused);
+
+    /// @brief Returns the request as it is sent.
+    const HttpRequest& sentRequest() const { return request; }
+
+    /// @brief Returns the pool key of the request's origin.
+    const std::string& origin() const { return originKey; }
+
+    /// @brief Returns the response; complete only once the transfer is done without error.
+    const HttpResponse& response() const { return resp; }
+
+    /// @brief Returns the error message, or an empty string if the transfer succeeded.
+    const std::string& error() const { return err; }
+
+    /// @brief Returns the number of decoded body bytes received so far.
+    uint64_t bodyBytes() const { return resp.bodyBytes; }
+
+    /// @brief Returns the time from start() until the transfer finished.
+    std::chrono::microseconds elapsed() const { return resp.timing.total; }
+
+    /// @brief Counts the body without keeping it, unless it goes to an output file.
+    void setDiscardBody(bool discard) { discardBody = discard; }
+
+    /// @brief Hands the decoded body to `sink` as it arrives instead of keeping it in the response.
+    /// An output file still takes precedence.
+    void setBodySink(BodySink sink) { this->sink = std::move(sink); }
+
+    /// @brief Limits the whole transfer, from start() to the end of the body, to `deadline`
+    /// (zero for no limit). Must be called before start().
+    void setDeadline(std::chrono::milliseconds deadline) { this->deadline = deadline; }
+
+    /// @brief Sends the request without "Connection: close", so that a successful HTTP/1.1 response
+    /// that leaves the connection open lets the owner take it with takeConnection(). Must be called
+    /// before start().
+    void setKeepAlive(bool keep) { keepAlive = keep; }
+
+    /// @brief Sends the request on an idle keep-alive connection to the same origin, taken from an
+    /// earlier transfer, instead of connecting. Must be called before start().
+    void useConnection(std::unique_ptr<Connection> idle);
+
+    /// @brief Returns the transfer's connection if the transfer kept it (see setKeepAlive()) and it may
+    /// carry another request; otherwise null. The connection is no longer registered with the loop.
+    std::unique_ptr<Connection> takeConnection();
+
+    /// @brief Abandons the transfer in whatever state it is in and reports `reason` as its error.
+    /// Does nothing once the transfer is done.
+    void cancel(const std::string& reason);
+
+private:
+    enum class State {
+        Idle,        ///< Not started.
+        Waiting,     ///< Waiting for another transfer to negotiate the protocol with the origin.
+        Resolving,   ///< Waiting for the host name lookup.
+        Connecting,  ///< Racing connection attempts to the resolved addresses.
+        Handshaking, ///< Waiting for SSL_connect to complete.
+        Sending,     ///< Writing the request.
+        Receiving,   ///< Reading the response.
+        Streaming,   ///< Running as a stream on a shared HTTP/2 connection.
+        Done         ///< Finished, successfully or not.
+    };
+
+    EventLoop& loop;
+    SSL_CTX* ctx;
+    AsyncResolver& resolver;
+    AsyncConnector connector; ///< Happy Eyeballs connect; hands over the winning socket.
+    Http2Multiplexer& multiplexer;
+    HttpRequest request;
+    std::string originKey;    ///< Pool key of the request's origin.
+    DoneCallback onDone;
+    State state = State::Idle;
+    Connection conn;          ///< The socket and TLS session of this transfer.
+    std::unique_ptr<SerializedRequest> serialized; ///< The request as scatter-gather buffers over `request`.
+    size_t sent = 0;          ///< Bytes of the request written so far (plain TCP).
+    std::string tlsStorage;   ///< Coalesced bytes for TLS writes.
+    std::vector<std::string_view> tlsPlan; ///< Remaining TLS writes; the front one is retried until it succeeds.
+    HttpResponse resp;
+    HttpResponseParser parser; ///< Parses the response as it arrives.
+    std::unique_ptr<ContentDecoder> decoder; ///< Undoes the response's Content-Encoding, if requested.
+    int outFd = -1;            ///< Destination of the body when the request has an output file, or -1.
+    bool discardBody = false;  ///< Drop body bytes that are not written to a file.
+    BodySink sink;             ///< Receives the body when set and there is no output file.
+    std::chrono::milliseconds deadline{0}; ///< Limit for the whole transfer, zero for none.
+    int deadlineTimer = -1;    ///< Timer enforcing the deadline, or -1.
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true); ///< Expires with the transfer, for late resolver results.
+    bool keepAlive = false;    ///< Leave the connection open after a complete keep-alive response.
+    bool reusing = false;      ///< The connection was handed over by useConnection().
+    bool kept = false;         ///< The transfer finished and `conn` is idle, ready for another request.
+    std::string err;
+
+    /// @brief Counts a piece of the body and passes it on, through the content decoder if there is one.
+    void onBody(const char* data, size_t length);
+
+    /// @brief Delivers a piece of the decoded body to the output file or the response.
+    void deliver(const char* data, size_t length);
+
+    /// @brief Sets up content decoding once the response headers are known.
+    /// @throws std::runtime_error if the Content-Encoding is not supported.
+    void onHeaders();
+
+    /// @brief Dispatches socket readiness to the handler for the current state.
+    void onEvents(uint32_t events);
+
+    /// @brief Takes over the connected socket and starts TLS or sends the request.
+    void onConnected(int sock);
+    void handshake();
+    void sendRequest();
+    void receive();
+
+    /// @brief Updates the epoll interest from an SSL_ERROR_WANT_READ/WRITE result.
+    /// @return True if the operation should be retried later, false on a real error.
+    bool waitForSSL(int result);
+
+    /// @brief Unregisters and closes the socket, records the error (if any) and reports completion.
+    void finish(const std::string& error);
+};
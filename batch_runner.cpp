@@ -0,0 +1,173 @@
+//batch_runner.cpp
+
+#include "batch_runner.h"
+#include "json.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+/// @brief What a result line needs to know about the spec it answers.
+struct PendingSpec {
+    size_t line;
+    std::string id;
+    std::string method;
+    std::string url;
+};
+
+/// @brief Returns a string member, "" if it is absent.
+/// @throws std::runtime_error if the member is present but not a string.
+std::string stringField(const JsonValue& spec, const char* name) {
+    const JsonValue* value = spec.find(name);
+    if (!value) {
+        return "";
+    }
+    if (value->type != JsonValue::Type::String) {
+        throw std::runtime_error(std::string("\"") + name + "\" must be a string");
+    }
+    return value->text;
+}
+
+/// @brief Formats when each phase of a request finished, in milliseconds from its start.
+std::string phasesJson(const TransferTiming& timing) {
+    char text[192];
+    snprintf(text, sizeof(text),
+             "{\"namelookup\":%.3f,\"connect\":%.3f,\"appconnect\":%.3f,\"pretransfer\":%.3f,\"starttransfer\":%.3f}",
+             timing.nameLookup.count() / 1000.0, timing.connect.count() / 1000.0, timing.tlsHandshake.count() / 1000.0,
+             timing.requestSent.count() / 1000.0, timing.firstByte.count() / 1000.0);
+    return text;
+}
+
+/// @brief Formats the common leading members of a result line.
+std::string resultPrefix(size_t line, const std::string& id) {
+    std::string text = "{\"line\":" + std::to_string(line);
+    if (!id.empty()) {
+        text += ",\"id\":" + id;
+    }
+    return text;
+}
+
+} // namespace
+
+BatchRunner::BatchRunner(HttpClient& client, const HttpRequest& defaults) : client(client), defaults(defaults) {}
+
+HttpRequest BatchRunner::parseSpec(const std::string& line, std::string& id) const {
+    JsonValue spec = parseJson(line);
+    if (spec.type != JsonValue::Type::Object) {
+        throw std::runtime_error("Request spec must be a JSON object");
+    }
+
+    if (const JsonValue* value = spec.find("id")) {
+        if (value->type == JsonValue::Type::String) {
+            id = jsonQuote(value->text);
+        } else if (value->type == JsonValue::Type::Number) {
+            id = value->text;
+        } else {
+            throw std::runtime_error("\"id\" must be a string or a number");
+        }
+    }
+
+    HttpRequest request = defaults;
+    std::string url = stringField(spec, "url");
+    if (url.empty()) {
+        throw std::runtime_error("\"url\" is required");
+    }
+    request.url = UrlParser::parse(url);
+
+    std::string method = stringField(spec, "method");
+    std::transform(method.begin(), method.end(), method.begin(), ::toupper);
+    if (!method.empty()) {
+        auto it = StringToHttpMethod.find(method);
+        if (it == StringToHttpMethod.end()) {
+            throw std::runtime_error("Unsupported HTTP method: " + method);
+        }
+        request.method = it->second;
+    }
+
+    if (const JsonValue* headers = spec.find("headers")) {
+        if (headers->type == JsonValue::Type::Object) {
+            for (const auto& field : headers->fields) {
+                if (field.second.type != JsonValue::Type::String) {
+                    throw std::runtime_error("Header values must be strings");
+                }
+                request.headers[field.first] = field.second.text;
+            }
+        } else if (headers->type == JsonValue::Type::Array) {
+            for (const auto& item : headers->items) {
+                size_t colon = item.type == JsonValue::Type::String ? item.text.find(':') : std::string::npos;
+                if (colon == std::string::npos) {
+                    throw std::runtime_error("Headers must be \"Name: value\" strings");
+                }
+                size_t valueStart = item.text.find_first_not_of(" \t", colon + 1);
+                request.headers[item.text.substr(0, colon)] =
+                    valueStart == std::string::npos ? "" : item.text.substr(valueStart);
+            }
+        } else {
+            throw std::runtime_error("\"headers\" must be an object or an array");
+        }
+    }
+
+    if (spec.find("data")) {
+        request.data = stringField(spec, "data");
+    }
+    request.outputFile = stringField(spec, "output");
+    return request;
+}
+
+size_t BatchRunner::run(std::istream& in, std::ostream& out, size_t maxConcurrent) {
+    std::unordered_map<size_t, PendingSpec> pending; // By fetch index
+    size_t lineNumber = 0;
+    size_t index = 0;
+    size_t failures = 0;
+
+    client.fetchEach(
+        [&](HttpRequest& request) {
+            std::string line;
+            while (std::getline(in, line)) {
+                ++lineNumber;
+                if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+                std::string id;
+                try {
+                    request = parseSpec(line, id);
+                } catch (const std::exception& e) {
+                    ++failures;
+                    out << resultPrefix(lineNumber, id) << ",\"error\":" << jsonQuote(e.what()) << "}" << std::endl;
+                    continue;
+                }
+                pending[index++] = {lineNumber, id, HttpMethodToString.at(request.method),
+                                    request.url.protocol + "://" + request.url.authority() + request.url.target()};
+                return true;
+            }
+            return false;
+        },
+        [&](size_t fetchIndex, FetchResult& result) {
+            auto it = pending.find(fetchIndex);
+            const PendingSpec& spec = it->second;
+            char timing[32];
+            snprintf(timing, sizeof(timing), "%.3f", result.elapsed.count() / 1000.0);
+
+            out << resultPrefix(spec.line, spec.id) << ",\"method\":" << jsonQuote(spec.method)
+                << ",\"url\":" << jsonQuote(spec.url);
+            if (result.error.empty()) {
+                out << ",\"status\":" << result.response.statusCode;
+            } else {
+                ++failures;
+            }
+            out << ",\"bytes\":" << result.bodyBytes << ",\"time_ms\":" << timing;
+            if (result.error.empty()) {
+                out << ",\"phases_ms\":" << phasesJson(result.response.timing);
+            }
+            if (!result.error.empty()) {
+                out << ",\"error\":" << jsonQuote(result.error);
+            }
+            out << "}" << std::endl;
+            pending.erase(it);
+        },
+        maxConcurrent, false);
+    return failures;
+}
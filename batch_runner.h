@@ -0,0 +1,35 @@
+#pragma once
+#include "http_client.h"
+#include <istream>
+#include <ostream>
+#include <string>
+
+/// @brief Runs a stream of JSONL request specs through HttpClient::fetchEach().
+/// Each non-blank input line is an object such as
+/// `{"id": 1, "method": "POST", "url": "https://example.com/", "headers": {"X-A": "1"}, "data": "...", "output": "file"}`
+/// where only "url" is required. "headers" may also be an array of "Name: value" strings. For every
+/// line one JSON object is written with the line number, the echoed id, the status code, the body size
+/// and the elapsed time with its per-phase breakdown, or an error. Results are written in completion order.
+class BatchRunner {
+public:
+    /// @brief Creates a runner.
+    /// @param client The client whose connection settings, resolver and TLS context are used.
+    /// @param defaults Method, headers and data applied to every spec before its own fields.
+    BatchRunner(HttpClient& client, const HttpRequest& defaults);
+
+    /// @brief Reads specs from `in` as transfer slots free up and writes result lines to `out`.
+    /// @param in The JSONL input.
+    /// @param out Receives one JSON object per line, flushed as each request completes.
+    /// @param maxConcurrent Maximum number of requests in flight at once.
+    /// @return The number of lines that failed (invalid spec or failed request).
+    size_t run(std::istream& in, std::ostream& out, size_t maxConcurrent);
+
+private:
+    HttpClient& client;
+    HttpRequest defaults;
+
+    /// @brief Builds a request from one spec line.
+    /// @param id Receives the spec's "id" as JSON text, or "" if it has none.
+    /// @throws std::runtime_error if the line is not a valid spec.
+    HttpRequest parseSpec(const std::string& line, std::string& id) const;
+};
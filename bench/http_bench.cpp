@@ -0,0 +1,307 @@
+//http_bench.cpp
+
+#include "async_client.h"
+#include "content_decoder.h"
+#include "hpack.h"
+#include "http_client.h"
+#include "loopback_server.h"
+#include "request_serializer.h"
+#include "response_parser.h"
+#include "uring_transfer.h"
+#include "url_parser.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+/// @brief Size of the reads the client does from a socket, used to slice responses fed to the parser.
+const size_t readSize = 16384;
+
+/// @brief Builds a request with `headerCount` custom headers of realistic length.
+HttpRequest makeRequest(int headerCount, size_t bodySize) {
+    HttpRequest request;
+    request.method = bodySize > 0 ? HttpMethod::POST : HttpMethod::GET;
+    request.url = UrlParser::parse("https://api.example.com:8443/v1/items/12345?include=owner&page=2");
+    request.headers["Accept"] = "*/*";
+    for (int i = 0; i < headerCount; ++i) {
+        request.headers["X-Custom-Header-" + std::to_string(i)] = "value-" + std::to_string(i) + "-abcdefghijklmnop";
+    }
+    request.data.assign(bodySize, 'd');
+    return request;
+}
+
+/// @brief Builds a response head with `headerCount` headers after the framing header.
+std::string makeHead(int headerCount, const std::string& framing) {
+    std::string head = "HTTP/1.1 200 OK\r\n" + framing + "\r\n";
+    for (int i = 0; i < headerCount; ++i) {
+        head += "X-Response-Header-" + std::to_string(i) + ": some-typical-header-value-" + std::to_string(i) + "\r\n";
+    }
+    return head + "\r\n";
+}
+
+/// @brief Encodes a body as 16 KiB chunks plus the last-chunk.
+std::string chunkedBody(size_t size) {
+    std::string encoded;
+    for (size_t offset = 0; offset < size; offset += readSize) {
+        size_t length = std::min(readSize, size - offset);
+        char sizeLine[32];
+        snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", length);
+        encoded += sizeLine;
+        encoded.append(length, 'b');
+        encoded += "\r\n";
+    }
+    return encoded + "0\r\n\r\n";
+}
+
+/// @brief Feeds a whole response to a fresh parser in socket-sized slices, as the client does.
+void parseResponse(const std::string& wire, benchmark::State& state) {
+    HttpResponse response;
+    uint64_t bodyBytes = 0;
+    HttpResponseParser parser(response, [&bodyBytes](const char*, size_t length) { bodyBytes += length; });
+    for (size_t offset = 0; offset < wire.size() && !parser.done(); offset += readSize) {
+        parser.feed(wire.data() + offset, std::min(readSize, wire.size() - offset));
+    }
+    if (!parser.done()) {
+        state.SkipWithError("Response not complete");
+    }
+    benchmark::DoNotOptimize(bodyBytes);
+}
+
+void BM_GenerateRequest(benchmark::State& state) {
+    HttpRequest request = makeRequest(static_cast<int>(state.range(0)), static_cast<size_t>(state.range(1)));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string wire = HttpClient::generateRequest(request);
+        bytes += wire.size();
+        benchmark::DoNotOptimize(wire);
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_GenerateRequest)
+    ->ArgNames({"headers", "body"})
+    ->Args({0, 0})->Args({8, 0})->Args({32, 0})->Args({8, 64 << 10})->Args({8, 1 << 20});
+
+void BM_SerializeRequestSharedHeaders(benchmark::State& state) {
+    HttpRequest request = makeRequest(static_cast<int>(state.range(0)), static_cast<size_t>(state.range(1)));
+    request.sharedHeaders = std::make_shared<const HeaderBlock>(request.headers);
+    request.headers.clear();
+    size_t bytes = 0;
+    for (auto _ : state) {
+        SerializedRequest serialized(request);
+        bytes += serialized.size();
+        benchmark::DoNotOptimize(&serialized);
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SerializeRequestSharedHeaders)
+    ->ArgNames({"headers", "body"})
+    ->Args({0, 0})->Args({8, 0})->Args({32, 0})->Args({8, 64 << 10})->Args({8, 1 << 20});
+
+void BM_HpackEncodeDecode(benchmark::State& state) {
+    std::vector<HeaderField> fields = {
+        {":method", "GET"}, {":scheme", "https"}, {":authority", "example.com"}, {":path", "/index.html"},
+        {"accept", "*/*"}, {"user-agent", "lurc"}};
+    for (int i = 0; i < state.range(0); ++i) {
+        fields.emplace_back("x-custom-" + std::to_string(i), "value-" + std::to_string(i));
+    }
+    // One encoder/decoder pair per connection, so the dynamic table warms up as it would over many requests.
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    std::string block;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        block.clear();
+        encoder.encode(fields, block);
+        std::vector<HeaderField> decoded = decoder.decode(block.data(), block.size());
+        bytes += block.size();
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_HpackEncodeDecode)->ArgName("headers")->Arg(0)->Arg(8)->Arg(32);
+
+void BM_DecodeGzipBody(benchmark::State& state) {
+    // JSON-like text compresses about as well as typical API responses.
+    std::string plain;
+    for (size_t i = 0; plain.size() < static_cast<size_t>(state.range(0)); ++i) {
+        plain += "{\"id\": " + std::to_string(i) + ", \"name\": \"item-" + std::to_string(i) + "\", \"ok\": true}\n";
+    }
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string compressed(deflateBound(&stream, plain.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&plain[0]);
+    stream.avail_in = static_cast<uInt>(plain.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    for (auto _ : state) {
+        uint64_t decoded = 0;
+        auto decoder = ContentDecoder::create("gzip", [&decoded](const char*, size_t length) { decoded += length; });
+        for (size_t offset = 0; offset < compressed.size(); offset += readSize) {
+            decoder->decode(compressed.data() + offset, std::min(readSize, compressed.size() - offset));
+        }
+        decoder->finish();
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * plain.size()));
+}
+BENCHMARK(BM_DecodeGzipBody)->ArgName("body")->Arg(64 << 10)->Arg(1 << 20);
+
+void BM_ParseResponseHeaders(benchmark::State& state) {
+    std::string wire = makeHead(static_cast<int>(state.range(0)), "Content-Length: 0");
+    for (auto _ : state) {
+        parseResponse(wire, state);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * wire.size()));
+}
+BENCHMARK(BM_ParseResponseHeaders)->ArgName("headers")->Arg(4)->Arg(16)->Arg(64);
+
+void BM_HeaderLookup(benchmark::State& state) {
+    std::string wire = makeHead(static_cast<int>(state.range(0)), "Content-Length: 0");
+    HttpResponse response;
+    HttpResponseParser parser(response, [](const char*, size_t) {});
+    parser.feed(wire.data(), wire.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(response.headers.get(KnownHeader::ContentLength));
+        benchmark::DoNotOptimize(response.headers.get("content-type"));
+        benchmark::DoNotOptimize(response.headers.get("x-response-header-0"));
+    }
+}
+BENCHMARK(BM_HeaderLookup)->ArgName("headers")->Arg(4)->Arg(16)->Arg(64);
+
+void BM_ParseContentLengthBody(benchmark::State& state) {
+    size_t size = static_cast<size_t>(state.range(0));
+    std::string wire = makeHead(8, "Content-Length: " + std::to_string(size)) + std::string(size, 'b');
+    for (auto _ : state) {
+        parseResponse(wire, state);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * wire.size()));
+}
+BENCHMARK(BM_ParseContentLengthBody)->ArgName("body")->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+void BM_ParseChunkedBody(benchmark::State& state) {
+    size_t size = static_cast<size_t>(state.range(0));
+    std::string wire = makeHead(8, "Transfer-Encoding: chunked") + chunkedBody(size);
+    for (auto _ : state) {
+        parseResponse(wire, state);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * wire.size()));
+}
+BENCHMARK(BM_ParseChunkedBody)->ArgName("body")->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+void BM_LoopbackSendRequest(benchmark::State& state) {
+    LoopbackServer server(static_cast<size_t>(state.range(0)));
+    HttpClient client;
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    request.headers["Accept"] = "*/*";
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        HttpResponse response = client.sendRequest(request, false);
+        bytes += response.bodyBytes;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_LoopbackSendRequest)->ArgName("body")->Arg(0)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20)
+    ->UseRealTime();
+
+/// @brief Downloads to a file on a reused connection with the read loop (0), splice (1) or io_uring (2).
+void BM_LoopbackDownload(benchmark::State& state) {
+    if (state.range(0) == 2 && !uringAvailable()) {
+        state.SkipWithError("io_uring is not available");
+        return;
+    }
+    LoopbackServer server(8 << 20);
+    HttpClient client;
+    client.setSpliceDownloads(state.range(0) == 1);
+    client.setUringDownloads(state.range(0) == 2);
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    request.outputFile = "lurc_bench_download.tmp";
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        HttpResponse response = client.downloadFile(request, false);
+        bytes += response.bodyBytes;
+    }
+    std::remove(request.outputFile.c_str());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_LoopbackDownload)->ArgName("mode")->Arg(0)->Arg(1)->Arg(2)->UseRealTime();
+
+void BM_LoopbackFetchAll(benchmark::State& state) {
+    LoopbackServer server(1 << 10);
+    HttpClient client;
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    std::vector<HttpRequest> requests(static_cast<size_t>(state.range(0)), request);
+    for (auto _ : state) {
+        std::vector<FetchResult> results = client.fetchAll(requests, requests.size());
+        for (const auto& result : results) {
+            if (!result.error.empty()) {
+                state.SkipWithError(result.error.c_str());
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * requests.size()));
+}
+BENCHMARK(BM_LoopbackFetchAll)->ArgName("concurrent")->Arg(8)->Arg(64)->UseRealTime();
+
+void BM_LoopbackPipelined(benchmark::State& state) {
+    LoopbackServer server(1 << 10);
+    HttpClient client;
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    std::vector<HttpRequest> requests(64, request);
+    for (auto _ : state) {
+        std::vector<FetchResult> results = client.fetchPipelined(requests, static_cast<size_t>(state.range(0)));
+        for (const auto& result : results) {
+            if (!result.error.empty()) {
+                state.SkipWithError(result.error.c_str());
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * requests.size()));
+}
+BENCHMARK(BM_LoopbackPipelined)->ArgName("depth")->Arg(1)->Arg(8)->Arg(32)->UseRealTime();
+
+void BM_LoopbackAsyncClient(benchmark::State& state) {
+    LoopbackServer server(1 << 10);
+    HttpClient client;
+    AsyncHttpClient async(client, static_cast<size_t>(state.range(0)));
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    std::vector<AsyncHttpClient::Pending> pending;
+    for (auto _ : state) {
+        pending.clear();
+        for (int i = 0; i < 64; ++i) {
+            pending.push_back(async.fetch(request));
+        }
+        for (auto& request : pending) {
+            FetchResult result = request.result.get();
+            if (!result.error.empty()) {
+                state.SkipWithError(result.error.c_str());
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_LoopbackAsyncClient)->ArgName("threads")->Arg(1)->Arg(2)->UseRealTime();
+
+} // namespace
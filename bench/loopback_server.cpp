@@ -0,0 +1,173 @@
+//loopback_server.cpp
+
+#include "loopback_server.h"
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/// @brief Returns true if a scripted response's head asks for the connection to be closed.
+bool closesConnection(const std::string& reply) {
+    size_t headEnd = reply.find("\r\n\r\n");
+    return reply.find("\r\nConnection: close\r\n") < (headEnd == std::string::npos ? reply.size() : headEnd + 2);
+}
+
+} // namespace
+
+LoopbackServer::LoopbackServer(size_t bodySize, size_t maxConnections) : maxConnections(maxConnections) {
+    response = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+               std::to_string(bodySize) + "\r\n\r\n" + std::string(bodySize, 'x');
+    listenOnLoopback();
+}
+
+LoopbackServer::LoopbackServer(Handler handler, size_t maxConnections)
+    : maxConnections(maxConnections), handler(std::move(handler)) {
+    listenOnLoopback();
+}
+
+void LoopbackServer::listenOnLoopback() {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd == -1) {
+        throw std::runtime_error("Failed to create socket: " + std::string(strerror(errno)));
+    }
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(listenFd, 1024) == -1 ||
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &length) == -1) {
+        close(listenFd);
+        throw std::runtime_error("Failed to listen: " + std::string(strerror(errno)));
+    }
+    port = ntohs(addr.sin_port);
+    acceptThread = std::thread(&LoopbackServer::acceptLoop, this);
+}
+
+LoopbackServer::~LoopbackServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workerFinished.notify_all();
+    shutdown(listenFd, SHUT_RDWR);
+    acceptThread.join();
+    close(listenFd);
+    // Wake the workers blocked in recv or send; their sockets stay open until they are joined.
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto& worker : workers) {
+        shutdown(worker.fd, SHUT_RDWR);
+    }
+    lock.unlock();
+    for (auto& worker : workers) {
+        worker.thread.join();
+        close(worker.fd);
+    }
+}
+
+std::string LoopbackServer::url() const {
+    return "http://127.0.0.1:" + std::to_string(port) + "/";
+}
+
+size_t LoopbackServer::reapFinished() {
+    size_t running = 0;
+    for (auto it = workers.begin(); it != workers.end(); ) {
+        if (!it->finished) {
+            ++running;
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        close(it->fd);
+        it = workers.erase(it);
+    }
+    return running;
+}
+
+void LoopbackServer::acceptLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workerFinished.wait(lock, [this]() { return stopping || reapFinished() < maxConnections; });
+            if (stopping) {
+                return;
+            }
+        }
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return; // Listening socket shut down
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ++accepted;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            close(fd);
+            return;
+        }
+        workers.emplace_back();
+        Worker& worker = workers.back();
+        worker.fd = fd;
+        worker.thread = std::thread(&LoopbackServer::serve, this, std::ref(worker));
+    }
+}
+
+void LoopbackServer::serve(Worker& worker) {
+    int fd = worker.fd;
+    std::string pending;
+    char buffer[16384];
+    while (true) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer, n);
+        // Answer every complete request head received so far (pipelined requests included).
+        size_t end;
+        bool failed = false;
+        while ((end = pending.find("\r\n\r\n")) != std::string::npos) {
+            std::string scripted;
+            if (handler) {
+                scripted = handler(pending.substr(0, end + 4));
+            }
+            const std::string& reply = handler ? scripted : response;
+            pending.erase(0, end + 4);
+            size_t sent = 0;
+            while (sent < reply.size()) {
+                ssize_t w = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (w <= 0) {
+                    failed = true;
+                    break;
+                }
+                sent += w;
+            }
+            if (handler && (reply.empty() || closesConnection(reply))) {
+                // The peer sees the end of stream now; the socket itself is closed once this thread is joined.
+                shutdown(fd, SHUT_RDWR);
+                failed = true;
+            }
+            if (failed) {
+                break;
+            }
+        }
+        if (failed) {
+            break;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        worker.finished = true;
+    }
+    workerFinished.notify_all();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// @brief Minimal in-process HTTP/1.1 server on 127.0.0.1 for end-to-end benchmarks and tests.
+/// By default every request on a connection is answered with the same keep-alive 200 response carrying
+/// a fixed body, so the measurement is dominated by the client; tests can script the responses instead. Each connection is served on its own thread,
+/// up to `maxConnections` at once; further connections wait in the listen backlog until one closes.
+/// Request bodies are not supported.
+class LoopbackServer {
+public:
+    /// @brief Starts listening on an ephemeral port.
+    /// @param bodySize Size of the body sent in every response.
+    /// @param maxConnections Maximum number of connections served at the same time.
+    /// @throws std::runtime_error if the socket cannot be set up.
+    explicit LoopbackServer(size_t bodySize, size_t maxConnections = 128);
+
+    /// @brief Builds the complete response to a request from its head (request line and headers).
+    /// An empty response closes the connection without answering, and a response with a
+    /// "Connection: close" header closes it after sending. Called from several threads at once.
+    using Handler = std::function<std::string(const std::string& head)>;
+
+    /// @brief Starts listening on an ephemeral port, answering every request with `handler`.
+    /// @throws std::runtime_error if the socket cannot be set up.
+    explicit LoopbackServer(Handler handler, size_t maxConnections = 128);
+
+    /// @brief Stops accepting, shuts every connection down, joins the threads and then closes the sockets.
+    ~LoopbackServer();
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    /// @brief Returns the base URL, e.g. "http://127.0.0.1:40123/".
+    std::string url() const;
+
+    /// @brief Returns the number of connections accepted so far.
+    size_t connectionsAccepted() const { return accepted; }
+
+private:
+    /// @brief A connection and the thread serving it. The socket is closed only after the thread is joined.
+    struct Worker {
+        int fd = -1;
+        bool finished = false;       ///< Set by the thread when it stops using the socket.
+        std::thread thread;
+    };
+
+    int listenFd = -1;
+    uint16_t port = 0;
+    size_t maxConnections;
+    std::string response;            ///< The complete response sent for every request, without a handler.
+    Handler handler;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> accepted{0};
+    std::thread acceptThread;
+    std::list<Worker> workers;       ///< Connections being served, and finished ones not yet reaped.
+    std::mutex mutex;                ///< Guards workers.
+    std::condition_variable workerFinished;
+
+    void listenOnLoopback();
+    void acceptLoop();
+    void serve(Worker& worker);
+
+    /// @brief Joins finished workers and closes their sockets; returns how many are still running.
+    /// Must be called with `mutex` held.
+    size_t reapFinished();
+};
@@ -0,0 +1,78 @@
+//url_parser_bench.cpp
+
+#include "url_parser.h"
+#include <benchmark/benchmark.h>
+#include <limits>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief The regex-based UrlParser::parse() this parser replaced, kept as the baseline.
+ParsedUrl legacyParse(const std::string& url) {
+    ParsedUrl result;
+    std::regex urlRegex("(https?)://([^/ :]+):?([^/ ]*)(/?[^ #?]*)");
+    std::smatch match;
+    if (!std::regex_match(url, match, urlRegex)) {
+        throw std::runtime_error("INVALID URL FORMAT!");
+    }
+    result.protocol = match[1];
+    result.host = match[2];
+    std::string portStr = match[3];
+    if (portStr.empty()) {
+        result.port = protocolToPort.at(result.protocol);
+    } else {
+        long port = std::stol(portStr);
+        if (port < 0 || port > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Invalid port number: " + portStr);
+        }
+        result.port = static_cast<uint16_t>(port);
+    }
+    result.path = match[4].length() == 0 ? "/" : std::string(match[4]);
+    return result;
+}
+
+/// @brief URLs the legacy parser also accepts, so every variant does the same amount of work.
+const std::vector<std::string> urls = {
+    "http://example.com",
+    "https://example.com/",
+    "http://localhost:8080/api/v1/items",
+    "https://cdn.example.org:8443/assets/images/2024/banner-large.png",
+    "http://a.very.long.subdomain.example.co.uk/some/deeply/nested/path/to/a/resource.html",
+};
+
+void BM_LegacyRegexParse(benchmark::State& state) {
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(legacyParse(urls[i++ % urls.size()]));
+    }
+}
+BENCHMARK(BM_LegacyRegexParse);
+
+void BM_Parse(benchmark::State& state) {
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(UrlParser::parse(urls[i++ % urls.size()]));
+    }
+}
+BENCHMARK(BM_Parse);
+
+void BM_ParseView(benchmark::State& state) {
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(UrlParser::parseView(urls[i++ % urls.size()]));
+    }
+}
+BENCHMARK(BM_ParseView);
+
+void BM_ParseViewQueryUserinfoIPv6(benchmark::State& state) {
+    const std::string url = "https://user:secret@[2001:db8::1]:8443/search?q=lurc&page=2#results";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(UrlParser::parseView(url));
+    }
+}
+BENCHMARK(BM_ParseViewQueryUserinfoIPv6);
+
+} // namespace
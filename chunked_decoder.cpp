@@ -0,0 +1,138 @@
+//chunked_decoder.cpp
+
+#include "chunked_decoder.h"
+#include <algorithm>
+#include <stdexcept>
+
+/// @brief Largest trailer field accepted before the response is rejected.
+const size_t maxTrailerLength = 64 * 1024;
+/// @brief Largest trailer section (all fields with their line ends) accepted before the response is rejected.
+const size_t maxTrailerSectionLength = 256 * 1024;
+
+ChunkedDecoder::ChunkedDecoder(DataCallback onData, TrailerCallback onTrailer)
+    : onData(std::move(onData)), onTrailer(std::move(onTrailer)) {}
+
+size_t ChunkedDecoder::decode(const char* data, size_t length) {
+    size_t pos = 0;
+    while (pos < length && state != State::Done) {
+        if (state == State::Data) {
+            // Bulk path: hand over as much of the chunk as this buffer holds.
+            size_t n = static_cast<size_t>(std::min<uint64_t>(chunkSize, length - pos));
+            onData(data + pos, n);
+            pos += n;
+            chunkSize -= n;
+            if (chunkSize == 0) {
+                state = State::DataCR;
+            }
+            continue;
+        }
+
+        char c = data[pos++];
+        switch (state) {
+            case State::Size: {
+                int digit = -1;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+
+                if (digit >= 0) {
+                    if (chunkSize > (UINT64_MAX >> 4)) {
+                        throw std::runtime_error("Chunk size too large");
+                    }
+                    chunkSize = (chunkSize << 4) | static_cast<uint64_t>(digit);
+                    sawDigit = true;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    state = State::Extension;
+                } else if (c == '\r') {
+                    state = State::SizeLF;
+                } else if (c == '\n') {
+                    endSizeLine();
+                } else {
+                    throw std::runtime_error("Invalid chunk size");
+                }
+                break;
+            }
+            case State::Extension:
+                if (c == '\r') {
+                    state = State::SizeLF;
+                } else if (c == '\n') {
+                    endSizeLine();
+                }
+                break;
+            case State::SizeLF:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid chunk size line");
+                }
+                endSizeLine();
+                break;
+            case State::DataCR:
+                if (c == '\r') {
+                    state = State::DataLF;
+                } else if (c == '\n') {
+                    state = State::Size;
+                } else {
+                    throw std::runtime_error("Missing CRLF after chunk data");
+                }
+                break;
+            case State::DataLF:
+                if (c != '\n') {
+                    throw std::runtime_error("Missing CRLF after chunk data");
+                }
+                state = State::Size;
+                break;
+            case State::TrailerStart:
+                if (c == '\r') {
+                    state = State::FinalLF;
+                } else if (c == '\n') {
+                    state = State::Done;
+                } else {
+                    ++trailerBytes;
+                    trailer.assign(1, c);
+                    state = State::Trailer;
+                }
+                break;
+            case State::Trailer:
+                if (++trailerBytes > maxTrailerSectionLength) {
+                    throw std::runtime_error("Trailer section too long");
+                }
+                if (c == '\r' || c == '\n') {
+                    if (c == '\n') {
+                        if (onTrailer) onTrailer(trailer);
+                        state = State::TrailerStart;
+                    } else {
+                        state = State::TrailerLF;
+                    }
+                } else {
+                    if (trailer.size() >= maxTrailerLength) {
+                        throw std::runtime_error("Trailer field too long");
+                    }
+                    trailer.push_back(c);
+                }
+                break;
+            case State::TrailerLF:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid trailer line");
+                }
+                if (onTrailer) onTrailer(trailer);
+                state = State::TrailerStart;
+                break;
+            case State::FinalLF:
+                if (c != '\n') {
+                    throw std::runtime_error("Invalid end of chunked body");
+                }
+                state = State::Done;
+                break;
+            default:
+                break;
+        }
+    }
+    return pos;
+}
+
+void ChunkedDecoder::endSizeLine() {
+    if (!sawDigit) {
+        throw std::runtime_error("Invalid chunk size");
+    }
+    sawDigit = false;
+    state = chunkSize == 0 ? State::TrailerStart : State::Data;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/// @brief Streaming decoder for `Transfer-Encoding: chunked` bodies.
+/// Works byte by byte across arbitrary input boundaries: chunk data is forwarded to a callback
+/// straight from the input buffer, and only the current trailer field is ever buffered, so memory
+/// use is constant no matter how large the body is. The trailer section as a whole is capped too,
+/// since its fields are kept with the response. Chunk extensions are skipped.
+class ChunkedDecoder {
+public:
+    using DataCallback = std::function<void(const char*, size_t)>;
+    using TrailerCallback = std::function<void(const std::string&)>;
+
+    /// @brief Creates a decoder.
+    /// @param onData Called with each piece of decoded body data.
+    /// @param onTrailer Called with each trailer field line ("Name: value"), may be empty.
+    ChunkedDecoder(DataCallback onData, TrailerCallback onTrailer);
+
+    /// @brief Decodes the next bytes of the chunked body.
+    /// Decoding stops after the final CRLF, so any bytes after it are not consumed.
+    /// @param data The received bytes.
+    /// @param length Number of bytes in `data`.
+    /// @return The number of bytes consumed.
+    /// @throws std::runtime_error on malformed chunk framing.
+    size_t decode(const char* data, size_t length);
+
+    /// @brief Returns true once the last chunk and the trailer section have been read.
+    bool done() const { return state == State::Done; }
+
+private:
+    enum class State {
+        Size,         ///< Reading hex digits of the chunk size.
+        Extension,    ///< Skipping a chunk extension up to the end of the line.
+        SizeLF,       ///< Expecting the LF that ends the chunk-size line.
+        Data,         ///< Forwarding chunk data.
+        DataCR,       ///< Expecting the CR after chunk data.
+        DataLF,       ///< Expecting the LF after chunk data.
+        TrailerStart, ///< At the start of a trailer line, or of the final empty line.
+        Trailer,      ///< Reading a trailer field.
+        TrailerLF,    ///< Expecting the LF that ends a trailer field.
+        FinalLF,      ///< Expecting the LF of the final empty line.
+        Done          ///< The chunked body is complete.
+    };
+
+    DataCallback onData;
+    TrailerCallback onTrailer;
+    State state = State::Size;
+    uint64_t chunkSize = 0;  ///< Size of the current chunk, then the bytes still to forward.
+    bool sawDigit = false;   ///< At least one hex digit was read on the current size line.
+    std::string trailer;     ///< The trailer field currently being read.
+    size_t trailerBytes = 0; ///< Bytes of trailer fields and their line ends read so far.
+
+    /// @brief Moves on from a complete chunk-size line.
+    void endSizeLine();
+};
@@ -0,0 +1,109 @@
+//connection_pool.cpp
+
+#include "connection_pool.h"
+#include "http2_session.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Connection::~Connection() {
+    if (ssl) {
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+    }
+    if (sock != -1) {
+        close(sock);
+    }
+}
+
+ConnectionPool::ConnectionPool(std::chrono::milliseconds idleTimeout, size_t maxIdlePerHost)
+    : idleTimeout(idleTimeout), maxIdlePerHost(maxIdlePerHost) {}
+
+std::string ConnectionPool::originKey(const ParsedUrl& url) {
+    return url.protocol + "://" + url.host + ":" + std::to_string(url.port);
+}
+
+std::unique_ptr<Connection> ConnectionPool::acquire(const std::string& origin) {
+    std::lock_guard<std::mutex> lock(mutex);
+    evictExpired(std::chrono::steady_clock::now());
+
+    auto it = idle.find(origin);
+    if (it == idle.end()) {
+        return nullptr;
+    }
+    // Prefer the most recently used connection, it is the least likely to have been closed by the server.
+    auto& conns = it->second;
+    while (!conns.empty()) {
+        std::unique_ptr<Connection> conn = std::move(conns.back());
+        conns.pop_back();
+        if (isUsable(*conn)) {
+            return conn;
+        }
+    }
+    idle.erase(it);
+    return nullptr;
+}
+
+void ConnectionPool::release(std::unique_ptr<Connection> conn) {
+    if (!conn) {
+        return;
+    }
+    conn->lastUsed = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (maxIdlePerHost == 0) {
+        return;
+    }
+    auto& conns = idle[conn->origin];
+    conns.push_back(std::move(conn));
+    while (conns.size() > maxIdlePerHost) {
+        conns.pop_front();
+    }
+}
+
+void ConnectionPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.clear();
+}
+
+void ConnectionPool::setIdleTimeout(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idleTimeout = timeout;
+}
+
+void ConnectionPool::setMaxIdlePerHost(size_t max) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxIdlePerHost = max;
+}
+
+size_t ConnectionPool::idleCount(const std::string& origin) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = idle.find(origin);
+    return it == idle.end() ? 0 : it->second.size();
+}
+
+void ConnectionPool::evictExpired(std::chrono::steady_clock::time_point now) {
+    for (auto it = idle.begin(); it != idle.end();) {
+        auto& conns = it->second;
+        while (!conns.empty() && now - conns.front()->lastUsed > idleTimeout) {
+            conns.pop_front();
+        }
+        it = conns.empty() ? idle.erase(it) : std::next(it);
+    }
+}
+
+bool ConnectionPool::isUsable(const Connection& conn) {
+    if (conn.ssl && SSL_pending(conn.ssl) > 0) {
+        return false;
+    }
+    char probe;
+    ssize_t n = recv(conn.sock, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0) {
+        return false; // Orderly shutdown by the peer.
+    }
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    // Pending bytes on an idle plain connection are a protocol error. On TLS they are usually a
+    // post-handshake session ticket or a close_notify, so let the request decide (it retries once).
+    return conn.ssl != nullptr;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "url_parser.h"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <openssl/ssl.h>
+
+class Http2Session;
+
+/// @brief An open TCP connection to a single origin, optionally wrapped in TLS.
+/// Owns the socket and the SSL object; both are released when the connection is destroyed.
+struct Connection {
+    int sock = -1;                                    ///< Connected socket file descriptor.
+    SSL* ssl = nullptr;                               ///< TLS session, or nullptr for plain HTTP.
+    std::string origin;                               ///< Pool key of the origin this connection talks to.
+    std::chrono::steady_clock::time_point lastUsed;   ///< When the connection was last handed back to the pool.
+    size_t requestsServed = 0;                        ///< Number of complete responses read on this connection.
+    std::unique_ptr<Http2Session> http2;              ///< Framing state if ALPN selected h2, else null.
+
+    Connection() = default;
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    /// @brief Shuts down TLS (if any) and closes the socket.
+    ~Connection();
+};
+
+/// @brief Per-origin pool of idle keep-alive connections.
+/// Connections are keyed by protocol, host and port so that a TLS connection is never
+/// handed out for a plain HTTP request to the same host (or vice versa). The pool may be
+/// shared by several threads.
+class ConnectionPool {
+public:
+    /// @brief Constructs a pool.
+    /// @param idleTimeout How long an idle connection may sit in the pool before it is closed.
+    /// @param maxIdlePerHost Maximum number of idle connections kept for a single origin.
+    explicit ConnectionPool(std::chrono::milliseconds idleTimeout = std::chrono::seconds(30),
+                            size_t maxIdlePerHost = 6);
+
+    /// @brief Builds the pool key for a URL, e.g. "https://example.com:443".
+    /// @param url The parsed URL.
+    /// @return The origin key.
+    static std::string originKey(const ParsedUrl& url);
+
+    /// @brief Takes an idle connection for the origin out of the pool.
+    /// Expired connections and connections the peer has already closed are discarded.
+    /// @param origin The origin key as returned by originKey().
+    /// @return A reusable connection, or nullptr if none is available.
+    std::unique_ptr<Connection> acquire(const std::string& origin);
+
+    /// @brief Returns a connection to the pool so that a later request can reuse it.
+    /// If the origin already holds maxIdlePerHost idle connections, the oldest one is closed.
+    /// @param conn The connection, which must have a complete response read off it.
+    void release(std::unique_ptr<Connection> conn);
+
+    /// @brief Closes every idle connection.
+    void clear();
+
+    /// @brief Returns the number of idle connections held for an origin.
+    size_t idleCount(const std::string& origin) const;
+
+    void setIdleTimeout(std::chrono::milliseconds timeout);
+    void setMaxIdlePerHost(size_t max);
+
+private:
+    std::chrono::milliseconds idleTimeout; ///< Maximum idle time before a connection is closed.
+    size_t maxIdlePerHost;                 ///< Maximum idle connections kept per origin.
+    std::map<std::string, std::deque<std::unique_ptr<Connection>>> idle; ///< Idle connections by origin, oldest first.
+    mutable std::mutex mutex; ///< Guards all of the above.
+
+    /// @brief Drops connections that have been idle for longer than idleTimeout.
+    void evictExpired(std::chrono::steady_clock::time_point now);
+
+    /// @brief Checks whether the peer has closed (or written unsolicited data to) an idle connection.
+    /// @return True if the connection can still carry a new request.
+    static bool isUsable(const Connection& conn);
+};
@@ -0,0 +1,231 @@
+//content_decoder.cpp
+
+#include "content_decoder.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef LURC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+/// @brief Size of each stage's output buffer.
+const size_t bufferSize = 16384;
+
+/// @brief Most codings accepted in one Content-Encoding header, which bounds the memory a response can claim.
+const size_t maxStages = 5;
+
+/// @brief gzip (RFC 1952) or deflate through zlib.
+/// "deflate" is meant to be a zlib stream (RFC 1950), but some servers send raw deflate data,
+/// so the first two bytes decide which one it is.
+class ZlibStage : public ContentDecoder::Stage {
+public:
+    ZlibStage(bool gzip, ContentDecoder::DataCallback out)
+        : gzip(gzip), out(std::move(out)), buffer(new char[bufferSize]) {}
+
+    ~ZlibStage() override {
+        if (initialized) {
+            inflateEnd(&stream);
+        }
+    }
+
+    void write(const char* data, size_t length) override {
+        if (!initialized) {
+            if (!gzip && header.size() + length < 2) {
+                header.append(data, length);
+                return;
+            }
+            int windowBits = 16 + MAX_WBITS;
+            if (!gzip) {
+                std::string start = header + std::string(data, std::min<size_t>(length, 2));
+                unsigned char cmf = static_cast<unsigned char>(start[0]);
+                unsigned char flg = static_cast<unsigned char>(start[1]);
+                windowBits = (cmf & 0x0f) == Z_DEFLATED && (cmf * 256 + flg) % 31 == 0 ? MAX_WBITS : -MAX_WBITS;
+            }
+            if (inflateInit2(&stream, windowBits) != Z_OK) {
+                throw std::runtime_error("Failed to initialize zlib");
+            }
+            initialized = true;
+            if (!header.empty()) {
+                std::string pending;
+                pending.swap(header);
+                inflateSome(pending.data(), pending.size());
+            }
+        }
+        inflateSome(data, length);
+    }
+
+    void finish() override {
+        if (!ended && (initialized || !header.empty())) {
+            throw std::runtime_error(std::string(gzip ? "gzip" : "deflate") + " body ended early");
+        }
+    }
+
+private:
+    bool gzip;
+    ContentDecoder::DataCallback out;
+    std::unique_ptr<char[]> buffer;
+    z_stream stream{};
+    bool initialized = false;
+    bool ended = false;   ///< The last compressed stream is complete.
+    std::string header;   ///< Up to one byte of a deflate body, kept until the format is known.
+
+    void inflateSome(const char* data, size_t length) {
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(length);
+        bool outputPending = false; // The last call filled the buffer, so zlib may hold more output.
+        while (true) {
+            if (ended) {
+                // A gzip body may hold several members; anything after a deflate stream is ignored.
+                if (!gzip || stream.avail_in == 0) {
+                    return;
+                }
+                inflateReset(&stream);
+                ended = false;
+            }
+            if (stream.avail_in == 0 && !outputPending) {
+                return;
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.get());
+            stream.avail_out = bufferSize;
+            int rc = inflate(&stream, Z_NO_FLUSH);
+            size_t produced = bufferSize - stream.avail_out;
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+                throw std::runtime_error(std::string("Failed to decode ") + (gzip ? "gzip" : "deflate") + " body: " +
+                                         (stream.msg ? stream.msg : "corrupt data"));
+            }
+            if (produced > 0) {
+                out(buffer.get(), produced);
+            }
+            ended = rc == Z_STREAM_END;
+            outputPending = produced == bufferSize;
+        }
+    }
+};
+
+#ifdef LURC_HAVE_ZSTD
+/// @brief zstd (RFC 8878) through libzstd's streaming decompressor.
+class ZstdStage : public ContentDecoder::Stage {
+public:
+    explicit ZstdStage(ContentDecoder::DataCallback out)
+        : out(std::move(out)), buffer(new char[bufferSize]), context(ZSTD_createDCtx()) {
+        if (!context) {
+            throw std::runtime_error("Failed to initialize zstd");
+        }
+        // Frames needing a larger window than 8 MiB are refused rather than allocated.
+        ZSTD_DCtx_setParameter(context, ZSTD_d_windowLogMax, 23);
+    }
+
+    ~ZstdStage() override { ZSTD_freeDCtx(context); }
+
+    void write(const char* data, size_t length) override {
+        ZSTD_inBuffer input{data, length, 0};
+        while (input.pos < input.size || flushing) {
+            ZSTD_outBuffer output{buffer.get(), bufferSize, 0};
+            size_t rc = ZSTD_decompressStream(context, &output, &input);
+            if (ZSTD_isError(rc)) {
+                throw std::runtime_error(std::string("Failed to decode zstd body: ") + ZSTD_getErrorName(rc));
+            }
+            if (output.pos > 0) {
+                out(buffer.get(), output.pos);
+            }
+            started = true;
+            frameEnded = rc == 0;
+            // A full output buffer may leave decoded data inside zstd.
+            flushing = output.pos == output.size;
+        }
+    }
+
+    void finish() override {
+        if (started && !frameEnded) {
+            throw std::runtime_error("zstd body ended early");
+        }
+    }
+
+private:
+    ContentDecoder::DataCallback out;
+    std::unique_ptr<char[]> buffer;
+    ZSTD_DCtx* context;
+    bool started = false;
+    bool frameEnded = false;
+    bool flushing = false;
+};
+#endif
+
+} // namespace
+
+const char* ContentDecoder::acceptEncoding() {
+#ifdef LURC_HAVE_ZSTD
+    return "gzip, deflate, zstd";
+#else
+    return "gzip, deflate";
+#endif
+}
+
+std::unique_ptr<ContentDecoder> ContentDecoder::create(const std::string& contentEncoding, DataCallback onData) {
+    std::vector<std::string> codings;
+    size_t pos = 0;
+    while (pos <= contentEncoding.size()) {
+        size_t end = contentEncoding.find(',', pos);
+        if (end == std::string::npos) {
+            end = contentEncoding.size();
+        }
+        std::string coding;
+        for (size_t i = pos; i < end; ++i) {
+            if (!isspace(static_cast<unsigned char>(contentEncoding[i]))) {
+                coding += static_cast<char>(tolower(static_cast<unsigned char>(contentEncoding[i])));
+            }
+        }
+        if (!coding.empty() && coding != "identity") {
+            codings.push_back(coding);
+        }
+        pos = end + 1;
+    }
+    if (codings.empty()) {
+        return nullptr;
+    }
+    if (codings.size() > maxStages) {
+        throw std::runtime_error("Too many content codings: " + contentEncoding);
+    }
+
+    std::unique_ptr<ContentDecoder> decoder(new ContentDecoder(std::move(onData)));
+    // Codings are listed in the order they were applied, so the first one is undone last and feeds the callback.
+    DataCallback next = [raw = decoder.get()](const char* data, size_t length) { raw->onData(data, length); };
+    for (const std::string& coding : codings) {
+        std::unique_ptr<Stage> stage;
+        if (coding == "gzip" || coding == "x-gzip") {
+            stage = std::make_unique<ZlibStage>(true, next);
+        } else if (coding == "deflate") {
+            stage = std::make_unique<ZlibStage>(false, next);
+#ifdef LURC_HAVE_ZSTD
+        } else if (coding == "zstd") {
+            stage = std::make_unique<ZstdStage>(next);
+#endif
+        } else {
+            throw std::runtime_error("Unsupported Content-Encoding: " + coding);
+        }
+        Stage* raw = stage.get();
+        next = [raw](const char* data, size_t length) { raw->write(data, length); };
+        decoder->stages.insert(decoder->stages.begin(), std::move(stage));
+    }
+    return decoder;
+}
+
+void ContentDecoder::decode(const char* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    received = true;
+    stages.front()->write(data, length);
+}
+
+void ContentDecoder::finish() {
+    if (!received) {
+        return;
+    }
+    for (auto& stage : stages) {
+        stage->finish();
+    }
+}
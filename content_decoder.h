@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief Streaming decoder for `Content-Encoding` (RFC 9110 section 8.4): gzip, deflate and, when built
+/// with libzstd, zstd. Compressed bytes are fed as they arrive and decoded data is handed to a callback
+/// from a fixed-size buffer per coding, so memory use does not depend on the size of the body or on how
+/// well it compresses. Several codings (e.g. "deflate, gzip") are undone in reverse order.
+class ContentDecoder {
+public:
+    using DataCallback = std::function<void(const char*, size_t)>;
+
+    /// @brief One coding in the chain; writes what it decodes to the next stage or the callback.
+    class Stage {
+    public:
+        virtual ~Stage() = default;
+
+        /// @brief Decodes the next compressed bytes.
+        /// @throws std::runtime_error on corrupt data.
+        virtual void write(const char* data, size_t length) = 0;
+
+        /// @brief Checks that the compressed stream ended properly.
+        /// @throws std::runtime_error if it was truncated.
+        virtual void finish() = 0;
+    };
+
+    /// @brief Returns the value to send as `Accept-Encoding` for the codings this build can decode.
+    static const char* acceptEncoding();
+
+    /// @brief Creates a decoder for a response's Content-Encoding header value.
+    /// @param contentEncoding The header value; "identity" entries are ignored.
+    /// @param onData Called with each piece of the decoded body.
+    /// @return A decoder, or null if the body is not encoded.
+    /// @throws std::runtime_error if a coding is not supported.
+    static std::unique_ptr<ContentDecoder> create(const std::string& contentEncoding, DataCallback onData);
+
+    /// @brief Decodes the next bytes of the encoded body.
+    /// @throws std::runtime_error on corrupt data.
+    void decode(const char* data, size_t length);
+
+    /// @brief Signals the end of the encoded body. An empty body (e.g. a HEAD response) is accepted.
+    /// @throws std::runtime_error if the compressed stream is incomplete.
+    void finish();
+
+private:
+    explicit ContentDecoder(DataCallback onData) : onData(std::move(onData)) {}
+
+    DataCallback onData;
+    std::vector<std::unique_ptr<Stage>> stages; ///< Outermost coding (applied last by the server) first.
+    bool received = false;                      ///< Any encoded bytes were fed.
+};
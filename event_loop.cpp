@@ -0,0 +1,100 @@
+//event_loop.cpp
+
+#include "event_loop.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+EventLoop::EventLoop() : epfd(epoll_create1(EPOLL_CLOEXEC)) {
+    if (epfd == -1) {
+        throw std::runtime_error("Failed to create epoll instance: " + std::string(strerror(errno)));
+    }
+}
+
+EventLoop::~EventLoop() {
+    close(epfd);
+}
+
+void EventLoop::add(int fd, uint32_t events, Handler handler) {
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        throw std::runtime_error("Failed to register descriptor with epoll: " + std::string(strerror(errno)));
+    }
+    handlers[fd] = std::move(handler);
+}
+
+void EventLoop::modify(int fd, uint32_t events) {
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        throw std::runtime_error("Failed to modify epoll registration: " + std::string(strerror(errno)));
+    }
+}
+
+void EventLoop::remove(int fd) {
+    if (handlers.erase(fd) > 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+int EventLoop::addTimer(int delayMs, std::function<void()> callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to create timer: " + std::string(strerror(errno)));
+    }
+    struct itimerspec spec = {};
+    // A zero it_value would disarm the timer, so round up to the shortest possible delay.
+    long long ns = delayMs > 0 ? static_cast<long long>(delayMs) * 1000000 : 1;
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if (timerfd_settime(fd, 0, &spec, nullptr) == -1) {
+        close(fd);
+        throw std::runtime_error("Failed to arm timer: " + std::string(strerror(errno)));
+    }
+    add(fd, EPOLLIN, [this, fd, callback = std::move(callback)](uint32_t) {
+        cancelTimer(fd);
+        callback();
+    });
+    return fd;
+}
+
+void EventLoop::cancelTimer(int id) {
+    remove(id);
+    close(id);
+}
+
+int EventLoop::poll(int timeoutMs) {
+    struct epoll_event events[64];
+    int n = epoll_wait(epfd, events, 64, timeoutMs);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        throw std::runtime_error("epoll_wait failed: " + std::string(strerror(errno)));
+    }
+    int dispatched = 0;
+    for (int i = 0; i < n; ++i) {
+        // An earlier handler in this batch may have removed the descriptor.
+        auto it = handlers.find(events[i].data.fd);
+        if (it == handlers.end()) {
+            continue;
+        }
+        // Copy the handler so it stays alive if it removes its own registration.
+        Handler handler = it->second;
+        handler(events[i].events);
+        ++dispatched;
+    }
+    return dispatched;
+}
+
+void EventLoop::run() {
+    while (!empty()) {
+        poll(-1);
+    }
+}
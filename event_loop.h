@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <sys/epoll.h>
+
+/// @brief Minimal single-threaded readiness loop on top of epoll.
+/// File descriptors are registered together with a handler that is invoked with the ready
+/// epoll event mask. Handlers may add, modify or remove any descriptor, including their own.
+class EventLoop {
+public:
+    using Handler = std::function<void(uint32_t events)>;
+
+    /// @brief Creates the epoll instance.
+    /// @throws std::runtime_error if epoll_create1 fails.
+    EventLoop();
+
+    /// @brief Closes the epoll instance. Registered descriptors are not closed.
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// @brief Starts watching a descriptor.
+    /// @param fd The descriptor, which should be non-blocking.
+    /// @param events The epoll events of interest (EPOLLIN, EPOLLOUT, ...).
+    /// @param handler Called with the ready events.
+    /// @throws std::runtime_error if the descriptor cannot be registered.
+    void add(int fd, uint32_t events, Handler handler);
+
+    /// @brief Changes the events a registered descriptor is watched for.
+    void modify(int fd, uint32_t events);
+
+    /// @brief Stops watching a descriptor. Must be called before the descriptor is closed.
+    void remove(int fd);
+
+    /// @brief Runs a callback once after a delay.
+    /// A pending timer counts as a registered descriptor, so run() keeps going until it fires or is cancelled.
+    /// @param delayMs Delay in milliseconds.
+    /// @param callback Called once on the loop when the delay has passed.
+    /// @return A timer id for cancelTimer().
+    /// @throws std::runtime_error if the timer cannot be created.
+    int addTimer(int delayMs, std::function<void()> callback);
+
+    /// @brief Cancels a timer that has not fired yet. Ids of fired timers must not be passed.
+    void cancelTimer(int id);
+
+    /// @brief Returns true when no descriptor is registered.
+    bool empty() const { return handlers.empty(); }
+
+    /// @brief Waits for readiness and dispatches handlers once.
+    /// @param timeoutMs Maximum time to wait in milliseconds, -1 to wait indefinitely.
+    /// @return The number of handlers dispatched.
+    int poll(int timeoutMs);
+
+    /// @brief Dispatches events until no descriptor is registered.
+    void run();
+
+private:
+    int epfd; ///< The epoll instance.
+    std::unordered_map<int, Handler> handlers; ///< Handlers by file descriptor.
+};
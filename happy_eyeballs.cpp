@@ -0,0 +1,224 @@
+//happy_eyeballs.cpp
+
+#include "happy_eyeballs.h"
+#include "event_loop.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/// @brief Opens a non-blocking socket and starts connecting it.
+/// @return The socket, or -1 with `error` set if the attempt failed immediately.
+int beginConnect(const ResolvedAddress& address, bool& connected, std::string& error) {
+    connected = false;
+    int sock = socket(address.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        error = "Failed to create socket: " + std::string(strerror(errno));
+        return -1;
+    }
+    if (connect(sock, address.addr(), address.length) == 0) {
+        connected = true;
+    } else if (errno != EINPROGRESS) {
+        error = "Connection failed: " + std::string(strerror(errno));
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/// @brief Returns the result of a finished non-blocking connect as an errno value.
+int connectResult(int sock) {
+    int soError = 0;
+    socklen_t len = sizeof(soError);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &soError, &len) == -1) {
+        return errno;
+    }
+    return soError;
+}
+
+} // namespace
+
+std::vector<ResolvedAddress> interleaveFamilies(const std::vector<ResolvedAddress>& addresses) {
+    std::vector<ResolvedAddress> v6, v4;
+    for (const auto& address : addresses) {
+        (address.family == AF_INET6 ? v6 : v4).push_back(address);
+    }
+    std::vector<ResolvedAddress> ordered;
+    ordered.reserve(addresses.size());
+    for (size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+        if (i < v6.size()) ordered.push_back(v6[i]);
+        if (i < v4.size()) ordered.push_back(v4[i]);
+    }
+    return ordered;
+}
+
+int connectHappyEyeballs(const std::vector<ResolvedAddress>& addresses, std::chrono::milliseconds attemptDelay,
+                         std::chrono::milliseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<ResolvedAddress> ordered = interleaveFamilies(addresses);
+    std::vector<pollfd> attempts;
+    auto closeAttempts = [&attempts](int keep) {
+        for (const auto& attempt : attempts) {
+            if (attempt.fd != keep) close(attempt.fd);
+        }
+    };
+    auto makeBlocking = [](int sock) {
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+        return sock;
+    };
+
+    const Clock::time_point deadline = Clock::now() + timeout;
+    Clock::time_point nextAttempt = Clock::now();
+    size_t next = 0;
+    std::string lastError = "Connection failed";
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (next < ordered.size() && now >= nextAttempt) {
+            bool connected;
+            int sock = beginConnect(ordered[next++], connected, lastError);
+            if (connected) {
+                closeAttempts(-1);
+                return makeBlocking(sock);
+            }
+            // A failed attempt lets the next one start right away.
+            nextAttempt = sock == -1 ? now : now + attemptDelay;
+            if (sock != -1) {
+                attempts.push_back({sock, POLLOUT, 0});
+            }
+            continue;
+        }
+        if (attempts.empty() && next >= ordered.size()) {
+            throw std::runtime_error(lastError);
+        }
+        if (now >= deadline) {
+            closeAttempts(-1);
+            throw std::runtime_error("Connection timed out");
+        }
+
+        Clock::time_point wakeAt = next < ordered.size() ? std::min(nextAttempt, deadline) : deadline;
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count() + 1;
+        int ready = ::poll(attempts.data(), attempts.size(), static_cast<int>(wait));
+        if (ready < 0 && errno != EINTR) {
+            closeAttempts(-1);
+            throw std::runtime_error("poll failed: " + std::string(strerror(errno)));
+        }
+        for (size_t i = 0; ready > 0 && i < attempts.size();) {
+            if (attempts[i].revents == 0) {
+                ++i;
+                continue;
+            }
+            int result = connectResult(attempts[i].fd);
+            if (result == 0) {
+                int sock = attempts[i].fd;
+                closeAttempts(sock);
+                return makeBlocking(sock);
+            }
+            lastError = "Connection failed: " + std::string(strerror(result));
+            close(attempts[i].fd);
+            attempts.erase(attempts.begin() + i);
+            nextAttempt = Clock::now();
+        }
+    }
+}
+
+AsyncConnector::AsyncConnector(EventLoop& loop, std::chrono::milliseconds attemptDelay,
+                               std::chrono::milliseconds timeout)
+    : loop(loop), attemptDelay(attemptDelay), timeout(timeout) {}
+
+AsyncConnector::~AsyncConnector() {
+    cancel();
+}
+
+void AsyncConnector::cancel() {
+    callback = nullptr;
+    complete(-1, "");
+}
+
+void AsyncConnector::start(const std::vector<ResolvedAddress>& addresses, Callback callback) {
+    candidates = interleaveFamilies(addresses);
+    this->callback = std::move(callback);
+    deadlineTimer = loop.addTimer(static_cast<int>(timeout.count()), [this] {
+        deadlineTimer = -1;
+        complete(-1, "Connection timed out");
+    });
+    startAttempt();
+}
+
+void AsyncConnector::startAttempt() {
+    if (attemptTimer != -1) {
+        loop.cancelTimer(attemptTimer);
+        attemptTimer = -1;
+    }
+    while (next < candidates.size()) {
+        bool connected;
+        int sock = beginConnect(candidates[next++], connected, lastError);
+        if (sock == -1) {
+            continue;
+        }
+        if (connected) {
+            complete(sock, "");
+            return;
+        }
+        attempts.push_back(sock);
+        loop.add(sock, EPOLLOUT, [this, sock](uint32_t) { onReady(sock); });
+        if (next < candidates.size()) {
+            attemptTimer = loop.addTimer(static_cast<int>(attemptDelay.count()), [this] {
+                attemptTimer = -1;
+                startAttempt();
+            });
+        }
+        return;
+    }
+    if (attempts.empty()) {
+        complete(-1, lastError.empty() ? "Connection failed" : lastError);
+    }
+}
+
+void AsyncConnector::onReady(int sock) {
+    int result = connectResult(sock);
+    if (result == 0) {
+        complete(sock, "");
+        return;
+    }
+    lastError = "Connection failed: " + std::string(strerror(result));
+    abandon(sock);
+    startAttempt();
+}
+
+void AsyncConnector::abandon(int sock) {
+    loop.remove(sock);
+    close(sock);
+    attempts.erase(std::remove(attempts.begin(), attempts.end(), sock), attempts.end());
+}
+
+void AsyncConnector::complete(int sock, const std::string& error) {
+    for (int attempt : std::vector<int>(attempts)) {
+        if (attempt == sock) {
+            loop.remove(attempt);
+        } else {
+            abandon(attempt);
+        }
+    }
+    attempts.clear();
+    next = candidates.size();
+    if (attemptTimer != -1) {
+        loop.cancelTimer(attemptTimer);
+        attemptTimer = -1;
+    }
+    if (deadlineTimer != -1) {
+        loop.cancelTimer(deadlineTimer);
+        deadlineTimer = -1;
+    }
+    if (callback) {
+        Callback done = std::move(callback);
+        callback = nullptr;
+        done(sock, error);
+    }
+}
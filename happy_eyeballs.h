@@ -0,0 +1,71 @@
+#pragma once
+#include "resolver.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+/// @brief Delay between starting connection attempts (RFC 8305 "Connection Attempt Delay").
+const std::chrono::milliseconds connectionAttemptDelay(250);
+
+/// @brief Orders addresses for connection attempts as RFC 8305 section 4 describes: IPv6 first, then
+/// alternating between the families, otherwise keeping the resolver's order.
+std::vector<ResolvedAddress> interleaveFamilies(const std::vector<ResolvedAddress>& addresses);
+
+/// @brief Connects to the first address that answers, racing staggered attempts (Happy Eyeballs).
+/// A new attempt starts every `attemptDelay`, or immediately when the previous one fails; the first
+/// attempt to complete wins and the others are abandoned.
+/// @param addresses The resolved addresses, in the order returned by the resolver.
+/// @param attemptDelay Delay between attempts.
+/// @param timeout Overall limit for establishing the connection.
+/// @return A connected, blocking socket.
+/// @throws std::runtime_error if every attempt fails or the timeout expires.
+int connectHappyEyeballs(const std::vector<ResolvedAddress>& addresses, std::chrono::milliseconds attemptDelay,
+                         std::chrono::milliseconds timeout);
+
+/// @brief The Happy Eyeballs connect of connectHappyEyeballs() driven by an EventLoop.
+/// The connector must outlive the attempt, i.e. until the callback has run or it is destroyed.
+class AsyncConnector {
+public:
+    /// @brief Called once with a connected non-blocking socket (now owned by the callee), or -1 and an error.
+    using Callback = std::function<void(int sock, const std::string& error)>;
+
+    AsyncConnector(EventLoop& loop, std::chrono::milliseconds attemptDelay, std::chrono::milliseconds timeout);
+
+    /// @brief Closes any attempts still in progress.
+    ~AsyncConnector();
+
+    AsyncConnector(const AsyncConnector&) = delete;
+    AsyncConnector& operator=(const AsyncConnector&) = delete;
+
+    /// @brief Starts connecting.
+    void start(const std::vector<ResolvedAddress>& addresses, Callback callback);
+
+    /// @brief Closes any attempts in progress without reporting.
+    void cancel();
+
+private:
+    EventLoop& loop;
+    std::chrono::milliseconds attemptDelay;
+    std::chrono::milliseconds timeout;
+    std::vector<ResolvedAddress> candidates; ///< Addresses in attempt order.
+    size_t next = 0;                         ///< Index of the next address to try.
+    std::vector<int> attempts;               ///< Sockets with a connect in progress.
+    int attemptTimer = -1;                   ///< Timer starting the next attempt, or -1.
+    int deadlineTimer = -1;                  ///< Timer enforcing the overall timeout, or -1.
+    std::string lastError;
+    Callback callback;
+
+    /// @brief Starts attempts until one is in progress or the addresses run out.
+    void startAttempt();
+
+    void onReady(int sock);
+
+    /// @brief Closes all attempts and timers except the winning socket, then reports the result.
+    void complete(int sock, const std::string& error);
+
+    /// @brief Unregisters and closes one attempt.
+    void abandon(int sock);
+};
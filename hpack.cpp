@@ -0,0 +1,413 @@
+//hpack.cpp
+
+#include "hpack.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/// @brief The static table (RFC 7541 Appendix A); index 1 is the first entry.
+const HeaderField staticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+const size_t staticTableSize = sizeof(staticTable) / sizeof(staticTable[0]);
+
+/// @brief Huffman code and bit length for every symbol, 256 being EOS (RFC 7541 Appendix B).
+const struct { uint32_t code; uint8_t bits; } huffmanCodes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30}
+};
+
+/// @brief Node of the Huffman decoding tree: children by bit value, or a symbol at a leaf.
+struct HuffmanNode {
+    int16_t child[2] = {-1, -1};
+    int16_t symbol = -1;
+};
+
+/// @brief Builds the decoding tree once from the code table.
+const std::vector<HuffmanNode>& huffmanTree() {
+    static const std::vector<HuffmanNode> tree = [] {
+        std::vector<HuffmanNode> nodes(1);
+        for (int symbol = 0; symbol < 257; ++symbol) {
+            size_t node = 0;
+            for (int bit = huffmanCodes[symbol].bits - 1; bit >= 0; --bit) {
+                int b = (huffmanCodes[symbol].code >> bit) & 1;
+                if (nodes[node].child[b] < 0) {
+                    nodes[node].child[b] = static_cast<int16_t>(nodes.size());
+                    nodes.emplace_back();
+                }
+                node = nodes[node].child[b];
+            }
+            nodes[node].symbol = static_cast<int16_t>(symbol);
+        }
+        return nodes;
+    }();
+    return tree;
+}
+
+/// @brief Appends an integer with an N-bit prefix (RFC 7541 section 5.1); `flags` fills the bits above the prefix.
+void encodeInteger(std::string& out, uint64_t value, int prefixBits, uint8_t flags) {
+    uint64_t limit = (1u << prefixBits) - 1;
+    if (value < limit) {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out.push_back(static_cast<char>(flags | limit));
+    value -= limit;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/// @brief Reads an integer with an N-bit prefix, advancing `pos`.
+/// @throws std::runtime_error if it is truncated or too large.
+uint64_t decodeInteger(const unsigned char* data, size_t length, size_t& pos, int prefixBits) {
+    if (pos >= length) {
+        throw std::runtime_error("HPACK: truncated integer");
+    }
+    uint64_t limit = (1u << prefixBits) - 1;
+    uint64_t value = data[pos++] & limit;
+    if (value < limit) {
+        return value;
+    }
+    for (int shift = 0; ; shift += 7) {
+        if (pos >= length) {
+            throw std::runtime_error("HPACK: truncated integer");
+        }
+        if (shift > 28) {
+            throw std::runtime_error("HPACK: integer too large");
+        }
+        unsigned char byte = data[pos++];
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+/// @brief Appends a string literal, Huffman-coded if that is shorter.
+void encodeString(std::string& out, const std::string& text) {
+    size_t huffmanLength = huffmanEncodedLength(text);
+    if (huffmanLength < text.size()) {
+        encodeInteger(out, huffmanLength, 7, 0x80);
+        huffmanEncode(text, out);
+    } else {
+        encodeInteger(out, text.size(), 7, 0);
+        out.append(text);
+    }
+}
+
+/// @brief Reads a string literal, advancing `pos`.
+std::string decodeString(const unsigned char* data, size_t length, size_t& pos) {
+    if (pos >= length) {
+        throw std::runtime_error("HPACK: truncated string");
+    }
+    bool huffman = data[pos] & 0x80;
+    uint64_t size = decodeInteger(data, length, pos, 7);
+    if (size > length - pos) {
+        throw std::runtime_error("HPACK: truncated string");
+    }
+    const char* start = reinterpret_cast<const char*>(data + pos);
+    pos += size;
+    return huffman ? huffmanDecode(start, size) : std::string(start, size);
+}
+
+/// @brief Size of a table entry as defined by RFC 7541 section 4.1.
+size_t entrySize(const std::string& name, const std::string& value) {
+    return name.size() + value.size() + 32;
+}
+
+} // namespace
+
+void HpackDynamicTable::add(const std::string& name, const std::string& value) {
+    size_t needed = entrySize(name, value);
+    if (needed > maxSize) {
+        evict(0);
+        return;
+    }
+    evict(maxSize - needed);
+    entries.emplace_front(name, value);
+    size += needed;
+}
+
+void HpackDynamicTable::resize(size_t newSize) {
+    maxSize = newSize;
+    evict(maxSize);
+}
+
+void HpackDynamicTable::evict(size_t limit) {
+    while (size > limit && !entries.empty()) {
+        size -= entrySize(entries.back().first, entries.back().second);
+        entries.pop_back();
+    }
+}
+
+void HpackEncoder::setMaxTableSize(size_t size) {
+    // Our table never needs more than the default, even if the peer allows it.
+    size = std::min<size_t>(size, 4096);
+    if (size != table.capacity()) {
+        table.resize(size);
+        pendingSizeUpdate = size;
+    }
+}
+
+void HpackEncoder::encode(const std::vector<HeaderField>& fields, std::string& out) {
+    if (pendingSizeUpdate != SIZE_MAX) {
+        encodeInteger(out, pendingSizeUpdate, 5, 0x20);
+        pendingSizeUpdate = SIZE_MAX;
+    }
+    for (const auto& field : fields) {
+        encodeField(field.first, field.second, out);
+    }
+}
+
+void HpackEncoder::encodeField(const std::string& name, const std::string& value, std::string& out) {
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < staticTableSize; ++i) {
+        if (staticTable[i].first == name) {
+            if (staticTable[i].second == value) {
+                encodeInteger(out, i + 1, 7, 0x80);
+                return;
+            }
+            if (nameIndex == 0) {
+                nameIndex = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < table.count(); ++i) {
+        const HeaderField* entry = table.at(i);
+        if (entry->first == name) {
+            if (entry->second == value) {
+                encodeInteger(out, staticTableSize + 1 + i, 7, 0x80);
+                return;
+            }
+            if (nameIndex == 0) {
+                nameIndex = staticTableSize + 1 + i;
+            }
+        }
+    }
+
+    // Credentials are never indexed so that intermediaries do not either (RFC 7541 section 7.1.3);
+    // per-request values such as the path would only churn the table.
+    bool sensitive = name == "authorization" || name == "proxy-authorization";
+    bool indexed = !sensitive && name != ":path" && name != "content-length" && name != "range" &&
+                   entrySize(name, value) <= table.capacity() / 2;
+    if (indexed) {
+        encodeInteger(out, nameIndex, 6, 0x40);
+    } else {
+        encodeInteger(out, nameIndex, 4, sensitive ? 0x10 : 0x00);
+    }
+    if (nameIndex == 0) {
+        encodeString(out, name);
+    }
+    encodeString(out, value);
+    if (indexed) {
+        table.add(name, value);
+    }
+}
+
+const HeaderField& HpackDecoder::lookup(uint64_t index) const {
+    if (index >= 1 && index <= staticTableSize) {
+        return staticTable[index - 1];
+    }
+    const HeaderField* entry = index > staticTableSize ? table.at(index - staticTableSize - 1) : nullptr;
+    if (!entry) {
+        throw std::runtime_error("HPACK: invalid table index " + std::to_string(index));
+    }
+    return *entry;
+}
+
+std::vector<HeaderField> HpackDecoder::decode(const char* block, size_t length) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(block);
+    std::vector<HeaderField> fields;
+    size_t pos = 0;
+    while (pos < length) {
+        unsigned char byte = data[pos];
+        if (byte & 0x80) {
+            fields.push_back(lookup(decodeInteger(data, length, pos, 7)));
+        } else if ((byte & 0xe0) == 0x20) {
+            // Size updates are only allowed at the start of a block.
+            if (!fields.empty()) {
+                throw std::runtime_error("HPACK: table size update after a header field");
+            }
+            uint64_t size = decodeInteger(data, length, pos, 5);
+            if (size > maxAllowed) {
+                throw std::runtime_error("HPACK: table size update above the advertised limit");
+            }
+            table.resize(size);
+        } else {
+            bool indexing = (byte & 0xc0) == 0x40;
+            uint64_t nameIndex = decodeInteger(data, length, pos, indexing ? 6 : 4);
+            std::string name = nameIndex ? lookup(nameIndex).first : decodeString(data, length, pos);
+            std::string value = decodeString(data, length, pos);
+            if (indexing) {
+                table.add(name, value);
+            }
+            fields.emplace_back(std::move(name), std::move(value));
+        }
+    }
+    return fields;
+}
+
+size_t huffmanEncodedLength(const std::string& text) {
+    size_t bits = 0;
+    for (unsigned char c : text) {
+        bits += huffmanCodes[c].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(const std::string& text, std::string& out) {
+    uint64_t buffer = 0;
+    int bits = 0;
+    for (unsigned char c : text) {
+        buffer = (buffer << huffmanCodes[c].bits) | huffmanCodes[c].code;
+        bits += huffmanCodes[c].bits;
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(buffer >> bits));
+        }
+    }
+    if (bits > 0) {
+        // Pad with the most significant bits of EOS, which are all ones.
+        out.push_back(static_cast<char>((buffer << (8 - bits)) | (0xff >> bits)));
+    }
+}
+
+std::string huffmanDecode(const char* data, size_t length) {
+    const std::vector<HuffmanNode>& tree = huffmanTree();
+    std::string text;
+    text.reserve(length * 8 / 5);
+    size_t node = 0;
+    int pendingBits = 0;    // Bits consumed since the last complete symbol.
+    bool pendingOnes = true; // Whether all of them were ones (valid padding).
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char byte = static_cast<unsigned char>(data[i]);
+        for (int bit = 7; bit >= 0; --bit) {
+            int b = (byte >> bit) & 1;
+            int16_t next = tree[node].child[b];
+            if (next < 0) {
+                throw std::runtime_error("HPACK: invalid Huffman code");
+            }
+            node = next;
+            ++pendingBits;
+            pendingOnes = pendingOnes && b;
+            if (tree[node].symbol >= 0) {
+                if (tree[node].symbol == 256) {
+                    throw std::runtime_error("HPACK: EOS in Huffman string");
+                }
+                text.push_back(static_cast<char>(tree[node].symbol));
+                node = 0;
+                pendingBits = 0;
+                pendingOnes = true;
+            }
+        }
+    }
+    if (pendingBits > 7 || !pendingOnes) {
+        throw std::runtime_error("HPACK: invalid Huffman padding");
+    }
+    return text;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// @brief A decoded or to-be-encoded header field; names are lowercase in HTTP/2.
+using HeaderField = std::pair<std::string, std::string>;
+
+/// @brief The dynamic table shared by an HPACK encoder or decoder and its peer (RFC 7541 section 2.3.2).
+/// Entries are numbered from 62 (after the static table), newest first, and evicted oldest first
+/// once their total size (name + value + 32 each) exceeds the maximum.
+class HpackDynamicTable {
+public:
+    explicit HpackDynamicTable(size_t maxSize = 4096) : maxSize(maxSize) {}
+
+    /// @brief Inserts an entry, evicting old ones to make room. An entry larger than the table empties it.
+    void add(const std::string& name, const std::string& value);
+
+    /// @brief Changes the maximum size, evicting entries that no longer fit.
+    void resize(size_t size);
+
+    /// @brief Returns the entry at a 0-based dynamic index (newest is 0), or nullptr if out of range.
+    const HeaderField* at(size_t index) const { return index < entries.size() ? &entries[index] : nullptr; }
+
+    size_t count() const { return entries.size(); }
+    size_t capacity() const { return maxSize; }
+
+private:
+    std::deque<HeaderField> entries; ///< Newest first.
+    size_t size = 0;                 ///< Current size as defined by RFC 7541.
+    size_t maxSize;                  ///< Current maximum size.
+
+    void evict(size_t limit);
+};
+
+/// @brief Encodes header lists into HPACK header blocks.
+/// Fields are sent as static or dynamic table references when possible and otherwise as literals,
+/// Huffman-coded when that is shorter. Fields worth remembering are added to the dynamic table so that
+/// repeated headers across requests on one connection shrink to a byte or two.
+class HpackEncoder {
+public:
+    /// @brief Applies the peer's SETTINGS_HEADER_TABLE_SIZE. The change is signalled at the start of the next block.
+    void setMaxTableSize(size_t size);
+
+    /// @brief Appends the header block for `fields` to `out`.
+    void encode(const std::vector<HeaderField>& fields, std::string& out);
+
+private:
+    HpackDynamicTable table;
+    size_t pendingSizeUpdate = SIZE_MAX; ///< Table size to announce before the next block, if any.
+
+    void encodeField(const std::string& name, const std::string& value, std::string& out);
+};
+
+/// @brief Decodes HPACK header blocks, keeping the dynamic table across blocks of one connection.
+class HpackDecoder {
+public:
+    /// @brief Creates a decoder whose dynamic table may grow to `maxTableSize` (our SETTINGS_HEADER_TABLE_SIZE).
+    explicit HpackDecoder(size_t maxTableSize = 4096) : table(maxTableSize), maxAllowed(maxTableSize) {}
+
+    /// @brief Decodes a complete header block (HEADERS plus any CONTINUATION payloads).
+    /// @throws std::runtime_error on a malformed block; the connection must then be closed.
+    std::vector<HeaderField> decode(const char* data, size_t length);
+
+private:
+    HpackDynamicTable table;
+    size_t maxAllowed; ///< Upper bound for dynamic table size updates.
+
+    const HeaderField& lookup(uint64_t index) const;
+};
+
+/// @brief Appends the Huffman encoding of `text` (RFC 7541 Appendix B) to `out`.
+void huffmanEncode(const std::string& text, std::string& out);
+
+/// @brief Returns the number of bytes the Huffman encoding of `text` takes.
+size_t huffmanEncodedLength(const std::string& text);
+
+/// @brief Decodes a Huffman-coded string literal.
+/// @throws std::runtime_error on invalid padding or an embedded EOS symbol.
+std::string huffmanDecode(const char* data, size_t length);
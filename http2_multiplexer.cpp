@@ -0,0 +1,212 @@
+//http2_multiplexer.cpp
+
+#include "http2_multiplexer.h"
+#include "async_transfer.h"
+#include "http2_session.h"
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <openssl/err.h>
+
+Http2Multiplexer::Http2Multiplexer(EventLoop& loop) : loop(loop) {}
+
+Http2Multiplexer::~Http2Multiplexer() {
+    for (auto& shared : connections) {
+        if (shared->conn) {
+            loop.remove(shared->conn->sock);
+        }
+    }
+}
+
+bool Http2Multiplexer::join(AsyncTransfer& transfer) {
+    Origin& origin = origins[transfer.origin()];
+    if (origin.current && !origin.current->dead && origin.current->conn->http2->acceptsStreams()) {
+        attach(*origin.current, transfer, true);
+        return true;
+    }
+    origin.current = nullptr;
+    if (origin.http1) {
+        return false;
+    }
+    if (origin.probe) {
+        origin.waiting.push_back(&transfer);
+        return true;
+    }
+    origin.probe = &transfer;
+    return false;
+}
+
+bool Http2Multiplexer::negotiated(AsyncTransfer& transfer, Connection& conn) {
+    const unsigned char* protocol = nullptr;
+    unsigned int length = 0;
+    SSL_get0_alpn_selected(conn.ssl, &protocol, &length);
+    bool http2 = length == 2 && memcmp(protocol, "h2", 2) == 0;
+
+    Origin& origin = origins[transfer.origin()];
+    if (!http2) {
+        if (origin.probe == &transfer) {
+            origin.probe = nullptr;
+            origin.http1 = true;
+            releaseWaiting(origin);
+        }
+        return false;
+    }
+
+    auto shared = std::make_unique<Shared>();
+    shared->conn = std::make_unique<Connection>();
+    shared->conn->origin = transfer.origin();
+    shared->conn->sock = conn.sock;
+    shared->conn->ssl = conn.ssl;
+    shared->conn->http2 = std::make_unique<Http2Session>();
+    conn.sock = -1;
+    conn.ssl = nullptr;
+    Shared* raw = shared.get();
+    connections.push_back(std::move(shared));
+
+    loop.remove(raw->conn->sock);
+    loop.add(raw->conn->sock, EPOLLIN, [this, raw](uint32_t) { onEvents(*raw); });
+    origin.current = raw;
+    origin.http1 = false;
+    if (origin.probe == &transfer) {
+        origin.probe = nullptr;
+    }
+    attach(*raw, transfer, false);
+    std::vector<AsyncTransfer*> waiting;
+    waiting.swap(origin.waiting);
+    for (AsyncTransfer* waiter : waiting) {
+        if (!raw->dead) {
+            attach(*raw, *waiter, true);
+        } else {
+            waiter->connect();
+        }
+    }
+    return true;
+}
+
+void Http2Multiplexer::adopt(std::unique_ptr<Connection> conn) {
+    int flags = fcntl(conn->sock, F_GETFL);
+    if (flags != -1) {
+        fcntl(conn->sock, F_SETFL, flags | O_NONBLOCK);
+    }
+    auto shared = std::make_unique<Shared>();
+    shared->conn = std::move(conn);
+    Shared* raw = shared.get();
+    connections.push_back(std::move(shared));
+
+    loop.add(raw->conn->sock, EPOLLIN, [this, raw](uint32_t) { onEvents(*raw); });
+    Origin& origin = origins[raw->conn->origin];
+    origin.current = raw;
+    origin.http1 = false;
+    flush(*raw);
+}
+
+void Http2Multiplexer::leave(AsyncTransfer& transfer) {
+    auto stream = streams.find(&transfer);
+    if (stream != streams.end()) {
+        Shared* shared = stream->second.first;
+        uint32_t streamId = stream->second.second;
+        streams.erase(stream);
+        if (!shared->dead) {
+            shared->conn->http2->cancel(streamId);
+            if (!shared->reading) {
+                flush(*shared);
+            }
+        }
+        return;
+    }
+    auto it = origins.find(transfer.origin());
+    if (it == origins.end()) {
+        return;
+    }
+    Origin& origin = it->second;
+    origin.waiting.erase(std::remove(origin.waiting.begin(), origin.waiting.end(), &transfer), origin.waiting.end());
+    if (origin.probe == &transfer) {
+        origin.probe = nullptr;
+        releaseWaiting(origin);
+    }
+}
+
+void Http2Multiplexer::attach(Shared& shared, AsyncTransfer& transfer, bool reused) {
+    uint32_t streamId = transfer.attachStream(*shared.conn->http2, reused);
+    streams[&transfer] = std::make_pair(&shared, streamId);
+    flush(shared);
+}
+
+void Http2Multiplexer::releaseWaiting(Origin& origin) {
+    std::vector<AsyncTransfer*> waiting;
+    waiting.swap(origin.waiting);
+    for (AsyncTransfer* waiter : waiting) {
+        waiter->connect();
+    }
+}
+
+void Http2Multiplexer::onEvents(Shared& shared) {
+    Connection& conn = *shared.conn;
+    char buffer[16384];
+    while (!shared.dead) {
+        int n = SSL_read(conn.ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            int error = SSL_get_error(conn.ssl, n);
+            if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+                break;
+            }
+            fail(shared, error == SSL_ERROR_ZERO_RETURN
+                ? "The server closed the HTTP/2 connection"
+                : "SSL error: " + std::string(ERR_error_string(ERR_get_error(), nullptr)));
+            return;
+        }
+        try {
+            shared.reading = true;
+            conn.http2->feed(buffer, n);
+            shared.reading = false;
+        } catch (const std::exception& e) {
+            shared.reading = false;
+            flush(shared); // Try to deliver the GOAWAY.
+            fail(shared, e.what());
+            return;
+        }
+    }
+    if (!shared.dead) {
+        flush(shared);
+    }
+}
+
+void Http2Multiplexer::flush(Shared& shared) {
+    Connection& conn = *shared.conn;
+    while (true) {
+        std::string_view pending = conn.http2->output();
+        if (pending.empty()) {
+            loop.modify(conn.sock, EPOLLIN);
+            return;
+        }
+        // A write that wanted to be retried must be repeated with the same length (the buffer may move).
+        size_t length = shared.writing ? shared.writing : std::min<size_t>(pending.size(), INT_MAX);
+        int n = SSL_write(conn.ssl, pending.data(), static_cast<int>(length));
+        if (n <= 0) {
+            int error = SSL_get_error(conn.ssl, n);
+            if (error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ) {
+                shared.writing = length;
+                loop.modify(conn.sock, error == SSL_ERROR_WANT_WRITE ? EPOLLIN | EPOLLOUT : EPOLLIN);
+                return;
+            }
+            fail(shared, "Failed to send Request!");
+            return;
+        }
+        shared.writing = 0;
+        conn.http2->consume(n);
+    }
+}
+
+void Http2Multiplexer::fail(Shared& shared, const std::string& error) {
+    if (shared.dead) {
+        return;
+    }
+    shared.dead = true;
+    loop.remove(shared.conn->sock);
+    for (auto it = streams.begin(); it != streams.end();) {
+        it = it->second.first == &shared ? streams.erase(it) : std::next(it);
+    }
+    shared.conn->http2->fail(error);
+    shared.conn.reset();
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "connection_pool.h"
+#include "event_loop.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AsyncTransfer;
+
+/// @brief Shares HTTP/2 connections between the concurrent transfers of one event loop.
+/// The first HTTPS transfer to an origin connects as usual while later ones wait for it. If ALPN
+/// selects h2, the multiplexer takes over its connection and runs that transfer and all waiting
+/// ones as streams on it; later transfers to the origin become further streams. If the server
+/// picks HTTP/1.1 instead, the waiting transfers go back to connecting on their own.
+class Http2Multiplexer {
+public:
+    explicit Http2Multiplexer(EventLoop& loop);
+
+    /// @brief Closes all shared connections without reporting to their transfers.
+    ~Http2Multiplexer();
+
+    Http2Multiplexer(const Http2Multiplexer&) = delete;
+    Http2Multiplexer& operator=(const Http2Multiplexer&) = delete;
+
+    /// @brief Offers an HTTPS transfer a stream on its origin's connection.
+    /// @return True if the transfer was attached to a connection or now waits for the one being
+    /// negotiated; false if it must connect by itself.
+    bool join(AsyncTransfer& transfer);
+
+    /// @brief Reports a completed TLS handshake of a transfer's own connection.
+    /// If ALPN selected h2, the socket and TLS session are moved out of `conn` into a shared connection
+    /// and the transfer (with any waiting ones) runs on it as a stream.
+    /// @return True if the connection was taken over.
+    bool negotiated(AsyncTransfer& transfer, Connection& conn);
+
+    /// @brief Takes over an HTTP/2 connection established elsewhere (e.g. by the blocking path), so
+    /// transfers to its origin become streams on it instead of opening their own connections.
+    /// The socket is switched to non-blocking mode. Pending session output is flushed.
+    void adopt(std::unique_ptr<Connection> conn);
+
+    /// @brief Forgets a finished transfer: a wait ends, an open stream is cancelled, and if the
+    /// transfer was negotiating for its origin the waiting transfers connect on their own.
+    void leave(AsyncTransfer& transfer);
+
+private:
+    /// @brief One HTTP/2 connection and its write state.
+    struct Shared {
+        std::unique_ptr<Connection> conn; ///< Socket, TLS session and HTTP/2 session; null once closed.
+        size_t writing = 0;               ///< Length of an SSL_write that must be retried, 0 if none.
+        bool dead = false;                ///< The connection failed or was closed.
+        bool reading = false;             ///< Inside the session's feed(); onEvents() flushes afterwards.
+    };
+
+    /// @brief What is known about one origin.
+    struct Origin {
+        AsyncTransfer* probe = nullptr;       ///< Transfer whose handshake decides the protocol, if any.
+        std::vector<AsyncTransfer*> waiting;  ///< Transfers waiting for that handshake.
+        Shared* current = nullptr;            ///< Connection new streams go to.
+        bool http1 = false;                   ///< The server chose HTTP/1.1.
+    };
+
+    EventLoop& loop;
+    std::map<std::string, Origin> origins;
+    std::vector<std::unique_ptr<Shared>> connections;                 ///< Every connection opened, live or not.
+    std::map<AsyncTransfer*, std::pair<Shared*, uint32_t>> streams;  ///< Stream of each attached transfer.
+
+    /// @brief Starts a transfer as a stream and flushes its frames.
+    void attach(Shared& shared, AsyncTransfer& transfer, bool reused);
+
+    /// @brief Lets the transfers waiting for an origin connect by themselves.
+    void releaseWaiting(Origin& origin);
+
+    void onEvents(Shared& shared);
+
+    /// @brief Writes pending frames and updates the epoll interest.
+    void flush(Shared& shared);
+
+    /// @brief Closes a connection and ends its streams with `error`.
+    void fail(Shared& shared, const std::string& error);
+};
@@ -0,0 +1,653 @@
+//http2_session.cpp
+
+#include "http2_session.h"
+#include "request_serializer.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace {
+
+/// @brief Frame types (RFC 9113 section 6).
+enum FrameType : uint8_t {
+    DataFrame = 0x0,
+    HeadersFrame = 0x1,
+    PriorityFrame = 0x2,
+    RstStreamFrame = 0x3,
+    SettingsFrame = 0x4,
+    PushPromiseFrame = 0x5,
+    PingFrame = 0x6,
+    GoAwayFrame = 0x7,
+    WindowUpdateFrame = 0x8,
+    ContinuationFrame = 0x9
+};
+
+const uint8_t flagEndStream = 0x1;
+const uint8_t flagAck = 0x1;
+const uint8_t flagEndHeaders = 0x4;
+const uint8_t flagPadded = 0x8;
+const uint8_t flagPriority = 0x20;
+
+/// @brief Error codes (RFC 9113 section 7).
+const uint32_t noError = 0x0;
+const uint32_t protocolError = 0x1;
+const uint32_t flowControlError = 0x3;
+const uint32_t frameSizeError = 0x6;
+const uint32_t cancelError = 0x8;
+const uint32_t compressionError = 0x9;
+
+/// @brief The fixed start of every client connection.
+const char connectionPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/// @brief Receive windows we advertise. Data is handed to the stream as it arrives, so these
+/// only bound how far the server may run ahead of us, not how much we buffer.
+const uint32_t streamReceiveWindow = 16 << 20;
+const uint32_t connectionReceiveWindow = 64 << 20;
+
+/// @brief Largest frame we accept (the protocol default; we never raise it).
+const uint32_t maxFrameSize = 16384;
+
+/// @brief Largest header block we assemble from HEADERS and CONTINUATION frames.
+const size_t maxHeaderBlock = 256 * 1024;
+
+const uint32_t maxWindow = 0x7fffffff;
+
+uint32_t readUint32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+}
+
+void appendUint32(std::string& out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void appendSetting(std::string& out, uint16_t id, uint32_t value) {
+    out.push_back(static_cast<char>(id >> 8));
+    out.push_back(static_cast<char>(id));
+    appendUint32(out, value);
+}
+
+/// @brief Returns the name of an error code for messages.
+std::string errorName(uint32_t code) {
+    static const char* const names[] = {
+        "NO_ERROR", "PROTOCOL_ERROR", "INTERNAL_ERROR", "FLOW_CONTROL_ERROR", "SETTINGS_TIMEOUT",
+        "STREAM_CLOSED", "FRAME_SIZE_ERROR", "REFUSED_STREAM", "CANCEL", "COMPRESSION_ERROR",
+        "CONNECT_ERROR", "ENHANCE_YOUR_CALM", "INADEQUATE_SECURITY", "HTTP_1_1_REQUIRED"};
+    return code < sizeof(names) / sizeof(names[0]) ? names[code] : "error " + std::to_string(code);
+}
+
+std::string toLower(std::string text) {
+    for (char& c : text) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+/// @brief Strips the whitespace HTTP/1 tolerates around field values; HTTP/2 rejects it.
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+}
+
+/// @brief Returns true for HTTP/1 connection-specific fields, which are not allowed in HTTP/2.
+bool isConnectionSpecific(const std::string& name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+} // namespace
+
+Http2Session::Http2Session() {
+    out.append(connectionPreface, sizeof(connectionPreface) - 1);
+    std::string settings;
+    appendSetting(settings, 0x2, 0);                   // SETTINGS_ENABLE_PUSH
+    appendSetting(settings, 0x4, streamReceiveWindow); // SETTINGS_INITIAL_WINDOW_SIZE
+    writeFrameHeader(settings.size(), SettingsFrame, 0, 0);
+    out.append(settings);
+    writeWindowUpdate(0, connectionReceiveWindow - 65535);
+}
+
+void Http2Session::writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    appendUint32(out, streamId & maxWindow);
+}
+
+void Http2Session::writeWindowUpdate(uint32_t streamId, uint32_t increment) {
+    writeFrameHeader(4, WindowUpdateFrame, 0, streamId);
+    appendUint32(out, increment);
+}
+
+void Http2Session::writeGoAway(uint32_t errorCode) {
+    writeFrameHeader(8, GoAwayFrame, 0, 0);
+    appendUint32(out, 0); // We never accept server-initiated streams.
+    appendUint32(out, errorCode);
+}
+
+void Http2Session::consume(size_t count) {
+    outOffset += count;
+    if (outOffset >= out.size()) {
+        out.clear();
+        outOffset = 0;
+    } else if (outOffset > 65536 && outOffset > out.size() / 2) {
+        out.erase(0, outOffset);
+        outOffset = 0;
+    }
+}
+
+uint32_t Http2Session::submit(const HttpRequest& request, HttpResponse& response, StreamHandler handler) {
+    if (!acceptsStreams()) {
+        throw std::runtime_error("HTTP/2 connection is not accepting new streams");
+    }
+    uint32_t streamId = nextStreamId;
+    nextStreamId += 2;
+    Stream stream;
+    stream.id = streamId;
+    stream.request = &request;
+    stream.response = &response;
+    stream.handler = std::move(handler);
+    stream.body = request.data;
+    queued.push_back(std::move(stream));
+    openQueued();
+    return streamId;
+}
+
+void Http2Session::cancel(uint32_t streamId) {
+    for (auto it = queued.begin(); it != queued.end(); ++it) {
+        if (it->id == streamId) {
+            queued.erase(it);
+            return;
+        }
+    }
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
+    }
+    streams.erase(it);
+    if (!closed) {
+        writeFrameHeader(4, RstStreamFrame, 0, streamId);
+        appendUint32(out, cancelError);
+        openQueued();
+    }
+}
+
+void Http2Session::fail(const std::string& error) {
+    closed = true;
+    std::vector<StreamHandler> handlers;
+    for (auto& entry : streams) {
+        handlers.push_back(std::move(entry.second.handler));
+    }
+    for (auto& stream : queued) {
+        handlers.push_back(std::move(stream.handler));
+    }
+    streams.clear();
+    queued.clear();
+    for (auto& handler : handlers) {
+        if (handler.onClose) {
+            handler.onClose(error);
+        }
+    }
+}
+
+void Http2Session::openQueued() {
+    while (!closed && !queued.empty() && streams.size() < maxConcurrentStreams) {
+        Stream stream = std::move(queued.front());
+        queued.pop_front();
+        stream.sendWindow = peerInitialWindow;
+        Stream& opened = streams.emplace(stream.id, std::move(stream)).first->second;
+        sendHeaders(opened);
+    }
+    sendData();
+}
+
+void Http2Session::sendHeaders(Stream& stream) {
+    const HttpRequest& request = *stream.request;
+    std::string target = request.url.target();
+    std::vector<HeaderField> fields = {
+        {":method", HttpMethodToString.at(request.method)},
+        {":scheme", request.url.protocol},
+        {":authority", request.url.authority()},
+        {":path", target.empty() ? "/" : target},
+    };
+    bool hasAuthorization = false;
+    bool hasContentLength = false;
+    auto addField = [&](const std::string& rawName, const std::string& rawValue) {
+        std::string name = toLower(rawName);
+        std::string value = trim(rawValue);
+        if (isConnectionSpecific(name) || (name == "te" && value != "trailers")) {
+            return;
+        }
+        if (name == "host") {
+            fields[2].second = value;
+            return;
+        }
+        hasAuthorization = hasAuthorization || name == "authorization";
+        hasContentLength = hasContentLength || name == "content-length";
+        fields.emplace_back(std::move(name), std::move(value));
+    };
+    if (request.sharedHeaders) {
+        for (const auto& field : request.sharedHeaders->fields()) {
+            bool overridden = false;
+            for (const auto& own : request.headers) {
+                overridden = overridden || toLower(own.first) == toLower(field.first);
+            }
+            if (!overridden) {
+                addField(field.first, field.second);
+            }
+        }
+    }
+    for (const auto& field : request.headers) {
+        addField(field.first, field.second);
+    }
+    if (!request.url.userinfo.empty() && !hasAuthorization) {
+        fields.emplace_back("authorization", basicAuthorization(request.url.userinfo));
+    }
+    if (!stream.body.empty() && !hasContentLength) {
+        fields.emplace_back("content-length", std::to_string(stream.body.size()));
+    }
+
+    std::string block;
+    encoder.encode(fields, block);
+    stream.localClosed = stream.body.empty();
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(block.size() - offset, peerMaxFrameSize);
+        bool last = offset + length == block.size();
+        uint8_t flags = last ? flagEndHeaders : 0;
+        if (offset == 0 && stream.localClosed) {
+            flags |= flagEndStream;
+        }
+        writeFrameHeader(length, offset == 0 ? HeadersFrame : ContinuationFrame, flags, stream.id);
+        out.append(block, offset, length);
+        offset += length;
+    } while (offset < block.size());
+}
+
+void Http2Session::sendData() {
+    // One frame per stream per pass, so concurrent uploads share the connection window.
+    bool progress = true;
+    while (progress && connectionSendWindow > 0 && !closed) {
+        progress = false;
+        for (auto& entry : streams) {
+            Stream& stream = entry.second;
+            if (stream.localClosed || stream.sendWindow <= 0 || connectionSendWindow <= 0) {
+                continue;
+            }
+            size_t length = std::min<size_t>({stream.body.size(), static_cast<size_t>(stream.sendWindow),
+                                              static_cast<size_t>(connectionSendWindow), peerMaxFrameSize});
+            bool last = length == stream.body.size();
+            writeFrameHeader(length, DataFrame, last ? flagEndStream : 0, stream.id);
+            out.append(stream.body.data(), length);
+            stream.body.remove_prefix(length);
+            stream.sendWindow -= length;
+            connectionSendWindow -= length;
+            stream.localClosed = last;
+            progress = true;
+        }
+    }
+}
+
+void Http2Session::feed(const char* data, size_t length) {
+    std::string buffered;
+    if (!in.empty()) {
+        buffered.swap(in);
+        buffered.append(data, length);
+        data = buffered.data();
+        length = buffered.size();
+    }
+    size_t pos = 0;
+    while (length - pos >= 9 && !closed) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(data + pos);
+        size_t frameLength = (size_t(header[0]) << 16) | (size_t(header[1]) << 8) | header[2];
+        if (frameLength > maxFrameSize) {
+            connectionError(frameSizeError, "HTTP/2 frame too large");
+        }
+        if (length - pos - 9 < frameLength) {
+            break;
+        }
+        uint32_t streamId = readUint32(data + pos + 5) & maxWindow;
+        onFrame(header[3], header[4], streamId, data + pos + 9, frameLength);
+        pos += 9 + frameLength;
+    }
+    in.assign(data + pos, length - pos);
+}
+
+void Http2Session::onFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char* payload, size_t length) {
+    if (headerStream != 0 && (type != ContinuationFrame || streamId != headerStream)) {
+        connectionError(protocolError, "HTTP/2 header block interrupted by another frame");
+    }
+    switch (type) {
+        case DataFrame:
+            onData(flags, streamId, payload, length);
+            break;
+        case HeadersFrame:
+            onHeaders(flags, streamId, payload, length);
+            break;
+        case ContinuationFrame:
+            if (headerStream == 0) {
+                connectionError(protocolError, "Unexpected HTTP/2 CONTINUATION frame");
+            }
+            if (headerBlock.size() + length > maxHeaderBlock) {
+                connectionError(protocolError, "HTTP/2 header block too large");
+            }
+            headerBlock.append(payload, length);
+            if (flags & flagEndHeaders) {
+                onHeaderBlock();
+            }
+            break;
+        case RstStreamFrame:
+            if (length != 4) {
+                connectionError(frameSizeError, "Invalid HTTP/2 RST_STREAM frame");
+            }
+            if (streamId == 0) {
+                connectionError(protocolError, "HTTP/2 RST_STREAM on stream 0");
+            }
+            closeStream(streamId, "Stream reset by the server: " + errorName(readUint32(payload)));
+            break;
+        case SettingsFrame:
+            if (streamId != 0) {
+                connectionError(protocolError, "HTTP/2 SETTINGS on a stream");
+            }
+            onSettings(flags, payload, length);
+            break;
+        case PushPromiseFrame:
+            connectionError(protocolError, "HTTP/2 server push was not enabled");
+        case PingFrame:
+            if (length != 8) {
+                connectionError(frameSizeError, "Invalid HTTP/2 PING frame");
+            }
+            if (!(flags & flagAck)) {
+                writeFrameHeader(8, PingFrame, flagAck, 0);
+                out.append(payload, 8);
+            }
+            break;
+        case GoAwayFrame:
+            onGoAway(payload, length);
+            break;
+        case WindowUpdateFrame:
+            onWindowUpdate(streamId, payload, length);
+            break;
+        default:
+            break; // PRIORITY and unknown frame types are ignored.
+    }
+}
+
+void Http2Session::onData(uint8_t flags, uint32_t streamId, const char* payload, size_t length) {
+    if (streamId == 0 || streamId >= nextStreamId || streamId % 2 == 0) {
+        connectionError(protocolError, "HTTP/2 DATA on an invalid stream");
+    }
+    // Padding counts against flow control like data, so acknowledge the whole frame.
+    connectionUnacknowledged += length;
+    if (connectionUnacknowledged >= connectionReceiveWindow / 2) {
+        writeWindowUpdate(0, connectionUnacknowledged);
+        connectionUnacknowledged = 0;
+    }
+    size_t dataLength = length;
+    if (flags & flagPadded) {
+        if (length == 0 || static_cast<unsigned char>(payload[0]) >= length) {
+            connectionError(protocolError, "Invalid HTTP/2 padding");
+        }
+        dataLength = length - 1 - static_cast<unsigned char>(payload[0]);
+        ++payload;
+    }
+
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return; // Data for a stream we already closed or cancelled.
+    }
+    if (!it->second.finalHeaders) {
+        writeFrameHeader(4, RstStreamFrame, 0, streamId);
+        appendUint32(out, protocolError);
+        closeStream(streamId, "HTTP/2 response data before headers");
+        return;
+    }
+    if (dataLength > 0 && it->second.handler.onData) {
+        it->second.handler.onData(payload, dataLength);
+        it = streams.find(streamId); // The handler may have cancelled the stream.
+        if (it == streams.end()) {
+            return;
+        }
+    }
+    if (flags & flagEndStream) {
+        closeStream(streamId, "");
+        return;
+    }
+    Stream& stream = it->second;
+    stream.unacknowledged += length;
+    if (stream.unacknowledged >= streamReceiveWindow / 2) {
+        writeWindowUpdate(streamId, stream.unacknowledged);
+        stream.unacknowledged = 0;
+    }
+}
+
+void Http2Session::onHeaders(uint8_t flags, uint32_t streamId, const char* payload, size_t length) {
+    if (streamId == 0) {
+        connectionError(protocolError, "HTTP/2 HEADERS on stream 0");
+    }
+    size_t padding = 0;
+    if (flags & flagPadded) {
+        if (length == 0) {
+            connectionError(protocolError, "Invalid HTTP/2 padding");
+        }
+        padding = static_cast<unsigned char>(payload[0]);
+        ++payload;
+        --length;
+    }
+    if (flags & flagPriority) {
+        if (length < 5) {
+            connectionError(protocolError, "Invalid HTTP/2 HEADERS frame");
+        }
+        payload += 5;
+        length -= 5;
+    }
+    if (padding > length) {
+        connectionError(protocolError, "Invalid HTTP/2 padding");
+    }
+    headerBlock.assign(payload, length - padding);
+    headerStream = streamId;
+    headerEndStream = flags & flagEndStream;
+    if (flags & flagEndHeaders) {
+        onHeaderBlock();
+    }
+}
+
+void Http2Session::onHeaderBlock() {
+    uint32_t streamId = headerStream;
+    headerStream = 0;
+    std::vector<HeaderField> fields;
+    try {
+        // Blocks of streams we no longer track must still be decoded to keep the tables in sync.
+        fields = decoder.decode(headerBlock.data(), headerBlock.size());
+    } catch (const std::exception& e) {
+        connectionError(compressionError, e.what());
+    }
+    headerBlock.clear();
+    if (streamId >= nextStreamId || streamId % 2 == 0) {
+        connectionError(protocolError, "HTTP/2 HEADERS on an invalid stream");
+    }
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
+    }
+    Stream& stream = it->second;
+    if (!stream.finalHeaders) {
+        int status = 0;
+        if (!fields.empty() && fields[0].first == ":status" && fields[0].second.size() == 3 &&
+            std::all_of(fields[0].second.begin(), fields[0].second.end(), ::isdigit)) {
+            status = std::stoi(fields[0].second);
+        }
+        if (status < 100) {
+            writeFrameHeader(4, RstStreamFrame, 0, streamId);
+            appendUint32(out, protocolError);
+            closeStream(streamId, "Invalid HTTP/2 response headers");
+            return;
+        }
+        if (status < 200) {
+            return; // Informational response; the final one follows.
+        }
+        HttpResponse& response = *stream.response;
+        response.statusLine = "HTTP/2 " + fields[0].second;
+        response.statusCode = status;
+        for (size_t i = 1; i < fields.size(); ++i) {
+            if (fields[i].first.empty() || fields[i].first[0] != ':') {
+                response.headers.add(fields[i].first, fields[i].second);
+            }
+        }
+        stream.finalHeaders = true;
+        if (stream.handler.onHeaders) {
+            stream.handler.onHeaders();
+        }
+    } else {
+        if (!headerEndStream) {
+            writeFrameHeader(4, RstStreamFrame, 0, streamId);
+            appendUint32(out, protocolError);
+            closeStream(streamId, "HTTP/2 trailers without END_STREAM");
+            return;
+        }
+        for (const auto& field : fields) {
+            stream.response->trailers.add(field.first, field.second);
+        }
+    }
+    if (headerEndStream) {
+        closeStream(streamId, "");
+    }
+}
+
+void Http2Session::onSettings(uint8_t flags, const char* payload, size_t length) {
+    if (flags & flagAck) {
+        if (length != 0) {
+            connectionError(frameSizeError, "Invalid HTTP/2 SETTINGS acknowledgement");
+        }
+        return;
+    }
+    if (length % 6 != 0) {
+        connectionError(frameSizeError, "Invalid HTTP/2 SETTINGS frame");
+    }
+    for (size_t pos = 0; pos < length; pos += 6) {
+        uint16_t id = static_cast<uint16_t>((static_cast<unsigned char>(payload[pos]) << 8) |
+                                            static_cast<unsigned char>(payload[pos + 1]));
+        uint32_t value = readUint32(payload + pos + 2);
+        switch (id) {
+            case 0x1: // SETTINGS_HEADER_TABLE_SIZE
+                encoder.setMaxTableSize(value);
+                break;
+            case 0x3: // SETTINGS_MAX_CONCURRENT_STREAMS
+                maxConcurrentStreams = value;
+                break;
+            case 0x4: { // SETTINGS_INITIAL_WINDOW_SIZE applies retroactively to open streams
+                if (value > maxWindow) {
+                    connectionError(flowControlError, "Invalid HTTP/2 initial window size");
+                }
+                int64_t delta = static_cast<int64_t>(value) - peerInitialWindow;
+                for (auto& entry : streams) {
+                    entry.second.sendWindow += delta;
+                }
+                peerInitialWindow = value;
+                break;
+            }
+            case 0x5: // SETTINGS_MAX_FRAME_SIZE
+                if (value < 16384 || value > 16777215) {
+                    connectionError(protocolError, "Invalid HTTP/2 max frame size");
+                }
+                peerMaxFrameSize = value;
+                break;
+            default:
+                break;
+        }
+    }
+    writeFrameHeader(0, SettingsFrame, flagAck, 0);
+    openQueued();
+}
+
+void Http2Session::onWindowUpdate(uint32_t streamId, const char* payload, size_t length) {
+    if (length != 4) {
+        connectionError(frameSizeError, "Invalid HTTP/2 WINDOW_UPDATE frame");
+    }
+    uint32_t increment = readUint32(payload) & maxWindow;
+    if (streamId == 0) {
+        if (increment == 0 || connectionSendWindow + increment > maxWindow) {
+            connectionError(increment == 0 ? protocolError : flowControlError, "Invalid HTTP/2 window update");
+        }
+        connectionSendWindow += increment;
+    } else {
+        auto it = streams.find(streamId);
+        if (it == streams.end()) {
+            return;
+        }
+        if (increment == 0 || it->second.sendWindow + increment > maxWindow) {
+            writeFrameHeader(4, RstStreamFrame, 0, streamId);
+            appendUint32(out, increment == 0 ? protocolError : flowControlError);
+            closeStream(streamId, "Invalid HTTP/2 window update");
+            return;
+        }
+        it->second.sendWindow += increment;
+    }
+    sendData();
+}
+
+void Http2Session::onGoAway(const char* payload, size_t length) {
+    if (length < 8) {
+        connectionError(frameSizeError, "Invalid HTTP/2 GOAWAY frame");
+    }
+    uint32_t lastStreamId = readUint32(payload) & maxWindow;
+    uint32_t errorCode = readUint32(payload + 4);
+    goingAway = true;
+    // Streams above the last id (and queued ones) were never processed by the server. They are failed
+    // rather than retried here; the error says the request was not processed, so it is safe to send
+    // again on another connection. Streams up to the last id still complete.
+    std::string error = "The server closed the HTTP/2 connection before processing the request (" +
+                        errorName(errorCode) + ")";
+    std::vector<uint32_t> refused;
+    for (const auto& entry : streams) {
+        if (entry.first > lastStreamId) {
+            refused.push_back(entry.first);
+        }
+    }
+    std::vector<StreamHandler> queuedHandlers;
+    for (auto& stream : queued) {
+        queuedHandlers.push_back(std::move(stream.handler));
+    }
+    queued.clear();
+    for (uint32_t id : refused) {
+        closeStream(id, error);
+    }
+    for (auto& handler : queuedHandlers) {
+        if (handler.onClose) {
+            handler.onClose(error);
+        }
+    }
+}
+
+void Http2Session::closeStream(uint32_t streamId, const std::string& error) {
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
+    }
+    if (!it->second.localClosed && error.empty()) {
+        // The server answered before the whole body was sent; stop sending it.
+        writeFrameHeader(4, RstStreamFrame, 0, streamId);
+        appendUint32(out, noError);
+    }
+    StreamHandler handler = std::move(it->second.handler);
+    streams.erase(it);
+    openQueued();
+    if (handler.onClose) {
+        handler.onClose(error);
+    }
+}
+
+void Http2Session::connectionError(uint32_t errorCode, const std::string& message) {
+    if (!closed) {
+        writeGoAway(errorCode);
+    }
+    throw std::runtime_error(message);
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "hpack.h"
+#include "http_client.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Client side of one HTTP/2 connection (RFC 9113), independent of how bytes are moved.
+/// The session turns requests into frames in an output buffer and turns frames fed from the
+/// transport into responses, so the same code serves blocking sockets and the epoll loop.
+/// Any number of requests may be submitted; they become concurrent streams up to the server's
+/// SETTINGS_MAX_CONCURRENT_STREAMS and wait their turn beyond that. Request bodies are sent
+/// within the peer's flow-control windows, and received data is acknowledged with WINDOW_UPDATE
+/// as it is handed to the stream, so the receive windows never limit a consumer that keeps up.
+class Http2Session {
+public:
+    /// @brief What a stream reports back. All callbacks are invoked from feed() or fail().
+    struct StreamHandler {
+        std::function<void()> onHeaders;                  ///< The final response headers are in the response.
+        std::function<void(const char*, size_t)> onData;  ///< A piece of the response body.
+        std::function<void(const std::string&)> onClose;  ///< The stream ended; the error is empty on success.
+    };
+
+    /// @brief Queues the connection preface and our SETTINGS.
+    Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    /// @brief Starts a request as a new stream, or queues it until the server allows another stream.
+    /// The request and response must stay alive until the stream closes or is cancelled.
+    /// @param request The request; its body is sent from request.data without being copied first.
+    /// @param response Receives the status, headers, trailers and timing-independent fields.
+    /// @param handler Receives the stream's events.
+    /// @return The stream id, for cancel().
+    /// @throws std::runtime_error if the connection no longer accepts streams.
+    uint32_t submit(const HttpRequest& request, HttpResponse& response, StreamHandler handler);
+
+    /// @brief Abandons a stream: it is reset with CANCEL (or dropped if still queued) and its handler
+    /// is not called again.
+    void cancel(uint32_t streamId);
+
+    /// @brief Processes bytes received from the server. Stream callbacks run from here.
+    /// @throws std::runtime_error on a connection error. A GOAWAY is queued; the caller should flush
+    /// the output, call fail() and close the connection.
+    void feed(const char* data, size_t length);
+
+    /// @brief Ends every stream with `error` because the connection is gone.
+    void fail(const std::string& error);
+
+    /// @brief Returns the bytes waiting to be written to the transport.
+    std::string_view output() const { return std::string_view(out).substr(outOffset); }
+
+    /// @brief Drops the first `count` bytes of output() once they have been written.
+    void consume(size_t count);
+
+    /// @brief Returns true while new requests may be submitted (no GOAWAY, no error, stream ids left).
+    bool acceptsStreams() const { return !closed && !goingAway && nextStreamId < 0x7fffffff; }
+
+    /// @brief Returns the number of streams that are open or queued.
+    size_t activeStreams() const { return streams.size() + queued.size(); }
+
+private:
+    struct Stream {
+        uint32_t id = 0;
+        const HttpRequest* request = nullptr;
+        HttpResponse* response = nullptr;
+        StreamHandler handler;
+        std::string_view body;           ///< Part of the request body not yet sent.
+        int64_t sendWindow = 0;          ///< Bytes the server currently lets us send on this stream.
+        uint32_t unacknowledged = 0;     ///< Bytes received since the last stream WINDOW_UPDATE.
+        bool finalHeaders = false;       ///< The non-informational response headers arrived.
+        bool localClosed = false;        ///< END_STREAM has been sent.
+    };
+
+    std::string out;          ///< Frames waiting to be written.
+    size_t outOffset = 0;     ///< Bytes at the front of `out` already written.
+    std::string in;           ///< Partial frame carried over between feed() calls.
+    std::map<uint32_t, Stream> streams; ///< Open streams by id.
+    std::deque<Stream> queued;          ///< Submitted streams waiting for MAX_CONCURRENT_STREAMS.
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    uint32_t nextStreamId = 1;
+
+    // Peer settings.
+    uint32_t maxConcurrentStreams = 100; ///< Assumed until the server's SETTINGS say otherwise.
+    uint32_t peerInitialWindow = 65535;
+    uint32_t peerMaxFrameSize = 16384;
+
+    int64_t connectionSendWindow = 65535;
+    uint32_t connectionUnacknowledged = 0; ///< Bytes received since the last connection WINDOW_UPDATE.
+
+    std::string headerBlock;        ///< HEADERS/CONTINUATION payload being assembled.
+    uint32_t headerStream = 0;      ///< Stream of the block being assembled, 0 if none.
+    bool headerEndStream = false;   ///< The HEADERS frame of that block carried END_STREAM.
+
+    bool goingAway = false; ///< The server sent GOAWAY.
+    bool closed = false;    ///< The connection failed or was failed.
+
+    void writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId);
+    void writeWindowUpdate(uint32_t streamId, uint32_t increment);
+    void writeGoAway(uint32_t errorCode);
+
+    /// @brief Opens queued streams while the server's stream limit allows.
+    void openQueued();
+    void sendHeaders(Stream& stream);
+
+    /// @brief Sends request body data within the flow-control windows.
+    void sendData();
+
+    /// @brief Handles one complete frame.
+    void onFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char* payload, size_t length);
+    void onData(uint8_t flags, uint32_t streamId, const char* payload, size_t length);
+    void onHeaders(uint8_t flags, uint32_t streamId, const char* payload, size_t length);
+    void onHeaderBlock();
+    void onSettings(uint8_t flags, const char* payload, size_t length);
+    void onWindowUpdate(uint32_t streamId, const char* payload, size_t length);
+    void onGoAway(const char* payload, size_t length);
+
+    /// @brief Removes a stream and reports its end.
+    void closeStream(uint32_t streamId, const std::string& error);
+
+    /// @brief Queues a GOAWAY and throws the connection error.
+    [[noreturn]] void connectionError(uint32_t errorCode, const std::string& message);
+};
@@ -0,0 +1,600 @@
+//http_cache.cpp
+
+#include "http_cache.h"
+#include "io_util.h"
+#include "request_serializer.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <strings.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/// @brief Freshness given to responses that only carry Last-Modified is capped at one day.
+const int64_t maxHeuristicLifetime = 24 * 60 * 60;
+/// @brief Age after which a file no entry names is taken to be left over rather than being written.
+const std::time_t abandonedFileAge = 60 * 60;
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return std::string_view();
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+/// @brief Calls `visit` with each element of a comma-separated header value, trimmed.
+template <typename Visit>
+void forEachElement(std::string_view value, Visit visit) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view element = trim(value.substr(0, comma));
+        if (!element.empty()) {
+            visit(element);
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+}
+
+/// @brief Looks for a Cache-Control directive, e.g. "no-store" or "max-age".
+/// @param value Receives the directive's numeric argument, or -1 if it has none or it is not a number.
+bool hasDirective(std::string_view cacheControl, std::string_view name, int64_t* value = nullptr) {
+    bool found = false;
+    forEachElement(cacheControl, [&](std::string_view element) {
+        size_t equals = element.find('=');
+        if (found || !equalsIgnoreCase(trim(element.substr(0, equals)), name)) {
+            return;
+        }
+        found = true;
+        if (value) {
+            *value = -1;
+            if (equals != std::string_view::npos) {
+                std::string argument(trim(element.substr(equals + 1)));
+                if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"') {
+                    argument = argument.substr(1, argument.size() - 2);
+                }
+                char* end = nullptr;
+                long long number = std::strtoll(argument.c_str(), &end, 10);
+                if (!argument.empty() && *end == '\0' && number >= 0) {
+                    *value = number;
+                }
+            }
+        }
+    });
+    return found;
+}
+
+/// @brief Parses an HTTP date ("Sun, 06 Nov 1994 08:49:37 GMT").
+/// @return Seconds since the epoch, or -1 if the value is not a valid date.
+int64_t parseHttpDate(std::string_view text) {
+    std::string copy(trim(text));
+    struct tm fields;
+    memset(&fields, 0, sizeof(fields));
+    const char* end = strptime(copy.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &fields);
+    if (!end || *end != '\0') {
+        return -1;
+    }
+    return static_cast<int64_t>(timegm(&fields));
+}
+
+/// @brief Returns the age a response already had when it arrived: its Age header, or the time since
+/// its Date if that is larger.
+int64_t initialAgeOf(const HttpHeaders& headers, std::time_t now) {
+    int64_t age = std::max<int64_t>(std::strtoll(std::string(headers.get(KnownHeader::Age)).c_str(), nullptr, 10), 0);
+    int64_t date = parseHttpDate(headers.get(KnownHeader::Date));
+    if (date >= 0) {
+        age = std::max<int64_t>(age, static_cast<int64_t>(now) - date);
+    }
+    return age;
+}
+
+/// @brief Returns a request header's value (case-insensitive), looking at the request's own headers
+/// and then its shared headers; empty if absent.
+std::string requestHeader(const HttpRequest& request, std::string_view name) {
+    for (const auto& header : request.headers) {
+        if (equalsIgnoreCase(header.first, name)) {
+            return header.second;
+        }
+    }
+    if (request.sharedHeaders) {
+        const std::string* value = request.sharedHeaders->find(std::string(name));
+        if (value) {
+            return *value;
+        }
+    }
+    return std::string();
+}
+
+/// @brief Returns the request header values a response varies on.
+std::vector<std::pair<std::string, std::string>> varyValues(const HttpRequest& request, const HttpHeaders& headers) {
+    std::vector<std::pair<std::string, std::string>> values;
+    forEachElement(headers.get(KnownHeader::Vary), [&](std::string_view name) {
+        values.emplace_back(std::string(name), requestHeader(request, name));
+    });
+    return values;
+}
+
+/// @brief Header fields a 304 response does not update in the stored response.
+bool keepsStoredField(std::string_view name) {
+    static const std::string_view kept[] = {
+        "Content-Length", "Content-Encoding", "Content-Range", "Transfer-Encoding", "Connection", "Keep-Alive",
+    };
+    for (std::string_view field : kept) {
+        if (equalsIgnoreCase(name, field)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Returns the SHA-256 of a cache key in hex, which names the key's files.
+std::string hashName(const std::string& key) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    EVP_Digest(key.data(), key.size(), digest, &digestLength, EVP_sha256(), nullptr);
+    static const char hex[] = "0123456789abcdef";
+    std::string name;
+    for (unsigned int i = 0; i < digestLength; ++i) {
+        name += hex[digest[i] >> 4];
+        name += hex[digest[i] & 0xf];
+    }
+    return name;
+}
+
+/// @brief Returns a file name no other writer (thread or process) uses.
+std::string uniqueName(const std::string& prefix, const char* suffix) {
+    static std::atomic<uint64_t> counter{0};
+    std::ostringstream name;
+    name << prefix << '.' << getpid() << '-' << std::time(nullptr) << '-' << counter++ << suffix;
+    return name.str();
+}
+
+/// @brief Copies `length` bytes from `in` (starting at `offset`) to `out` (at its current offset).
+/// Uses copy_file_range, which stays in the kernel and may share blocks, and falls back to pread/write
+/// where the file systems do not support it.
+void copyRange(int in, uint64_t offset, int out, uint64_t length) {
+    loff_t inOffset = static_cast<loff_t>(offset);
+    uint64_t end = offset + length;
+    bool kernelCopy = true;
+    char buffer[65536];
+    while (static_cast<uint64_t>(inOffset) < end) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(end - inOffset, kernelCopy ? 1u << 30 : sizeof(buffer)));
+        ssize_t n;
+        if (kernelCopy) {
+            n = copy_file_range(in, &inOffset, out, nullptr, want, 0);
+            if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                kernelCopy = false;
+                continue;
+            }
+        } else {
+            n = pread(in, buffer, want, inOffset);
+            if (n > 0) {
+                writeAll(out, buffer, static_cast<size_t>(n), "cached body copy");
+                inOffset += n;
+            }
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to copy cached body: " + std::string(strerror(errno)));
+        }
+        if (n == 0) {
+            throw std::runtime_error("Cached body is shorter than expected");
+        }
+    }
+}
+
+/// @brief Reads a whole file; returns false if it cannot be opened.
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream out;
+    out << in.rdbuf();
+    contents = out.str();
+    return true;
+}
+
+/// @brief Returns the value of a "name: value" line in a meta file's bookkeeping part, or empty.
+std::string metaValue(const std::string& meta, const std::string& name) {
+    std::string prefix = name + ": ";
+    size_t start = meta.compare(0, prefix.size(), prefix) == 0 ? 0 : meta.find("\n" + prefix);
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    start += start == 0 ? prefix.size() : prefix.size() + 1;
+    return meta.substr(start, meta.find('\n', start) - start);
+}
+
+} // namespace
+
+HttpCache::Entry::~Entry() {
+    if (bodyFd != -1) {
+        close(bodyFd);
+    }
+}
+
+int64_t HttpCache::Entry::age(std::time_t now) const {
+    return initialAge + std::max<int64_t>(static_cast<int64_t>(now) - storedAt, 0);
+}
+
+bool HttpCache::Entry::fresh(std::time_t now) const {
+    std::string_view cacheControl = headers.get(KnownHeader::CacheControl);
+    if (hasDirective(cacheControl, "no-cache")) {
+        return false;
+    }
+    int64_t lifetime = 0;
+    int64_t date = parseHttpDate(headers.get(KnownHeader::Date));
+    if (date < 0) {
+        date = static_cast<int64_t>(storedAt) - initialAge;
+    }
+    if (hasDirective(cacheControl, "max-age", &lifetime)) {
+        lifetime = std::max<int64_t>(lifetime, 0);
+    } else if (headers.contains("Expires")) {
+        // An invalid Expires (such as "0") means already expired.
+        int64_t expires = parseHttpDate(headers.get(KnownHeader::Expires));
+        lifetime = expires < 0 ? 0 : expires - date;
+    } else if (headers.contains("Last-Modified")) {
+        int64_t modified = parseHttpDate(headers.get(KnownHeader::LastModified));
+        lifetime = modified < 0 ? 0 : std::min((date - modified) / 10, maxHeuristicLifetime);
+    }
+    return age(now) < lifetime;
+}
+
+HttpCache::Writer::Writer(const HttpCache& cache, const HttpRequest& request)
+    : cache(cache), request(request), tmpPath(cache.pathOf(uniqueName("tmp", ".body"))) {
+    fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to create cache file: " + tmpPath);
+    }
+}
+
+HttpCache::Writer::~Writer() {
+    if (fd != -1) {
+        close(fd);
+        unlink(tmpPath.c_str());
+    }
+}
+
+void HttpCache::Writer::append(const char* data, size_t length) {
+    writeAll(fd, data, length, "cache file");
+    written += length;
+}
+
+void HttpCache::Writer::appendFile(const std::string& path) {
+    int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (in == -1 || fstat(in, &info) == -1) {
+        if (in != -1) {
+            close(in);
+        }
+        throw std::runtime_error("Failed to read " + path + " for the cache");
+    }
+    try {
+        copyRange(in, 0, fd, static_cast<uint64_t>(info.st_size));
+    } catch (...) {
+        close(in);
+        throw;
+    }
+    close(in);
+    written += static_cast<uint64_t>(info.st_size);
+}
+
+void HttpCache::Writer::commit(const HttpResponse& response) {
+    int64_t length = response.headers.contentLength();
+    if (fd == -1 || (length >= 0 && static_cast<uint64_t>(length) != written)) {
+        return;
+    }
+    int result = close(fd);
+    fd = -1;
+    std::string key = keyFor(request);
+    std::string bodyFile = uniqueName(hashName(key), ".body");
+    if (result == -1 || rename(tmpPath.c_str(), cache.pathOf(bodyFile).c_str()) == -1) {
+        unlink(tmpPath.c_str());
+        return;
+    }
+    std::time_t now = std::time(nullptr);
+    cache.saveMeta(key, bodyFile, response.statusLine, response.headers, written, now,
+                   initialAgeOf(response.headers, now), varyValues(request, response.headers));
+    cache.trim();
+}
+
+HttpCache::HttpCache(std::string directory, uint64_t maxSize)
+    : directory(std::move(directory)), maxSize(maxSize) {
+    struct stat info;
+    if (mkdir(this->directory.c_str(), 0700) == -1 &&
+        (errno != EEXIST || stat(this->directory.c_str(), &info) == -1 || !S_ISDIR(info.st_mode))) {
+        throw std::runtime_error("Failed to create cache directory: " + this->directory);
+    }
+}
+
+bool HttpCache::usable(const HttpRequest& request) {
+    return request.method == HttpMethod::GET && !request.compressed && requestHeader(request, "Range").empty() &&
+           requestHeader(request, "If-None-Match").empty() && requestHeader(request, "If-Modified-Since").empty() &&
+           !hasDirective(requestHeader(request, "Cache-Control"), "no-store");
+}
+
+bool HttpCache::storable(const HttpRequest& request, const HttpResponse& response) {
+    if (!usable(request) || response.statusCode != 200 || response.redirects > 0) {
+        return false;
+    }
+    if (hasDirective(response.headers.get(KnownHeader::CacheControl), "no-store")) {
+        return false;
+    }
+    bool varyAll = false;
+    forEachElement(response.headers.get(KnownHeader::Vary), [&](std::string_view name) {
+        varyAll = varyAll || name == "*";
+    });
+    return !varyAll;
+}
+
+bool HttpCache::requestsRevalidation(const HttpRequest& request) {
+    std::string cacheControl = requestHeader(request, "Cache-Control");
+    int64_t maxAge = -1;
+    return hasDirective(cacheControl, "no-cache") || (hasDirective(cacheControl, "max-age", &maxAge) && maxAge == 0);
+}
+
+std::string HttpCache::keyFor(const HttpRequest& request) {
+    return HttpMethodToString.at(request.method) + " " + request.url.toString();
+}
+
+std::string HttpCache::pathOf(const std::string& name) const {
+    return directory + "/" + name;
+}
+
+bool HttpCache::lookup(const HttpRequest& request, Entry& entry) const {
+    std::string key = keyFor(request);
+    std::string metaPath = pathOf(hashName(key) + ".meta");
+    std::string meta;
+    if (!readFile(metaPath, meta)) {
+        return false;
+    }
+    size_t split = meta.find("\n\n");
+    if (split == std::string::npos || metaValue(meta, "key") != key) {
+        return false;
+    }
+    std::string bookkeeping = meta.substr(0, split + 1);
+    entry.key = key;
+    entry.statusLine = metaValue(bookkeeping, "status");
+    entry.bodyFile = metaValue(bookkeeping, "body");
+    entry.bodySize = std::strtoull(metaValue(bookkeeping, "size").c_str(), nullptr, 10);
+    entry.storedAt = static_cast<std::time_t>(std::strtoll(metaValue(bookkeeping, "stored").c_str(), nullptr, 10));
+    entry.initialAge = std::strtoll(metaValue(bookkeeping, "age").c_str(), nullptr, 10);
+
+    // Every "vary: Name: value" line must match what this request sends.
+    entry.vary.clear();
+    std::istringstream lines(bookkeeping);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 6, "vary: ") != 0) {
+            continue;
+        }
+        size_t colon = line.find(": ", 6);
+        std::string field = line.substr(6, colon - 6);
+        std::string value = colon == std::string::npos ? std::string() : line.substr(colon + 2);
+        if (requestHeader(request, field) != value) {
+            return false;
+        }
+        entry.vary.emplace_back(field, value);
+    }
+
+    entry.headers.clear();
+    std::string_view fields(meta);
+    fields.remove_prefix(split + 2);
+    while (!fields.empty()) {
+        size_t end = fields.find("\r\n");
+        entry.headers.addLine(fields.substr(0, end));
+        fields.remove_prefix(end == std::string_view::npos ? fields.size() : end + 2);
+    }
+
+    if (entry.bodyFd != -1) {
+        close(entry.bodyFd);
+    }
+    entry.bodyFd = entry.bodyFile.empty() ? -1 : open(pathOf(entry.bodyFile).c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (entry.bodyFd == -1 || fstat(entry.bodyFd, &info) != 0 || static_cast<uint64_t>(info.st_size) != entry.bodySize) {
+        return false;
+    }
+    utimensat(AT_FDCWD, metaPath.c_str(), nullptr, 0); // Marks the entry as recently used for trim().
+    return true;
+}
+
+void HttpCache::addValidators(const Entry& entry, HttpRequest& request) {
+    std::string_view etag = entry.headers.get(KnownHeader::ETag);
+    if (!etag.empty()) {
+        request.headers["If-None-Match"] = std::string(etag);
+    }
+    std::string_view modified = entry.headers.get(KnownHeader::LastModified);
+    if (!modified.empty()) {
+        request.headers["If-Modified-Since"] = std::string(modified);
+    }
+}
+
+void HttpCache::refresh(Entry& entry, const HttpResponse& notModified) const {
+    HttpHeaders merged;
+    for (auto field : entry.headers) {
+        if (keepsStoredField(field.name) || !notModified.headers.contains(field.name)) {
+            merged.add(field.name, field.value);
+        }
+    }
+    for (auto field : notModified.headers) {
+        if (!keepsStoredField(field.name)) {
+            merged.add(field.name, field.value);
+        }
+    }
+    entry.headers = std::move(merged);
+    entry.storedAt = std::time(nullptr);
+    entry.initialAge = initialAgeOf(notModified.headers, entry.storedAt);
+    saveMeta(entry.key, entry.bodyFile, entry.statusLine, entry.headers, entry.bodySize, entry.storedAt,
+             entry.initialAge, entry.vary);
+}
+
+void HttpCache::describe(const Entry& entry, HttpResponse& response) {
+    response.statusLine = entry.statusLine;
+    size_t space = entry.statusLine.find(' ');
+    response.statusCode = space == std::string::npos ? 0 : std::atoi(entry.statusLine.c_str() + space + 1);
+    response.headers = entry.headers;
+    response.bodyBytes = entry.bodySize;
+    response.fromCache = true;
+}
+
+void HttpCache::readBody(const Entry& entry, const BodySink& sink) const {
+    if (entry.bodySize == 0) {
+        return;
+    }
+    void* data = mmap(nullptr, entry.bodySize, PROT_READ, MAP_PRIVATE, entry.bodyFd, 0);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map cached body: " + std::string(strerror(errno)));
+    }
+    madvise(data, entry.bodySize, MADV_SEQUENTIAL);
+    try {
+        sink(static_cast<const char*>(data), entry.bodySize);
+    } catch (...) {
+        munmap(data, entry.bodySize);
+        throw;
+    }
+    munmap(data, entry.bodySize);
+}
+
+void HttpCache::copyBody(const Entry& entry, int fd) const {
+    copyRange(entry.bodyFd, 0, fd, entry.bodySize);
+}
+
+void HttpCache::saveMeta(const std::string& key, const std::string& bodyFile, const std::string& statusLine,
+                         const HttpHeaders& headers, uint64_t bodySize, std::time_t storedAt, int64_t initialAge,
+                         const std::vector<std::pair<std::string, std::string>>& vary) const {
+    std::string path = pathOf(hashName(key) + ".meta");
+
+    std::string previous;
+    std::string previousBody;
+    if (readFile(path, previous)) {
+        previousBody = metaValue(previous.substr(0, previous.find("\n\n") + 1), "body");
+    }
+
+    // Write to a temporary file first so readers never see a torn entry.
+    std::string tmp = pathOf(uniqueName("tmp", ".meta"));
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << "key: " << key << "\n";
+        out << "status: " << statusLine << "\n";
+        out << "body: " << bodyFile << "\n";
+        out << "size: " << bodySize << "\n";
+        out << "stored: " << static_cast<int64_t>(storedAt) << "\n";
+        out << "age: " << initialAge << "\n";
+        for (const auto& field : vary) {
+            out << "vary: " << field.first << ": " << field.second << "\n";
+        }
+        out << "\n" << headers.raw();
+        if (!out) {
+            std::remove(tmp.c_str());
+            return; // Caching is best effort; the request itself should not fail because of it.
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return;
+    }
+    if (!previousBody.empty() && previousBody != bodyFile) {
+        std::remove(pathOf(previousBody).c_str());
+    }
+}
+
+void HttpCache::trim() const {
+    struct File {
+        uint64_t size;
+        timespec modified;
+    };
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    uint64_t total = 0;
+    std::vector<std::pair<std::string, File>> metas;
+    std::unordered_map<std::string, File> others;
+    while (dirent* item = readdir(dir)) {
+        struct stat info;
+        if (item->d_name[0] == '.' || fstatat(dirfd(dir), item->d_name, &info, 0) == -1 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        std::string name = item->d_name;
+        File file{static_cast<uint64_t>(info.st_size), info.st_mtim};
+        total += file.size;
+        bool meta = name.size() > 5 && name.compare(name.size() - 5, 5, ".meta") == 0 && name.compare(0, 4, "tmp.") != 0;
+        if (meta) {
+            metas.emplace_back(std::move(name), file);
+        } else {
+            others.emplace(std::move(name), file);
+        }
+    }
+    closedir(dir);
+    if (total <= maxSize) {
+        return;
+    }
+
+    // Pair each meta file with the body it names; what is left names no entry.
+    struct Stored {
+        std::string meta;
+        std::string body;
+        uint64_t size;
+        timespec used;
+    };
+    std::vector<Stored> entries;
+    for (auto& meta : metas) {
+        std::string contents;
+        if (!readFile(pathOf(meta.first), contents)) {
+            continue;
+        }
+        Stored stored{meta.first, metaValue(contents.substr(0, contents.find("\n\n") + 1), "body"),
+                      meta.second.size, meta.second.modified};
+        auto body = others.find(stored.body);
+        if (body != others.end()) {
+            stored.size += body->second.size;
+            others.erase(body);
+        }
+        entries.push_back(std::move(stored));
+    }
+    std::time_t now = std::time(nullptr);
+    for (const auto& file : others) {
+        if (now - file.second.modified.tv_sec > abandonedFileAge && std::remove(pathOf(file.first).c_str()) == 0) {
+            total -= file.second.size;
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Stored& a, const Stored& b) {
+        return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+    });
+    for (const Stored& stored : entries) {
+        if (total <= maxSize) {
+            break;
+        }
+        // Readers that already opened the body keep it; the meta file goes first so no lookup finds
+        // an entry without its body.
+        std::remove(pathOf(stored.meta).c_str());
+        if (!stored.body.empty()) {
+            std::remove(pathOf(stored.body).c_str());
+        }
+        total -= stored.size;
+    }
+}
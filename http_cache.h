@@ -0,0 +1,143 @@
+#pragma once
+#include "http_client.h"
+#include "http_headers.h"
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// @brief On-disk HTTP response cache keyed by method and URL, for a single user (a private cache).
+/// Each entry is a "<key hash>.meta" file with the status, the response headers and bookkeeping
+/// lines, and a body file named by the meta file. Entries are replaced by writing new files and
+/// renaming them into place, so concurrent runs never see a torn entry. Only complete 200 responses
+/// to GET requests are stored; freshness follows Cache-Control max-age, Expires or a Last-Modified
+/// heuristic, and stale entries are revalidated with If-None-Match / If-Modified-Since. When the
+/// directory grows past its size limit, the least recently used entries are removed.
+class HttpCache {
+public:
+    /// @brief A stored response. Holds its body file open, so the body stays readable even if another
+    /// process replaces the entry meanwhile.
+    class Entry {
+    public:
+        Entry() = default;
+        ~Entry();
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        std::string statusLine;       ///< Status line of the stored response.
+        HttpHeaders headers;          ///< Headers of the stored response.
+        uint64_t bodySize = 0;        ///< Length of the body file.
+
+        /// @brief Returns true if the entry may be used without asking the server.
+        bool fresh(std::time_t now) const;
+
+        /// @brief Returns how old the response is, in seconds.
+        int64_t age(std::time_t now) const;
+
+    private:
+        friend class HttpCache;
+        std::string key;
+        std::string bodyFile;         ///< Name of the body file in the cache directory.
+        int bodyFd = -1;
+        std::time_t storedAt = 0;     ///< When the response (or its last revalidation) arrived.
+        int64_t initialAge = 0;       ///< Age of the response when it arrived.
+        std::vector<std::pair<std::string, std::string>> vary; ///< Request header values the response varies on.
+    };
+
+    /// @brief Incrementally writes the body of a response into a new entry.
+    class Writer {
+    public:
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /// @brief Appends body bytes.
+        /// @throws std::runtime_error if the write fails.
+        void append(const char* data, size_t length);
+
+        /// @brief Appends the contents of a file (the response body), with copy_file_range(2) where possible.
+        /// @throws std::runtime_error if the copy fails.
+        void appendFile(const std::string& path);
+
+        /// @brief Publishes the entry with the given response's status and headers.
+        /// Does nothing if the body written does not match the response's Content-Length.
+        void commit(const HttpResponse& response);
+
+    private:
+        friend class HttpCache;
+        Writer(const HttpCache& cache, const HttpRequest& request);
+
+        const HttpCache& cache;
+        const HttpRequest& request;   ///< The request being stored; must outlive the writer.
+        std::string tmpPath;          ///< Body file being written, renamed into place on commit.
+        int fd = -1;
+        uint64_t written = 0;
+    };
+
+    /// @brief Opens (and if needed creates) a cache directory.
+    /// @param maxSize Bytes the directory may hold; storing an entry evicts others beyond that.
+    /// @throws std::runtime_error if the directory cannot be created.
+    HttpCache(std::string directory, uint64_t maxSize);
+
+    /// @brief Returns false if the request must bypass the cache (not a GET, a Range request,
+    /// decoded content or a request Cache-Control of no-store).
+    static bool usable(const HttpRequest& request);
+
+    /// @brief Returns true if a response to the request may be stored.
+    static bool storable(const HttpRequest& request, const HttpResponse& response);
+
+    /// @brief Finds the entry stored for a request, if it matches the request's varying headers.
+    /// @return True if `entry` was filled in.
+    bool lookup(const HttpRequest& request, Entry& entry) const;
+
+    /// @brief Returns true if the request itself asks for revalidation (Cache-Control: no-cache or max-age=0).
+    static bool requestsRevalidation(const HttpRequest& request);
+
+    /// @brief Makes a request conditional on the entry: If-None-Match with its ETag and/or
+    /// If-Modified-Since with its Last-Modified date.
+    static void addValidators(const Entry& entry, HttpRequest& request);
+
+    /// @brief Applies a 304 response to the entry: its headers replace the stored ones and the entry
+    /// becomes fresh again. The updated entry is saved.
+    void refresh(Entry& entry, const HttpResponse& notModified) const;
+
+    /// @brief Starts storing a new entry for a request, which must outlive the writer.
+    /// @throws std::runtime_error if the body file cannot be created.
+    std::unique_ptr<Writer> store(const HttpRequest& request) const {
+        return std::unique_ptr<Writer>(new Writer(*this, request));
+    }
+
+    /// @brief Fills in a response from an entry: status, headers and body size. The body is not read.
+    static void describe(const Entry& entry, HttpResponse& response);
+
+    /// @brief Passes the entry's body to a sink straight from a memory mapping of the body file.
+    void readBody(const Entry& entry, const BodySink& sink) const;
+
+    /// @brief Copies the entry's body to a file descriptor at its current offset, with
+    /// copy_file_range(2) where possible (which can share blocks on file systems that support it).
+    /// @throws std::runtime_error if the copy fails.
+    void copyBody(const Entry& entry, int fd) const;
+
+private:
+    std::string directory;
+    uint64_t maxSize;
+
+    /// @brief Removes the least recently used entries (by the modification time of their meta files,
+    /// which lookups touch) until the directory fits in maxSize again. Files no entry names, left over
+    /// from interrupted runs, are removed once nobody has written to them for an hour.
+    void trim() const;
+
+    /// @brief Returns the cache key of a request.
+    static std::string keyFor(const HttpRequest& request);
+
+    /// @brief Returns the path of a file in the cache directory.
+    std::string pathOf(const std::string& name) const;
+
+    /// @brief Writes the meta file of an entry, replacing the old one, and removes the body file it
+    /// named if that was a different one.
+    void saveMeta(const std::string& key, const std::string& bodyFile, const std::string& statusLine,
+                  const HttpHeaders& headers, uint64_t bodySize, std::time_t storedAt, int64_t initialAge,
+                  const std::vector<std::pair<std::string, std::string>>& vary) const;
+};
@@ -1,6 +1,19 @@
 //http_client.cpp
 
 #include "http_client.h"
+#include "content_decoder.h"
+#include "response_parser.h"
+#include "async_transfer.h"
+#include "event_loop.h"
+#include "splice_transfer.h"
+#include "uring_transfer.h"
+#include "resume_state.h"
+#include "happy_eyeballs.h"
+#include "request_serializer.h"
+#include "http2_multiplexer.h"
+#include "http2_session.h"
+#include "http_cache.h"
+#include "io_util.h"
 #include <stdexcept>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -12,15 +25,31 @@
 #include <fstream>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
-#include <regex>
 #include <string>
 #include <openssl/x509_vfy.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <strings.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <initializer_list>
 
 HttpClient::HttpClient() : ctx(nullptr) {
+    // Writing to a pooled connection the server has already closed must surface as an error, not kill the process.
+    std::signal(SIGPIPE, SIG_IGN);
     initSSL();   
 }
 
 HttpClient::~HttpClient() {
+    pool.clear();
+    sessionCache.reset();
     cleanSSL();   
 }
 
@@ -36,10 +65,33 @@ void HttpClient::initSSL() {
     SSL_CTX_set_verify(ctx,SSL_VERIFY_PEER,nullptr);
     SSL_CTX_set_verify_depth(ctx,4);
     SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1 | SSL_OP_NO_TLSv1_1);
+    // Many servers close close-delimited responses without a close_notify; treat that as EOF.
+    // Framed (Content-Length/chunked) bodies still detect truncation on their own.
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+    // HTTP/2 frames are queued while a non-blocking write waits, so the buffer may move between retries.
+    SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+    // Hand record encryption to the kernel when it has the TLS module and the cipher allows it;
+    // OpenSSL quietly keeps doing it in user space otherwise.
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    setHttp2(true);
 
     if (!SSL_CTX_set_default_verify_paths(ctx)) {
         throw std::runtime_error("Failed to set default verify paths");
     }
+    sessionCache = std::make_unique<TlsSessionCache>(ctx);
+}
+
+void HttpClient::setHttp2(bool enable) {
+    // ALPN protocol list in wire format: length-prefixed names in order of preference.
+    static const unsigned char withHttp2[] = "\x02h2\x08http/1.1";
+    static const unsigned char http1Only[] = "\x08http/1.1";
+    if (enable) {
+        SSL_CTX_set_alpn_protos(ctx, withHttp2, sizeof(withHttp2) - 1);
+    } else {
+        SSL_CTX_set_alpn_protos(ctx, http1Only, sizeof(http1Only) - 1);
+    }
 }
 
 void HttpClient::cleanSSL() {
@@ -50,7 +102,7 @@ void HttpClient::cleanSSL() {
 }
 
 
-SSL* HttpClient::createSSLConnection(int socket, const std::string &hostname) {
+SSL* HttpClient::createSSLConnection(int socket, const std::string &hostname, const std::string& origin) {
     SSL* ssl = SSL_new(ctx);
     if(!ssl) {
         throw std::runtime_error("Failed to create SSL structure");
@@ -58,13 +110,16 @@ SSL* HttpClient::createSSLConnection(int socket, const std::string &hostname) {
 
     SSL_set_fd(ssl,socket);
     SSL_set_tlsext_host_name(ssl, hostname.c_str());
+    // The expected hostname must be set before the handshake for OpenSSL to check it.
+    SSL_set1_host(ssl, hostname.c_str());
+    TlsSessionCache::prepare(ssl, origin);
 
     if (SSL_connect(ssl) != 1) {
         SSL_free(ssl);
         throw std::runtime_error("Failed to establish SSL connection");
     }
 
-    if (!verifySSLCert(ssl,hostname)){
+    if (!verifySSLCert(ssl)){
         SSL_free(ssl);
         throw std::runtime_error("SSL Certificate Verification Failed");
     }
@@ -72,24 +127,15 @@ SSL* HttpClient::createSSLConnection(int socket, const std::string &hostname) {
     return ssl;
 }
 
-bool HttpClient::verifySSLCert(SSL* ssl, const std::string& hostname) {
+bool HttpClient::verifySSLCert(SSL* ssl) {
     // Retrieve the SSL context and X509 store
     X509* cert = SSL_get_peer_certificate(ssl);
     if (!cert) {
         return false;
     }
 
-    // Get the verification parameters
-    X509_VERIFY_PARAM* param = SSL_get0_param(ssl);
-    
-    // Set the hostname for verification
-    //This automatically invokes the X509_CHECK_HOST in the previous version
-    if (!X509_VERIFY_PARAM_set1_host(param, hostname.c_str(), hostname.length())) {
-        X509_free(cert);
-        return false;
-    }
-
-    // Perform verification
+    // The hostname was set with SSL_set1_host() before the handshake, so the verify
+    // result covers the hostname check as well as the chain.
     int result = SSL_get_verify_result(ssl);
 
     // Clean up certificate
@@ -120,304 +166,1206 @@ void HttpClient::handleSSLError(SSL *ssl, int result) {
 }
 
 
-int HttpClient::createSocket(const std::string& hostname, uint16_t port) {
-    struct hostent *host = gethostbyname(hostname.c_str());
+int HttpClient::createSocket(const std::string& hostname, uint16_t port, TransferTiming& timing) {
+    std::vector<ResolvedAddress> addresses = resolver.resolve(hostname, port);
+    timing.nameLookup = timing.elapsed();
+    int sock = connectHappyEyeballs(addresses, connectionAttemptDelay, connectTimeout);
+    timing.connect = timing.elapsed();
+    return sock;
+}
+
+
+
+/// @brief Generates an HTTP request string based on the parsed URL and method.
+/// @param parsedUrl The parsed URL struct containing the host and path.
+/// @param method The HTTP method to use (GET, POST, etc.).
+/// @return The generated HTTP request string.
+std::string HttpClient::generateRequest(const HttpRequest& request) {
+    return SerializedRequest(request).flatten();
+}
+
+namespace {
+
+/// @brief Returns true if the kernel encrypts the records sent on this connection (kTLS).
+bool kernelTlsSend(SSL* ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+    (void)ssl;
+    return false;
+#endif
+}
+
+/// @brief Returns true if the kernel decrypts the records received on this connection (kTLS), so
+/// the plaintext can be read straight from the socket.
+bool kernelTlsReceive(SSL* ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#else
+    (void)ssl;
+    return false;
+#endif
+}
+
+/// @brief What the response cache holds for a request.
+enum class CacheState {
+    Miss,   ///< Nothing usable; the request goes out as is.
+    Fresh,  ///< An entry that may be served without asking the server.
+    Stale   ///< An entry to revalidate with a conditional request.
+};
+
+/// @brief Looks a request up in the cache, reporting the outcome in verbose mode.
+CacheState lookupCache(const HttpCache& cache, const HttpRequest& request, bool verbose, HttpCache::Entry& entry) {
+    if (!HttpCache::usable(request)) {
+        return CacheState::Miss;
+    }
+    if (!cache.lookup(request, entry)) {
+        if (verbose) std::cout << "* Cache miss" << std::endl;
+        return CacheState::Miss;
+    }
+    std::time_t now = std::time(nullptr);
+    if (entry.fresh(now) && !HttpCache::requestsRevalidation(request)) {
+        if (verbose) std::cout << "* Cache hit: fresh (age " << entry.age(now) << "s)" << std::endl;
+        return CacheState::Fresh;
+    }
+    if (verbose) std::cout << "* Cache entry is stale (age " << entry.age(now) << "s), revalidating" << std::endl;
+    return CacheState::Stale;
+}
+
+/// @brief Copies a response body into the cache as it is received. Caching is best effort: any
+/// failure just drops the new entry, never the request.
+class CacheFill {
+public:
+    CacheFill(const HttpCache& cache, const HttpRequest& request, const HttpResponse& response)
+        : cache(cache), request(request), response(response) {}
+
+    void append(const char* data, size_t length) {
+        if (begin()) {
+            try {
+                writer->append(data, length);
+            } catch (const std::exception&) {
+                writer.reset();
+            }
+        }
+    }
+
+    void appendFile(const std::string& path) {
+        if (begin()) {
+            try {
+                writer->appendFile(path);
+            } catch (const std::exception&) {
+                writer.reset();
+            }
+        }
+    }
 
-    if (!host) {
-        throw std::runtime_error("Failed to resolve the hostname");
+    /// @brief Publishes the entry once the whole body went through. Whether the response may be stored
+    /// is checked again here: with redirects followed, the final hop's body arrives before
+    /// performFollowing() counts the hops, and it must not be stored under the original URL.
+    void commit() {
+        if (begin() && HttpCache::storable(request, response)) {
+            writer->commit(response);
+        }
+        writer.reset();
     }
 
-    int sock = socket(AF_INET,SOCK_STREAM,0);
-    if (sock == -1) {
-        throw std::runtime_error(
-            "Failed to create socket! "
-        );
+private:
+    const HttpCache& cache;
+    const HttpRequest& request;
+    const HttpResponse& response;
+    bool started = false;
+    std::unique_ptr<HttpCache::Writer> writer;
+
+    /// @brief Decides on the first call, once the response headers are known, whether to start storing it.
+    bool begin() {
+        if (!started) {
+            started = true;
+            if (HttpCache::storable(request, response)) {
+                try {
+                    writer = cache.store(request);
+                } catch (const std::exception&) {
+                }
+            }
+        }
+        return writer != nullptr;
     }
+};
+
+/// @brief Returns true if `fd` refers to a regular file.
+bool isRegularFile(int fd) {
+    struct stat info;
+    return fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+}
 
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr = *((struct in_addr *)host->h_addr);
+/// @brief Returns true for the status codes that redirect to the Location header.
+bool isRedirect(int statusCode) {
+    return statusCode == 301 || statusCode == 302 || statusCode == 303 || statusCode == 307 || statusCode == 308;
+}
 
+/// @brief Returns true for methods whose requests may be repeated without changing the outcome (RFC 9110
+/// section 9.2.2), so they may be pipelined and replayed.
+bool isIdempotent(HttpMethod method) {
+    return method != HttpMethod::POST;
+}
 
-    if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        close(sock);
-        throw std::runtime_error(
-            "Connection failed"
-        );
+/// @brief Case-insensitively removes header fields from a request, including its shared header block.
+void removeHeaders(HttpRequest& request, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        for (auto it = request.headers.begin(); it != request.headers.end();) {
+            it = strcasecmp(it->first.c_str(), name) == 0 ? request.headers.erase(it) : std::next(it);
+        }
+    }
+    if (!request.sharedHeaders) {
+        return;
+    }
+    std::map<std::string, std::string> shared = request.sharedHeaders->fields();
+    size_t before = shared.size();
+    for (const char* name : names) {
+        for (auto it = shared.begin(); it != shared.end();) {
+            it = strcasecmp(it->first.c_str(), name) == 0 ? shared.erase(it) : std::next(it);
+        }
+    }
+    if (shared.size() != before) {
+        request.sharedHeaders = std::make_shared<const HeaderBlock>(shared);
     }
-    return sock;
 }
 
+/// @brief Rebuilds a URL string from its parsed parts, used to match resume state to a download.
+std::string urlString(const ParsedUrl& url) {
+    return ConnectionPool::originKey(url) + url.target();
+}
 
+} // namespace
 
-/// @brief Generates an HTTP request string based on the parsed URL and method.
-/// @param parsedUrl The parsed URL struct containing the host and path.
-/// @param method The HTTP method to use (GET, POST, etc.).
-/// @return The generated HTTP request string.
-std::string HttpClient::generateRequest(const HttpRequest& request) {
-    std::string methodStr = HttpMethodToString.at(request.method);
-    std::string req = methodStr + " " + request.url.path + " HTTP/1.1\r\n";
-    req += "Host: " + request.url.host + "\r\n";
-    for (const auto& header : request.headers) {
-        req += header.first + ": " + header.second + "\r\n";
-    }
-    if (!request.data.empty()) {
-        req += "Content-Length: " + std::to_string(request.data.length()) + "\r\n";
-    }
-
-    req += "\r\n";
-    
-    if (!request.data.empty()) {
-        req += request.data;
-    }
-    
-    return req;
-}   
-
-
-
-// HttpResponse HttpClient::sendRequest(const HttpRequest& request, bool verbose, bool followRedirects) {
-//     int maxRedirects = 5;
-//     HttpRequest currentRequest = request;
-//     HttpResponse response;
-
-//     while (maxRedirects > 0) {
-//         response = sendSingleRequest(currentRequest, verbose);
-        
-//         // Parse status code
-//         std::string statusCode;
-//         std::regex pattern(R"(HTTP/\d+\.\d+\s+(\d{3}))");
-//         std::smatch match;
-//         if (std::regex_search(response.statusLine, match, pattern)) {
-//             statusCode = match[1];
-//         }
-
-//         if (followRedirects && (statusCode == "301" || statusCode == "302" || statusCode == "303" || statusCode == "307" || statusCode == "308")) {
-//             std::string location;
-//             for (const auto& header : response.headers) {
-//                 if (header.find("Location: ") == 0) {
-//                     location = header.substr(10);
-//                     break;
-//                 }
-//             }
-//             if (!location.empty()) {
-//                 currentRequest.url = UrlParser::parse(location);
-                
-//                 // Preserve the original method for 307 and 308 redirects
-//                 if (statusCode == "301" || statusCode == "302" || statusCode == "303") {
-//                     currentRequest.method = HttpMethod::GET;
-//                 }
-                
-//                 // Clear the request body for GET requests
-//                 if (currentRequest.method == HttpMethod::GET) {
-//                     currentRequest.data.clear();
-//                 }
-
-//                 if (verbose) {
-//                     std::cout << "Following redirect to: " << location << std::endl;
-//                 }
-//                 maxRedirects--;
-//             } else {
-//                 break; // No Location header found, stop redirecting
-//             }
-//         } else {
-//             break; // Not a redirect code
-//         }
-//     }
-//     return response;
-// }   
-HttpResponse HttpClient::sendRequest(const HttpRequest& request, bool verbose) {
-    std::string requestStr = generateRequest(request);
-    int sock = createSocket(request.url.host,request.url.port);
-    SSL* ssl = nullptr;
-    if(request.url.protocol == "https") {
-        ssl = this->createSSLConnection(sock,request.url.host);
+/// @brief Smallest byte range worth giving its own connection in a segmented download.
+const uint64_t minSegmentSize = 1 << 20;
+
+std::unique_ptr<Connection> HttpClient::openConnection(const ParsedUrl& url, TransferTiming& timing) {
+    std::string origin = ConnectionPool::originKey(url);
+    std::unique_ptr<Connection> conn = pool.acquire(origin);
+    timing.connectionReused = conn != nullptr;
+    if (conn) {
+        timing.nameLookup = timing.connect = timing.elapsed();
+        timing.tlsHandshake = conn->ssl ? timing.connect : std::chrono::microseconds(0);
+        return conn;
     }
-    if (verbose) {
-        std::cout <<"> " << requestStr.substr(0, requestStr.find("\r\n")) << std::endl;
-        std::istringstream iss(requestStr);
-        std::string line;
-        std::getline(iss,line); //skip the first line
-        while(std::getline(iss,line) && !line.empty()) {
-            std::cout << "> " << line << std::endl;
+    conn = std::make_unique<Connection>();
+    conn->origin = origin;
+    conn->sock = createSocket(url.host, url.port, timing);
+    if (url.protocol == "https") {
+        conn->ssl = this->createSSLConnection(conn->sock, url.host, origin);
+        timing.tlsHandshake = timing.elapsed();
+        const unsigned char* protocol = nullptr;
+        unsigned int length = 0;
+        SSL_get0_alpn_selected(conn->ssl, &protocol, &length);
+        if (length == 2 && memcmp(protocol, "h2", 2) == 0) {
+            conn->http2 = std::make_unique<Http2Session>();
         }
-        std::cout << "> " << std::endl;
     }
+    return conn;
+}
 
-    if(ssl) {
-        if(SSL_write(ssl,requestStr.c_str(),requestStr.length()) <= 0) {
-            this->handleSSLError(ssl,0);
+void HttpClient::sendAll(Connection& conn, const SerializedRequest& request) {
+    if (conn.ssl) {
+        std::string storage;
+        for (std::string_view segment : request.tlsSegments(storage)) {
+            while (true) {
+                int n = SSL_write(conn.ssl, segment.data(), static_cast<int>(segment.size()));
+                if (n > 0) {
+                    break; // SSL_write writes everything unless partial writes are enabled
+                }
+                handleSSLError(conn.ssl, n);
+            }
         }
+        return;
     }
-    else {
-        if (send(sock, requestStr.c_str(),requestStr.length(),0) < 0) {
-        close(sock);
-        throw std::runtime_error(
-            "Failed to send Request!"
-        );
-    
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = request.send(conn.sock, sent);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to send Request!");
         }
+        sent += n;
     }
+}
 
+void HttpClient::sendRaw(Connection& conn, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        if (conn.ssl) {
+            int n = SSL_write(conn.ssl, data.data() + sent, static_cast<int>(std::min<size_t>(data.size() - sent, INT_MAX)));
+            if (n <= 0) {
+                handleSSLError(conn.ssl, n);
+                continue;
+            }
+            sent += n;
+            continue;
+        }
+        ssize_t n = send(conn.sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to send Request!");
+        }
+        sent += n;
+    }
+}
 
-    
-    HttpResponse response;
-    char buffer[4096];
-    int bytes_recieved; 
-    std::string raw_response;
-
-
-    while (true)
-    {
-        if(ssl) {
-            bytes_recieved  = SSL_read(ssl,buffer,sizeof(buffer));
-            if(bytes_recieved <= 0) {
-                int err = SSL_get_error(ssl,bytes_recieved);
-                if(err == SSL_ERROR_ZERO_RETURN) {
+void HttpClient::flushHttp2(Connection& conn) {
+    while (true) {
+        std::string_view pending = conn.http2->output();
+        if (pending.empty()) {
+            return;
+        }
+        int n = SSL_write(conn.ssl, pending.data(), static_cast<int>(std::min<size_t>(pending.size(), INT_MAX)));
+        if (n <= 0) {
+            handleSSLError(conn.ssl, n);
+            continue;
+        }
+        conn.http2->consume(n);
+    }
+}
+
+int HttpClient::readSome(Connection& conn, char* buffer, size_t size) {
+    if (conn.ssl) {
+        while (true) {
+            int n = SSL_read(conn.ssl, buffer, size);
+            if (n > 0) {
+                return n;
+            }
+            if (SSL_get_error(conn.ssl, n) == SSL_ERROR_ZERO_RETURN) {
+                return 0; // Connection closed by the peer
+            }
+            handleSSLError(conn.ssl, n);
+        }
+    }
+    while (true) {
+        int n = recv(conn.sock, buffer, size, 0);
+        if (n >= 0) {
+            return n;
+        }
+        if (errno != EINTR) {
+            // A reset is not an end of stream: a close-delimited body would end silently short.
+            throw std::runtime_error("Failed to receive response: " + std::string(strerror(errno)));
+        }
+    }
+}
+
+void HttpClient::performRequest(const HttpRequest& request, bool verbose, HttpResponse& response, const BodySink& onBody,
+                                const std::function<bool(Connection&, HttpResponseParser&)>& onHeaders) {
+    SerializedRequest serialized(request);
+
+    char buffer[16384];
+    std::unique_ptr<Connection> conn;
+    bool reusable = true;
+    TransferTiming timing;
+    timing.start = std::chrono::steady_clock::now();
+    uint64_t bodyBytes = 0;
+    std::unique_ptr<ContentDecoder> decoder; ///< Undoes the response's Content-Encoding, if requested.
+    auto countBody = [&onBody, &bodyBytes, &decoder](const char* data, size_t length) {
+        bodyBytes += length;
+        if (decoder) {
+            decoder->decode(data, length);
+        } else {
+            onBody(data, length);
+        }
+    };
+
+    // A pooled connection may have been closed by the server while it sat idle. If it fails before
+    // any part of the response arrives, retry once on a fresh connection.
+    for (int attempt = 0; ; ++attempt) {
+        conn = openConnection(request.url, timing);
+        bool canRetry = attempt == 0 && conn->requestsServed > 0;
+        if (verbose && conn->requestsServed > 0) {
+            std::cout << "* Reusing connection to " << conn->origin << std::endl;
+        }
+        if (verbose && conn->ssl && conn->requestsServed == 0) {
+            std::cout << "* TLS handshake: " << (SSL_session_reused(conn->ssl) ? "resumed session" : "full")
+                      << " (" << SSL_get_version(conn->ssl) << ")" << std::endl;
+            std::cout << "* ALPN: " << (conn->http2 ? "h2" : "http/1.1") << std::endl;
+            if (kernelTlsSend(conn->ssl) || kernelTlsReceive(conn->ssl)) {
+                std::cout << "* Kernel TLS:" << (kernelTlsSend(conn->ssl) ? " send" : "")
+                          << (kernelTlsReceive(conn->ssl) ? " receive" : "") << std::endl;
+            }
+        }
+        if (verbose && attempt == 0) {
+            std::string requestStr = serialized.flatten();
+            std::string requestLine = requestStr.substr(0, requestStr.find("\r\n"));
+            if (conn->http2) {
+                requestLine.replace(requestLine.rfind(' ') + 1, std::string::npos, "HTTP/2");
+            }
+            std::cout << "> " << requestLine << std::endl;
+            std::istringstream iss(requestStr);
+            std::string line;
+            std::getline(iss,line); //skip the first line
+            while(std::getline(iss,line) && line != "\r") {
+                std::cout << "> " << line << std::endl;
+            }
+            std::cout << "> " << std::endl;
+        }
+        bool received = false;
+        bool headersSeen = false;
+        response = HttpResponse();
+        bodyBytes = 0;
+        decoder.reset();
+        HttpResponseParser parser(response, countBody);
+        parser.setNoBody(request.method == HttpMethod::HEAD);
+        auto onResponseHeaders = [&]() {
+            if (verbose) {
+                std::cout << "< " << response.statusLine << std::endl;
+                for (const auto& header : response.headers) {
+                    std::cout << "< " << header.name << ": " << header.value << std::endl;
+                }
+                std::cout << "<" << std::endl;
+            }
+            if (request.compressed) {
+                decoder = ContentDecoder::create(std::string(response.headers.get(KnownHeader::ContentEncoding)), onBody);
+            }
+        };
+        parser.setHeadersCallback(onResponseHeaders);
+        try {
+            if (conn->http2) {
+                bool closed = false;
+                std::string error;
+                Http2Session::StreamHandler handler;
+                handler.onHeaders = [&]() {
+                    received = true;
+                    timing.firstByte = timing.elapsed();
+                    onResponseHeaders();
+                };
+                handler.onData = countBody;
+                handler.onClose = [&](const std::string& streamError) {
+                    closed = true;
+                    error = streamError;
+                };
+                conn->http2->submit(request, response, std::move(handler));
+                flushHttp2(*conn);
+                timing.requestSent = timing.elapsed();
+                while (!closed) {
+                    int n = readSome(*conn, buffer, sizeof(buffer));
+                    if (n == 0) {
+                        conn->http2->fail("Connection closed before the response was complete");
+                        break;
+                    }
+                    try {
+                        conn->http2->feed(buffer, n);
+                    } catch (const std::exception& e) {
+                        conn->http2->fail(e.what());
+                    }
+                    flushHttp2(*conn);
+                }
+                if (!error.empty()) {
+                    throw std::runtime_error(error);
+                }
+                reusable = conn->http2->acceptsStreams();
+                break;
+            }
+            sendAll(*conn, serialized);
+            timing.requestSent = timing.elapsed();
+            while (!parser.done()) {
+                int n = readSome(*conn, buffer, sizeof(buffer));
+                if (n == 0) {
+                    parser.finish();
                     break;
                 }
-                else {
-                    this->handleSSLError(ssl,bytes_recieved);
+                if (!received) {
+                    timing.firstByte = timing.elapsed();
+                }
+                received = true;
+                if (parser.feed(buffer, n) < static_cast<size_t>(n)) {
+                    reusable = false; // The server sent more than one response's worth of data
+                }
+                if (!headersSeen && parser.headersComplete()) {
+                    headersSeen = true;
+                    if (onHeaders && !parser.done() && onHeaders(*conn, parser)) {
+                        break;
+                    }
                 }
             }
-        }
-        else {
-            bytes_recieved = recv(sock, buffer, sizeof(buffer), 0);
-            if (bytes_recieved <= 0) {
-                break;
+        } catch (const std::exception&) {
+            if (!canRetry || received) {
+                throw;
             }
+            continue;
         }
-        raw_response.append(buffer, bytes_recieved);
+        reusable = reusable && parser.keepAlive();
+        break;
     }
-    
-    
-    if (ssl) {
-        SSL_shutdown(ssl);
-        SSL_free(ssl);
+    if (decoder) {
+        decoder->finish();
+    }
+    timing.total = timing.elapsed();
+    // Bytes moved by an onHeaders hook (e.g. splice) were already added to response.bodyBytes.
+    response.bodyBytes += bodyBytes;
+    response.timing = timing;
+    if (verbose) {
+        for (const auto& trailer : response.trailers) {
+            std::cout << "< " << trailer.name << ": " << trailer.value << std::endl;
+        }
+    }
+
+    auto requestConnection = request.headers.find("Connection");
+    const std::string* sharedConnection = request.sharedHeaders ? request.sharedHeaders->find("Connection") : nullptr;
+    if ((requestConnection != request.headers.end() && strcasestr(requestConnection->second.c_str(), "close")) ||
+        (sharedConnection && strcasestr(sharedConnection->c_str(), "close"))) {
+        reusable = false;
     }
-    close(sock);
-    //Parse the raw response
-    std::istringstream resposne_stream(raw_response);
-    std::getline(resposne_stream,response.statusLine);
-    if (verbose) std::cout << "< " << response.statusLine << std::endl;
-    std::string header;
-    while(std::getline(resposne_stream,header) && header != "\r") {
-        if(!header.empty() && header != "\r") {
-            response.headers.push_back(header);
-            if (verbose) std::cout << "< " << header << std::endl;
+    conn->requestsServed++;
+    if (reusable) {
+        pool.release(std::move(conn));
+    }
+}
+
+bool HttpClient::willFollow(const HttpResponse& response) const {
+    return followRedirects && isRedirect(response.statusCode) && !response.headers.get(KnownHeader::Location).empty();
+}
+
+bool HttpClient::nextRedirect(const HttpRequest& request, const HttpResponse& response, int redirects,
+                              HttpRequest& next) const {
+    if (!willFollow(response)) {
+        return false;
+    }
+    if (redirects >= redirectLimit) {
+        throw std::runtime_error("Maximum (" + std::to_string(redirectLimit) + ") redirects followed");
+    }
+    next = request;
+    next.url = UrlParser::resolve(request.url, std::string(response.headers.get(KnownHeader::Location)));
+    int status = response.statusCode;
+    if ((status == 303 && request.method != HttpMethod::HEAD) ||
+        ((status == 301 || status == 302) && request.method == HttpMethod::POST)) {
+        next.method = HttpMethod::GET;
+        next.data.clear();
+        removeHeaders(next, {"Content-Type", "Content-Length"});
+    }
+    if (ConnectionPool::originKey(next.url) != ConnectionPool::originKey(request.url)) {
+        removeHeaders(next, {"Authorization", "Cookie"});
+    }
+    return true;
+}
+
+void HttpClient::performFollowing(const HttpRequest& request, bool verbose, HttpResponse& response,
+                                  const BodySink& onBody,
+                                  const std::function<bool(Connection&, HttpResponseParser&)>& onHeaders) {
+    const HttpRequest* current = &request;
+    HttpRequest redirected;
+    for (int redirects = 0; ; ++redirects) {
+        // A redirect's own body is read (so its connection can be reused) but not delivered.
+        performRequest(*current, verbose, response,
+            [&](const char* data, size_t length) {
+                if (!willFollow(response)) {
+                    onBody(data, length);
+                }
+            },
+            [&](Connection& conn, HttpResponseParser& parser) {
+                return onHeaders && !willFollow(response) && onHeaders(conn, parser);
+            });
+        HttpRequest next;
+        if (!nextRedirect(*current, response, redirects, next)) {
+            response.redirects = redirects;
+            if (redirects > 0) {
+                response.effectiveUrl = current->url.toString();
+            }
+            return;
+        }
+        if (verbose) {
+            std::cout << "* Following redirect to " << next.url.toString() << std::endl;
         }
+        redirected = std::move(next);
+        current = &redirected;
     }
+}
+
+HttpResponse HttpClient::sendRequest(const HttpRequest& request, bool verbose) {
+    std::string body;
+    HttpResponse response = sendRequest(request, verbose, [&body](const char* data, size_t length) {
+        body.append(data, length);
+    });
+    response.body = std::move(body);
+    return response;
+}
 
-    if (verbose) std::cout << "<" << std::endl;
+HttpResponse HttpClient::sendRequest(const HttpRequest& request, bool verbose, const BodySink& sink) {
+    HttpResponse response;
+    HttpCache::Entry entry;
+    CacheState cacheState = cache ? lookupCache(*cache, request, verbose, entry) : CacheState::Miss;
+    if (cacheState == CacheState::Fresh) {
+        response.timing.start = std::chrono::steady_clock::now();
+        HttpCache::describe(entry, response);
+        cache->readBody(entry, sink);
+        response.timing.total = response.timing.elapsed();
+        return response;
+    }
+    if (!cache || !HttpCache::usable(request)) {
+        performFollowing(request, verbose, response, sink);
+        return response;
+    }
 
-    std::string body((std::istreambuf_iterator<char>(resposne_stream)), std::istreambuf_iterator<char>());
-    response.body = body;
+    HttpRequest actual = request;
+    if (cacheState == CacheState::Stale) {
+        HttpCache::addValidators(entry, actual);
+    }
+    CacheFill fill(*cache, request, response);
+    performFollowing(actual, verbose, response, [&](const char* data, size_t length) {
+        fill.append(data, length);
+        sink(data, length);
+    });
+    if (cacheState == CacheState::Stale && response.statusCode == 304 && response.redirects == 0) {
+        if (verbose) std::cout << "* Cache entry revalidated (304 Not Modified)" << std::endl;
+        cache->refresh(entry, response);
+        HttpCache::describe(entry, response);
+        cache->readBody(entry, sink);
+        response.timing.total = response.timing.elapsed();
+    } else {
+        fill.commit();
+    }
     return response;
 }
 
-void HttpClient::downloadFile(const HttpRequest& request, bool verbose) {
-    std::string requestStr = generateRequest(request);
-    int sock = createSocket(request.url.host, request.url.port);
-    SSL* ssl = nullptr;
+void HttpClient::setCacheDirectory(const std::string& path, uint64_t maxSize) {
+    cache = std::make_unique<HttpCache>(path, maxSize);
+}
 
-    // Create SSL connection if protocol is HTTPS
-    if (request.url.protocol == "https") {
-        ssl = this->createSSLConnection(sock, request.url.host);
+BodySink streamSink(std::ostream& out) {
+    return [&out](const char* data, size_t length) {
+        if (!out.write(data, static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Failed to write the response body");
+        }
+    };
+}
+
+bool HttpClient::downloadSegmented(const HttpRequest& request, bool verbose, HttpResponse& result) {
+    // Probe for the size and range support without transferring the body.
+    HttpRequest probe = request;
+    probe.method = HttpMethod::HEAD;
+    probe.data.clear();
+    HttpResponse head;
+    try {
+        head = sendRequest(probe, false);
+    } catch (const std::exception&) {
+        return false;
+    }
+    int64_t length = head.headers.contentLength();
+    std::string acceptRanges(head.headers.get(KnownHeader::AcceptRanges));
+    if (head.statusCode != 200 || length < 0 || !strcasestr(acceptRanges.c_str(), "bytes")) {
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(length);
+    size_t segments = static_cast<size_t>(std::min<uint64_t>(downloadSegments, size / minSegmentSize));
+    if (segments < 2) {
+        return false;
+    }
+
+    // Make every range conditional on the resource being the one we probed; if it changed,
+    // the server answers 200 with the full body and the download is abandoned.
+    std::string validator = std::string(head.headers.get(KnownHeader::ETag));
+    if (validator.empty() || validator.compare(0, 2, "W/") == 0) {
+        validator = std::string(head.headers.get(KnownHeader::LastModified));
+    }
+
+    int fd = open(request.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to open output file: " + request.outputFile);
+    }
+    // Reserve the blocks up front without changing the file size: the file only reaches its full
+    // size once every segment has arrived, so an interrupted download never looks complete.
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+
+    if (verbose) {
+        std::cout << "* Downloading " << size << " bytes in " << segments << " segments" << std::endl;
+    }
+
+    std::vector<uint64_t> starts(segments + 1);
+    for (size_t i = 0; i <= segments; ++i) {
+        starts[i] = size * i / segments;
+    }
+    std::vector<uint64_t> written(segments, 0);
+    std::vector<std::exception_ptr> errors(segments);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < segments; ++i) {
+        workers.emplace_back([&, i]() {
+            try {
+                uint64_t start = starts[i];
+                uint64_t end = starts[i + 1];
+                HttpRequest part = request;
+                part.headers["Range"] = "bytes=" + std::to_string(start) + "-" + std::to_string(end - 1);
+                if (!validator.empty()) {
+                    part.headers["If-Range"] = validator;
+                }
+                HttpResponse response;
+                performFollowing(part, false, response, [&](const char* data, size_t length) {
+                    if (written[i] == 0) {
+                        std::string range = std::string(response.headers.get(KnownHeader::ContentRange));
+                        if (response.statusCode != 206 || range.compare(0, 6, "bytes ") != 0 ||
+                            std::strtoull(range.c_str() + 6, nullptr, 10) != start) {
+                            throw std::runtime_error("Server did not honour the Range request");
+                        }
+                    }
+                    if (start + written[i] + length > end) {
+                        throw std::runtime_error("Server sent more data than the requested range");
+                    }
+                    pwriteAll(fd, data, length, start + written[i]);
+                    written[i] += length;
+                });
+                if (start + written[i] != end) {
+                    throw std::runtime_error("Incomplete response for range " + std::to_string(start) + "-" +
+                                             std::to_string(end - 1));
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
     }
 
-    // Verbose output of the request being sent
+    for (size_t i = 0; i < segments; ++i) {
+        if (errors[i]) {
+            // Keep only the contiguous prefix that is known to be good.
+            uint64_t valid = 0;
+            for (size_t j = 0; j < segments && valid == starts[j]; ++j) {
+                valid += written[j];
+            }
+            if (ftruncate(fd, valid) == -1) {
+                // Nothing better to do; the original error is more useful.
+            }
+            close(fd);
+            if (resumeDownloads) {
+                ResumeState state;
+                state.url = urlString(request.url);
+                state.validator = validator;
+                state.totalSize = size;
+                state.save(request.outputFile);
+            }
+            std::rethrow_exception(errors[i]);
+        }
+    }
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        throw std::runtime_error("Failed to size output file: " + request.outputFile);
+    }
+    if (close(fd) == -1) {
+        throw std::runtime_error("Failed to write output file: " + request.outputFile);
+    }
     if (verbose) {
-        std::cout << "> " << requestStr.substr(0, requestStr.find("\r\n")) << std::endl;
-        std::istringstream iss(requestStr);
-        std::string line;
-        std::getline(iss, line); // Skip the first line
-        while (std::getline(iss, line) && !line.empty()) {
-            std::cout << "> " << line << std::endl;
+        std::cout << "File downloaded successfully: " << request.outputFile << std::endl;
+    }
+    // Report the probe's headers and early phases, and the whole download's size and duration.
+    result = head;
+    result.bodyBytes = size;
+    result.timing.total = result.timing.elapsed();
+    return true;
+}
+
+HttpResponse HttpClient::downloadFile(const HttpRequest& request, bool verbose) {
+    HttpRequest actual = request;
+    uint64_t offset = 0;
+    if (resumeDownloads) {
+        struct stat st;
+        if (stat(request.outputFile.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            offset = static_cast<uint64_t>(st.st_size);
+        }
+        // Only a partial file whose origin is known can be continued: the saved validator makes the
+        // Range conditional, so a changed resource comes back whole instead of being spliced onto old bytes.
+        ResumeState saved;
+        if (offset > 0 && saved.load(request.outputFile) && saved.url == urlString(request.url) &&
+            !saved.validator.empty()) {
+            actual.headers["Range"] = "bytes=" + std::to_string(offset) + "-";
+            actual.headers["If-Range"] = saved.validator;
+        } else if (offset > 0) {
+            if (verbose) std::cout << "* No resume state matches the output file, restarting download" << std::endl;
+            offset = 0;
         }
-        std::cout << "> " << std::endl;
     }
 
-    // Send the request using SSL or plain socket
-    if (ssl) {
-        if (SSL_write(ssl, requestStr.c_str(), requestStr.length()) <= 0) {
-            this->handleSSLError(ssl, 0);
+    HttpResponse response;
+    HttpCache::Entry entry;
+    CacheState cacheState = cache && offset == 0 ? lookupCache(*cache, request, verbose, entry) : CacheState::Miss;
+    if (cacheState == CacheState::Fresh) {
+        response.timing.start = std::chrono::steady_clock::now();
+        int fd = open(request.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            throw std::runtime_error("Failed to open output file: " + request.outputFile);
         }
-    } else {
-        if (send(sock, requestStr.c_str(), requestStr.length(), 0) < 0) {
-            close(sock);
-            throw std::runtime_error("Failed to send Request!");
+        try {
+            cache->copyBody(entry, fd);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        if (close(fd) == -1) {
+            throw std::runtime_error("Failed to write output file: " + request.outputFile);
         }
+        HttpCache::describe(entry, response);
+        response.timing.total = response.timing.elapsed();
+        ResumeState::remove(request.outputFile);
+        if (verbose) std::cout << "File copied from cache: " << request.outputFile << std::endl;
+        return response;
+    }
+    if (cacheState == CacheState::Stale) {
+        HttpCache::addValidators(entry, actual);
+    }
+    // Stores a completed download (whose body is the output file) in the cache.
+    auto storeDownload = [&]() {
+        if (cache && offset == 0) {
+            CacheFill fill(*cache, request, response);
+            fill.appendFile(request.outputFile);
+            fill.commit();
+        }
+    };
+
+    // Ranges address the encoded representation, which cannot be decoded in pieces. A cached copy is
+    // revalidated with a single conditional request instead.
+    if (offset == 0 && downloadSegments > 1 && request.method == HttpMethod::GET && !request.compressed &&
+        cacheState == CacheState::Miss && downloadSegmented(request, verbose, response)) {
+        ResumeState::remove(request.outputFile);
+        storeDownload();
+        return response;
     }
 
     // Open the output file to write the response body
-    std::ofstream outFile(request.outputFile, std::ios::binary);
-    if (!outFile) {
-        close(sock);
-        if (ssl) {
-            SSL_shutdown(ssl);
-            SSL_free(ssl);
-        }
+    int fd = open(request.outputFile.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (offset > 0 ? 0 : O_TRUNC), 0644);
+    if (fd == -1) {
         throw std::runtime_error("Failed to open output file: " + request.outputFile);
     }
 
-    char buffer[4096];
-    int bytes_received;
-    bool headers_done = false;
-    std::string header_buffer;
-
-    // Receive the response
-    while (true) {
-        if (ssl) {
-            bytes_received = SSL_read(ssl, buffer, sizeof(buffer));
-            if (bytes_received <= 0) {
-                int err = SSL_get_error(ssl, bytes_received);
-                if (err == SSL_ERROR_ZERO_RETURN) {
-                    break; // SSL connection closed cleanly
-                } else {
-                    this->handleSSLError(ssl, bytes_received);
+    bool prepared = false;
+    bool alreadyComplete = false;
+    auto revalidated = [&]() {
+        return cacheState == CacheState::Stale && response.statusCode == 304 && response.redirects == 0;
+    };
+    // Decides where the body goes once the status is known, before the first body byte is written.
+    auto prepare = [&](int64_t contentLength) {
+        if (prepared) {
+            return;
+        }
+        prepared = true;
+        uint64_t start = 0;
+        if (offset > 0) {
+            std::string range = std::string(response.headers.get(KnownHeader::ContentRange));
+            if (response.statusCode == 206) {
+                if (range.compare(0, 6, "bytes ") != 0 || std::strtoull(range.c_str() + 6, nullptr, 10) != offset) {
+                    throw std::runtime_error("Server resumed at the wrong offset: " + range);
                 }
+                start = offset;
+                if (verbose) std::cout << "* Resuming download at byte " << offset << std::endl;
+            } else if (response.statusCode == 416 && range.compare(0, 8, "bytes */") == 0 &&
+                       std::strtoull(range.c_str() + 8, nullptr, 10) == offset) {
+                alreadyComplete = true;
+                if (verbose) std::cout << "* File is already complete" << std::endl;
+                return;
+            } else if (response.statusCode == 200) {
+                if (verbose) std::cout << "* Server sent the whole file, restarting download" << std::endl;
+            } else {
+                throw std::runtime_error("Cannot resume download: " + response.statusLine);
             }
-        } else {
-            bytes_received = recv(sock, buffer, sizeof(buffer), 0);
-            if (bytes_received <= 0) {
-                break;
+        }
+        if (ftruncate(fd, start) == -1 || lseek(fd, start, SEEK_SET) == -1) {
+            throw std::runtime_error("Failed to prepare output file: " + request.outputFile);
+        }
+        if (contentLength > 0) {
+            // Reserve the blocks up front without changing the file size, so a failed
+            // download never leaves a file that looks complete.
+            fallocate(fd, FALLOC_FL_KEEP_SIZE, start, contentLength);
+        }
+        if (resumeDownloads && (response.statusCode == 200 || response.statusCode == 206)) {
+            ResumeState state;
+            state.url = urlString(request.url);
+            state.validator = std::string(response.headers.get(KnownHeader::ETag));
+            if (state.validator.empty() || state.validator.compare(0, 2, "W/") == 0) {
+                state.validator = std::string(response.headers.get(KnownHeader::LastModified));
             }
+            state.totalSize = contentLength >= 0 ? start + contentLength : 0;
+            state.save(request.outputFile);
         }
+    };
 
-        // Process headers and write the response body to the file
-        if (!headers_done) {
-            header_buffer.append(buffer, bytes_received);
-            size_t header_end = header_buffer.find("\r\n\r\n");
-            if (header_end != std::string::npos) {
-                headers_done = true;
-                if (verbose) {
-                    std::istringstream headerStream(header_buffer.substr(0, header_end));
-                    std::string line;
-                    while (std::getline(headerStream, line)) {
-                        std::cout << "< " << line << std::endl;
+    try {
+        performFollowing(actual, verbose, response,
+            [&](const char* data, size_t length) {
+                prepare(-1);
+                if (!alreadyComplete) {
+                    writeAll(fd, data, length);
+                }
+            },
+            [&](Connection& conn, HttpResponseParser& parser) {
+                prepare(parser.contentLength());
+                bool decoding = request.compressed && !response.headers.get(KnownHeader::ContentEncoding).empty();
+                if (alreadyComplete || !(spliceDownloads || uringDownloads) || decoding || !parser.rawBodyPending()) {
+                    return false;
+                }
+                int64_t remaining = parser.rawBodyRemaining();
+                if (conn.ssl) {
+                    if (!spliceDownloads) {
+                        return false;
+                    }
+                    // Only records the kernel decrypts can be spliced, and only while OpenSSL holds no
+                    // decrypted bytes of its own. Whatever splice leaves behind goes through SSL_read.
+                    if (!kernelTlsReceive(conn.ssl) || SSL_pending(conn.ssl) > 0 || remaining < 0) {
+                        return false;
                     }
-                    std::cout << "< " << std::endl;
+                    uint64_t moved = spliceKtlsToFile(conn.sock, fd, static_cast<uint64_t>(remaining));
+                    response.bodyBytes += moved;
+                    parser.skipRawBody(moved);
+                    return parser.done();
                 }
-                // Write body part after headers
-                outFile.write(buffer + header_end + 4, bytes_received - (header_end + 4));
-            }
-        } else {
-            // Headers are done, write the rest of the body directly
-            outFile.write(buffer, bytes_received);
+                bool useUring = uringDownloads && isRegularFile(fd) && uringAvailable();
+                if (!useUring && !spliceDownloads) {
+                    return false;
+                }
+                if (verbose && useUring) {
+                    std::cout << "* Receiving body with io_uring" << std::endl;
+                }
+                uint64_t moved = useUring ? uringSocketToFile(conn.sock, fd, remaining)
+                                          : spliceSocketToFile(conn.sock, fd, remaining);
+                response.bodyBytes += moved;
+                if (remaining < 0) {
+                    parser.finish();
+                } else {
+                    parser.skipRawBody(moved);
+                }
+                return true;
+            });
+        prepare(-1);
+        if (revalidated()) {
+            if (verbose) std::cout << "* Cache entry revalidated (304 Not Modified)" << std::endl;
+            cache->refresh(entry, response);
+            HttpCache::describe(entry, response);
+            cache->copyBody(entry, fd);
+            response.timing.total = response.timing.elapsed();
         }
+    } catch (...) {
+        close(fd);
+        throw;
     }
-
-    // Clean up SSL and socket resources
-    if (ssl) {
-        SSL_shutdown(ssl);
-        SSL_free(ssl);
+    if (close(fd) == -1) {
+        throw std::runtime_error("Failed to write output file: " + request.outputFile);
+    }
+    if (resumeDownloads) {
+        ResumeState::remove(request.outputFile);
+    }
+    if (!response.fromCache && !alreadyComplete) {
+        storeDownload();
     }
-    close(sock);
-    outFile.close();
 
     // Verbose message on successful download
     if (verbose) {
         std::cout << "File downloaded successfully: " << request.outputFile << std::endl;
     }
-}
\ No newline at end of file
+    return response;
+}
+
+std::vector<FetchResult> HttpClient::fetchAll(const std::vector<HttpRequest>& requests, size_t maxConcurrent) {
+    std::vector<FetchResult> results(requests.size());
+    size_t next = 0;
+    fetchEach(
+        [&](HttpRequest& request) {
+            if (next == requests.size()) {
+                return false;
+            }
+            request = requests[next++];
+            return true;
+        },
+        [&results](size_t index, FetchResult& result) { results[index] = std::move(result); },
+        maxConcurrent);
+    return results;
+}
+
+void HttpClient::fetchEach(const RequestSource& next, const ResultHandler& onResult, size_t maxConcurrent,
+                           bool keepBodies) {
+    fetchEachWith(next, onResult, maxConcurrent, keepBodies, nullptr);
+}
+
+void HttpClient::fetchEachWith(const RequestSource& next, const ResultHandler& onResult, size_t maxConcurrent,
+                               bool keepBodies, std::unique_ptr<Connection> http2Connection) {
+    EventLoop loop;
+    AsyncResolver asyncResolver(loop, resolver);
+    Http2Multiplexer multiplexer(loop);
+    if (http2Connection) {
+        multiplexer.adopt(std::move(http2Connection));
+    }
+    /// @brief A transfer in flight, with its position in the stream and the redirects that led to it.
+    struct Slot {
+        size_t index;
+        int redirects;
+        std::unique_ptr<AsyncTransfer> transfer;
+    };
+    // Finished transfers are only destroyed after the loop iteration, since they complete from
+    // inside their own handlers.
+    std::map<AsyncTransfer*, Slot> inFlight;
+    std::vector<AsyncTransfer*> finished;
+    size_t started = 0;
+    bool exhausted = false;
+    maxConcurrent = std::max<size_t>(maxConcurrent, 1);
+
+    auto launch = [&](const HttpRequest& request, size_t index, int redirects, std::unique_ptr<Connection> idle) {
+        auto transfer = std::make_unique<AsyncTransfer>(loop, ctx, asyncResolver, connectTimeout, multiplexer, request,
+            [&finished](AsyncTransfer& done) { finished.push_back(&done); });
+        transfer->setDiscardBody(!keepBodies);
+        // A redirect to the same origin is followed on the connection that received it.
+        transfer->setKeepAlive(followRedirects);
+        if (idle) {
+            transfer->useConnection(std::move(idle));
+        }
+        AsyncTransfer* raw = transfer.get();
+        inFlight.emplace(raw, Slot{index, redirects, std::move(transfer)});
+        raw->start();
+    };
+
+    auto reap = [&] {
+        // Follow-up requests started here may fail at once, so repeat until nothing is left.
+        while (!finished.empty()) {
+            std::vector<AsyncTransfer*> done;
+            done.swap(finished);
+            for (AsyncTransfer* transfer : done) {
+                auto it = inFlight.find(transfer);
+                Slot slot = std::move(it->second);
+                inFlight.erase(it);
+                FetchResult result{transfer->response(), transfer->error(), transfer->bodyBytes(), transfer->elapsed()};
+                if (result.error.empty()) {
+                    // A redirect hands its slot to the follow-up, which reports under the same index.
+                    HttpRequest follow;
+                    bool follows = false;
+                    try {
+                        follows = nextRedirect(transfer->sentRequest(), result.response, slot.redirects, follow);
+                    } catch (const std::exception& e) {
+                        result.error = e.what();
+                    }
+                    if (follows) {
+                        std::unique_ptr<Connection> idle;
+                        if (ConnectionPool::originKey(follow.url) == transfer->origin()) {
+                            idle = transfer->takeConnection();
+                        }
+                        launch(follow, slot.index, slot.redirects + 1, std::move(idle));
+                        continue;
+                    }
+                    result.response.redirects = slot.redirects;
+                    if (slot.redirects > 0) {
+                        result.response.effectiveUrl = transfer->sentRequest().url.toString();
+                    }
+                }
+                onResult(slot.index, result);
+            }
+        }
+    };
+
+    while (true) {
+        while (!exhausted && inFlight.size() - finished.size() < maxConcurrent) {
+            HttpRequest request;
+            if (!next(request)) {
+                exhausted = true;
+                break;
+            }
+            launch(request, started++, 0, nullptr);
+        }
+        reap();
+        if (inFlight.empty()) {
+            if (exhausted) {
+                break;
+            }
+            continue;
+        }
+        loop.poll(-1);
+        reap();
+    }
+}
+
+std::vector<FetchResult> HttpClient::fetchPipelined(const std::vector<HttpRequest>& requests, size_t depth,
+                                                    size_t maxOrigins) {
+    std::vector<FetchResult> results(requests.size());
+    // Requests keep their relative order within an origin, since responses come back in that order.
+    std::map<std::string, std::vector<size_t>> byOrigin;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        byOrigin[ConnectionPool::originKey(requests[i].url)].push_back(i);
+    }
+    std::vector<const std::vector<size_t>*> origins;
+    for (const auto& entry : byOrigin) {
+        origins.push_back(&entry.second);
+    }
+
+    std::atomic<size_t> nextOrigin{0};
+    auto work = [&]() {
+        for (size_t i; (i = nextOrigin++) < origins.size();) {
+            pipelineOrigin(requests, *origins[i], std::max<size_t>(depth, 1), results);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(origins.size(), std::max<size_t>(maxOrigins, 1)); ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return results;
+}
+
+void HttpClient::pipelineOrigin(const std::vector<HttpRequest>& requests, const std::vector<size_t>& order,
+                                size_t depth, std::vector<FetchResult>& results) {
+    char buffer[16384];
+    size_t done = 0; // Requests in `order` that have their result.
+    while (done < order.size()) {
+        TransferTiming connectTiming;
+        connectTiming.start = std::chrono::steady_clock::now();
+        std::unique_ptr<Connection> conn;
+        try {
+            conn = openConnection(requests[order[done]].url, connectTiming);
+        } catch (const std::exception& e) {
+            results[order[done]].error = e.what();
+            ++done;
+            continue;
+        }
+        if (conn->http2) {
+            // Streams beat pipelining: the multiplexing event loop takes over this connection and runs
+            // the rest of the origin's requests as streams on it.
+            size_t first = done;
+            std::vector<bool> reported(order.size() - first, false);
+            try {
+                fetchEachWith(
+                    [&](HttpRequest& request) {
+                        if (done == order.size()) {
+                            return false;
+                        }
+                        request = requests[order[done++]];
+                        return true;
+                    },
+                    [&](size_t index, FetchResult& result) {
+                        results[order[first + index]] = std::move(result);
+                        reported[index] = true;
+                    },
+                    depth, true, std::move(conn));
+            } catch (const std::exception& e) {
+                for (size_t i = 0; i < reported.size(); ++i) {
+                    if (!reported[i]) {
+                        results[order[first + i]].error = e.what();
+                    }
+                }
+            }
+            return;
+        }
+
+        bool reused = conn->requestsServed > 0;
+        size_t sent = done;     // Requests in `order` written so far.
+        size_t answered = 0;    // Responses read on this connection.
+        std::string pending;    // Bytes read past the end of the previous response.
+        bool keepAlive = true;
+        bool started = false;   // Part of the response to request `done` has arrived.
+        bool writable = true;   // False once a write failed; responses already sent can still be read.
+        std::string failure;
+        try {
+            while (done < order.size() && keepAlive && (writable || done < sent)) {
+                // Top up the pipeline, coalescing the new requests into one write. A request that cannot be
+                // replayed is only sent on an idle connection and nothing is queued behind it.
+                if (writable && sent < order.size() && sent - done < depth &&
+                    (sent == done || isIdempotent(requests[order[sent - 1]].method))) {
+                    std::string batch;
+                    size_t first = sent;
+                    auto now = std::chrono::steady_clock::now();
+                    while (sent < order.size() && sent - done < depth) {
+                        const HttpRequest& request = requests[order[sent]];
+                        if (!isIdempotent(request.method) && sent > done) {
+                            break;
+                        }
+                        HttpResponse& response = results[order[sent]].response;
+                        response = HttpResponse();
+                        if (answered == 0 && sent == done) {
+                            response.timing = connectTiming;
+                        } else {
+                            response.timing.start = now;
+                            response.timing.connectionReused = true;
+                        }
+                        batch += generateRequest(request);
+                        ++sent;
+                        if (!isIdempotent(request.method)) {
+                            break;
+                        }
+                    }
+                    try {
+                        sendRaw(*conn, batch);
+                    } catch (const std::exception&) {
+                        // The server may have closed the connection after responses that are still unread
+                        // (e.g. with Connection: close); read those, and replay the rest on a new connection.
+                        if (first == done) {
+                            throw;
+                        }
+                        writable = false;
+                    }
+                    for (size_t i = first; i < sent; ++i) {
+                        TransferTiming& timing = results[order[i]].response.timing;
+                        timing.requestSent = timing.elapsed();
+                    }
+                }
+
+                // Read the response to the oldest request still waiting.
+                const HttpRequest& request = requests[order[done]];
+                HttpResponse& response = results[order[done]].response;
+                std::unique_ptr<ContentDecoder> decoder;
+                BodySink keep = [&response](const char* data, size_t length) { response.body.append(data, length); };
+                HttpResponseParser parser(response, [&](const char* data, size_t length) {
+                    response.bodyBytes += length;
+                    if (decoder) {
+                        decoder->decode(data, length);
+                    } else {
+                        keep(data, length);
+                    }
+                });
+                parser.setNoBody(request.method == HttpMethod::HEAD);
+                if (request.compressed) {
+                    parser.setHeadersCallback([&]() {
+                        decoder = ContentDecoder::create(std::string(response.headers.get(KnownHeader::ContentEncoding)), keep);
+                    });
+                }
+                started = !pending.empty();
+                if (started) {
+                    response.timing.firstByte = response.timing.elapsed();
+                    pending.erase(0, parser.feed(pending.data(), pending.size()));
+                }
+                while (!parser.done()) {
+                    int n = readSome(*conn, buffer, sizeof(buffer));
+                    if (n == 0) {
+                        if (!started) {
+                            throw std::runtime_error("Connection closed before the response was received");
+                        }
+                        parser.finish();
+                        break;
+                    }
+                    if (!started) {
+                        started = true;
+                        response.timing.firstByte = response.timing.elapsed();
+                    }
+                    size_t used = parser.feed(buffer, n);
+                    pending.assign(buffer + used, n - used);
+                }
+                if (decoder) {
+                    decoder->finish();
+                }
+                response.timing.total = response.timing.elapsed();
+                results[order[done]].bodyBytes = response.bodyBytes;
+                results[order[done]].elapsed = response.timing.total;
+                keepAlive = parser.keepAlive();
+                conn->requestsServed++;
+                ++answered;
+                ++done;
+                started = false;
+            }
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+        if (!failure.empty()) {
+            // Requests the server never started answering are replayed on a fresh connection, unless a fresh
+            // connection already failed to answer any of them. A request that is not idempotent was alone on
+            // the connection, so this is the same single retry that performRequest() makes.
+            bool replay = !started && (answered > 0 || reused);
+            if (!replay) {
+                results[order[done]].error = failure;
+                ++done;
+            }
+        } else if (keepAlive && writable) {
+            pool.release(std::move(conn));
+        }
+    }
+}
@@ -1,21 +1,37 @@
 #pragma once
 #include "url_parser.h"
+#include "connection_pool.h"
+#include "http_headers.h"
+#include "response_parser.h"
+#include "tls_session_cache.h"
+#include "resolver.h"
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <fstream>
+#include <ostream>
+#include <functional>
+#include <memory>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+/// @brief Default limit on the redirects one request follows.
 const int maxRedirects = 5;
 
+class HeaderBlock;
+class HttpCache;
+class SerializedRequest;
+
 
 /// @brief Enumeration of supported HTTP methods.
 enum class HttpMethod {
     GET,     ///< HTTP GET method for retrieving resources.
     POST,    ///< HTTP POST method for sending data to the server.
     PUT,     ///< HTTP PUT method for updating resources on the server.
-    DELETE   ///< HTTP DELETE method for removing resources from the server.
+    DELETE,  ///< HTTP DELETE method for removing resources from the server.
+    HEAD     ///< HTTP HEAD method for retrieving only the headers of a resource.
 };
 
 /// @brief Map to convert the input string and validate against our existing supported methods.
@@ -23,7 +39,8 @@ const std::map<std::string, HttpMethod> StringToHttpMethod = {
     {"GET", HttpMethod::GET},       ///< Maps "GET" string to HttpMethod::GET.
     {"POST", HttpMethod::POST},     ///< Maps "POST" string to HttpMethod::POST.
     {"DELETE", HttpMethod::DELETE}, ///< Maps "DELETE" string to HttpMethod::DELETE.
-    {"PUT", HttpMethod::PUT}        ///< Maps "PUT" string to HttpMethod::PUT.
+    {"PUT", HttpMethod::PUT},       ///< Maps "PUT" string to HttpMethod::PUT.
+    {"HEAD", HttpMethod::HEAD}      ///< Maps "HEAD" string to HttpMethod::HEAD.
 };
 
 /// @brief Map to convert the output METHOD and use that to generate request.
@@ -31,7 +48,8 @@ const std::map<HttpMethod, std::string> HttpMethodToString = {
     {HttpMethod::GET, "GET"},       ///< Maps HttpMethod::GET to "GET" string.
     {HttpMethod::POST, "POST"},     ///< Maps HttpMethod::POST to "POST" string.
     {HttpMethod::PUT, "PUT"},       ///< Maps HttpMethod::PUT to "PUT" string.
-    {HttpMethod::DELETE, "DELETE"}  ///< Maps HttpMethod::DELETE to "DELETE" string.
+    {HttpMethod::DELETE, "DELETE"}, ///< Maps HttpMethod::DELETE to "DELETE" string.
+    {HttpMethod::HEAD, "HEAD"}      ///< Maps HttpMethod::HEAD to "HEAD" string.
 };
 
 /// @brief Struct representing an HTTP request.
@@ -40,22 +58,82 @@ const std::map<HttpMethod, std::string> HttpMethodToString = {
 /// @param headers A map of headers to be sent with the request.
 /// @param data The data payload to be sent with the request (for POST/PUT).
 /// @param outputFile The file path to which the response body will be written if provided.
+/// @param sharedHeaders Optional pre-encoded headers shared with other requests, sent before `headers`.
+/// @param compressed Whether a Content-Encoding of the response is decoded (the caller sends Accept-Encoding).
 struct HttpRequest {
     HttpMethod method;                        ///< HTTP method to use.
     ParsedUrl url;                            ///< Parsed URL of the request.
     std::map<std::string, std::string> headers; ///< Headers to be included in the request.
     std::string data;                         ///< Data to be sent in the request body.
     std::string outputFile;                   ///< Optional file path to save the response body.
+    std::shared_ptr<const HeaderBlock> sharedHeaders; ///< Pre-encoded headers; fields in `headers` override them.
+    bool compressed = false;                  ///< Decode the response's Content-Encoding.
+};
+
+/// @brief When each phase of a request finished, counted from the start of the request like curl's
+/// -w times, so each value includes the phases before it. On a reused connection the lookup, connect
+/// and TLS times are the (near zero) time taken to take the connection from the pool. For plain HTTP
+/// the TLS time is zero.
+struct TransferTiming {
+    std::chrono::steady_clock::time_point start;  ///< When the request started.
+    std::chrono::microseconds nameLookup{0};      ///< Host name resolved.
+    std::chrono::microseconds connect{0};         ///< TCP connection established.
+    std::chrono::microseconds tlsHandshake{0};    ///< TLS handshake completed.
+    std::chrono::microseconds requestSent{0};     ///< Request completely written.
+    std::chrono::microseconds firstByte{0};       ///< First response byte received.
+    std::chrono::microseconds total{0};           ///< Response completely received.
+    bool connectionReused = false;                ///< The request went out on a pooled connection.
+
+    /// @brief Returns the time elapsed since `start`.
+    std::chrono::microseconds elapsed() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
 };
 
 /// @brief Struct representing an HTTP response.
 /// @param statusLine The status line of the HTTP response (e.g., "HTTP/1.1 200 OK").
-/// @param headers The headers received in the HTTP response.
+/// @param statusCode The numeric status code (e.g., 200).
+/// @param headers The headers received in the HTTP response, in one buffer with indexed lookup.
+/// @param trailers The trailer fields received after a chunked body (or in HTTP/2 trailing HEADERS).
 /// @param body The body content of the HTTP response.
+/// @param bodyBytes The number of body bytes received, including any written to a file. With content
+/// decoding this is the compressed size, as on the wire.
+/// @param timing The per-phase timing of the request.
+/// @param redirects The number of redirects followed to reach this response.
+/// @param effectiveUrl The URL this response came from, if redirects were followed.
+/// @param fromCache Whether the body was served from the response cache.
 struct HttpResponse {
     std::string statusLine;                    ///< The status line of the response.
-    std::vector<std::string> headers;          ///< List of headers received in the response.
+    int statusCode = 0;                        ///< The numeric status code of the response.
+    HttpHeaders headers;                       ///< Headers received in the response.
+    HttpHeaders trailers;                      ///< Trailer fields sent after the body.
     std::string body;                          ///< Body of the response.
+    uint64_t bodyBytes = 0;                    ///< Body bytes received, wherever they went.
+    TransferTiming timing;                     ///< When each phase of the request finished.
+    int redirects = 0;                         ///< Redirects followed to reach this response.
+    std::string effectiveUrl;                  ///< URL of this response after redirects, empty if none were followed.
+    bool fromCache = false;                    ///< The body came from the response cache (fresh or revalidated).
+
+    /// @brief Case-insensitively looks up a header; a copying shorthand for headers.get().
+    /// @param name The header name, e.g. "Content-Length".
+    /// @return The value with surrounding whitespace removed, or an empty string if absent.
+    std::string getHeader(std::string_view name) const { return std::string(headers.get(name)); }
+};
+
+/// @brief Receives response body data as it arrives, so the body never has to be held in memory.
+/// It may throw to abort the request.
+using BodySink = std::function<void(const char* data, size_t length)>;
+
+/// @brief Returns a sink that writes the body to a stream.
+/// @param out The stream, e.g. std::cout; it must outlive the request.
+BodySink streamSink(std::ostream& out);
+
+/// @brief Outcome of one request in a concurrent fetch.
+struct FetchResult {
+    HttpResponse response;                     ///< The response; its body is empty if written to an output file.
+    std::string error;                         ///< Error message, empty if the request succeeded.
+    uint64_t bodyBytes = 0;                    ///< Decoded body bytes received, wherever they went.
+    std::chrono::microseconds elapsed{0};      ///< Time from starting the request until it finished.
 };
 
 /// @brief Class to handle HTTP requests, including SSL connections and file downloads.
@@ -67,6 +145,8 @@ public:
     /// @brief Destructor for HttpClient, cleans up SSL resources.
     ~HttpClient();
 
+    /// @brief Serializes a request into the bytes sent on the wire.
+    /// The send path uses SerializedRequest directly and never builds this string.
     static std::string generateRequest(const HttpRequest& request);
 
     /// @brief Sends the HTTP request to the server and receives the response.
@@ -74,15 +154,131 @@ public:
     /// @param verbose Flag to enable verbose output of the request and response details.
     /// @return The HTTP response received from the server.
     /// @throws std::runtime_error if any error occurs during the request.
-    //HttpResponse sendRequest(const HttpRequest& request, bool verbose,bool followRedirects);
     HttpResponse sendRequest(const HttpRequest& request, bool verbose);
+
+    /// @brief Sends the request and hands the body to `sink` piece by piece as it is received and
+    /// decoded, so memory use does not grow with the size of the response.
+    /// @param request The HTTP request to send.
+    /// @param verbose Flag to enable verbose output; the headers are printed before the first body byte.
+    /// @param sink Receives the body; it is not called for a response without a body.
+    /// @return The response with an empty body.
+    /// @throws std::runtime_error if any error occurs during the request, possibly after part of the
+    /// body was delivered.
+    HttpResponse sendRequest(const HttpRequest& request, bool verbose, const BodySink& sink);
+
     /// @brief Downloads a file from the server using the specified HTTP request.
     /// @param request The HTTP request containing the file URL and download details.
     /// @param verbose Flag to enable verbose output of the download process.
-    void downloadFile(const HttpRequest& request, bool verbose);
+    /// @return The response headers and timing; the body is in the file, not in the response.
+    HttpResponse downloadFile(const HttpRequest& request, bool verbose);
+
+    /// @brief Enables zero-copy downloads: once the headers of a response with an unencoded body are
+    /// parsed, downloadFile() moves the rest of the body from the socket to the file with splice(2).
+    /// HTTPS bodies are spliced only when the kernel decrypts the connection (kTLS receive).
+    void setSpliceDownloads(bool enable) { spliceDownloads = enable; }
+
+    /// @brief Receives plain HTTP download bodies with io_uring (batched multishot receives and fixed-buffer
+    /// file writes) once the headers are parsed. Ignored when the kernel lacks the io_uring features
+    /// needed or the output is not a regular file; the regular read loop (or splice, if enabled) is used then.
+    void setUringDownloads(bool enable) { uringDownloads = enable; }
+
+    /// @brief Splits downloads into up to `segments` byte ranges fetched in parallel, each on its own
+    /// connection. Servers that do not advertise `Accept-Ranges: bytes`, and compressed requests, get a single stream.
+    void setDownloadSegments(size_t segments) { downloadSegments = segments; }
+
+    /// @brief Makes downloadFile() continue an existing partial output file with a Range request,
+    /// validated with If-Range against the ETag/Last-Modified saved when the download started.
+    /// A file without saved state for the same URL (or without a validator) is downloaded again from the start.
+    void setResumeDownloads(bool enable) { resumeDownloads = enable; }
+
+    /// @brief Persists TLS sessions in a file so that later runs can resume them instead of
+    /// doing a full handshake. Sessions are always cached in memory for the client's lifetime.
+    /// @param path The session file; it is created with owner-only permissions.
+    void setTlsSessionFile(const std::string& path) { sessionCache->setSessionFile(path); }
+
+    /// @brief Caches GET responses in a directory for sendRequest() and downloadFile(): fresh entries are
+    /// served without contacting the server, stale ones are revalidated with If-None-Match /
+    /// If-Modified-Since and served from the cache on 304 Not Modified. See HttpCache.
+    /// @param maxSize Bytes the directory may hold before least recently used entries are evicted.
+    /// @throws std::runtime_error if the directory cannot be created.
+    void setCacheDirectory(const std::string& path, uint64_t maxSize = 1ull << 30);
+
+    /// @brief Offers HTTP/2 through ALPN on TLS connections (the default). When the server accepts it,
+    /// requests run as streams; concurrent fetches to one origin share a single connection.
+    void setHttp2(bool enable);
+
+    /// @brief Follows 301, 302, 303, 307 and 308 responses to their Location, for sendRequest(),
+    /// downloadFile() and concurrent fetches. 303 (and 301/302 after a POST) continue as a GET without
+    /// a body; 307 and 308 repeat the request as it was. Authorization and Cookie headers are not sent
+    /// to another origin. Hops to the same origin reuse the keep-alive connection.
+    void setFollowRedirects(bool enable) { followRedirects = enable; }
+
+    /// @brief Sets how many redirects a request may follow before it fails (default maxRedirects).
+    void setMaxRedirects(int limit) { redirectLimit = limit; }
+
+    /// @brief Limits how long establishing a TCP connection may take, across all addresses tried.
+    void setConnectTimeout(std::chrono::milliseconds timeout) { connectTimeout = timeout; }
+
+    /// @brief Sets how long resolved host names are cached.
+    void setDnsCacheTtl(std::chrono::milliseconds ttl) { resolver.setTtl(ttl); }
+
+    /// @brief Fetches many requests concurrently from the calling thread.
+    /// Every request runs on its own non-blocking socket (with non-blocking TLS) and all of them are
+    /// multiplexed on one epoll loop, so the total time approaches that of the slowest request.
+    /// Requests with an output file have their body written there instead of into the result.
+    /// @param requests The requests to send.
+    /// @param maxConcurrent Maximum number of requests in flight at once.
+    /// @return One result per request, in the same order as `requests`.
+    std::vector<FetchResult> fetchAll(const std::vector<HttpRequest>& requests, size_t maxConcurrent);
+
+    /// @brief Supplies the next request of a streamed fetch; returns false when there are no more.
+    using RequestSource = std::function<bool(HttpRequest& request)>;
+
+    /// @brief Receives the result of request number `index` (counting from 0 in source order).
+    using ResultHandler = std::function<void(size_t index, FetchResult& result)>;
+
+    /// @brief Like fetchAll(), but pulls requests from `next` only as slots free up and reports each
+    /// result as soon as it completes, so arbitrarily long request streams run in bounded memory.
+    /// @param next Called whenever another request may be started.
+    /// @param onResult Called once per request, in completion order.
+    /// @param maxConcurrent Maximum number of requests in flight at once.
+    /// @param keepBodies False to only count response bodies that are not written to an output file.
+    void fetchEach(const RequestSource& next, const ResultHandler& onResult, size_t maxConcurrent,
+                   bool keepBodies = true);
+
+    /// @brief Fetches requests with HTTP/1.1 pipelining. Per origin, up to `depth` requests are written
+    /// back-to-back on one keep-alive connection before their responses are read in order, so a batch
+    /// costs about one round trip per `depth` requests instead of one per request. If the server closes
+    /// the connection mid-pipeline, the requests it did not answer are replayed on a fresh connection.
+    /// Requests that are not idempotent (POST) are only sent on an otherwise idle connection, so like
+    /// sendRequest() they are only retried when a reused connection turns out to be closed. Different
+    /// origins are fetched in parallel; an origin that negotiates HTTP/2 gets multiplexed streams
+    /// instead. Bodies are kept in the results; output files and redirects are ignored.
+    /// @param requests The requests to send.
+    /// @param depth Maximum number of requests awaiting a response on a connection.
+    /// @param maxOrigins Maximum number of origins fetched at once.
+    /// @return One result per request, in the same order as `requests`.
+    std::vector<FetchResult> fetchPipelined(const std::vector<HttpRequest>& requests, size_t depth,
+                                            size_t maxOrigins = 16);
+
+    /// @brief Gives access to the keep-alive pool, e.g. to tune idle timeout and per-host limits.
+    ConnectionPool& connectionPool() { return pool; }
 
 private:
+    friend class AsyncHttpClient; ///< Runs transfers with this client's TLS context, resolver and timeouts.
+
     SSL_CTX* ctx; ///< SSL context used for establishing secure connections.
+    std::unique_ptr<TlsSessionCache> sessionCache; ///< TLS sessions offered for resumption, per origin.
+    ConnectionPool pool; ///< Idle keep-alive connections reused across requests.
+    Resolver resolver;   ///< Host name lookups, cached across requests.
+    std::chrono::milliseconds connectTimeout = std::chrono::seconds(30); ///< Limit for establishing a connection.
+    bool spliceDownloads = false; ///< Move plain HTTP download bodies with splice(2).
+    bool uringDownloads = false;  ///< Receive plain HTTP download bodies with io_uring.
+    size_t downloadSegments = 1;  ///< Number of parallel byte ranges per download.
+    bool resumeDownloads = false; ///< Continue partial output files instead of starting over.
+    bool followRedirects = false; ///< Follow redirect responses to their Location.
+    int redirectLimit = maxRedirects; ///< Redirects a request may follow.
+    std::unique_ptr<HttpCache> cache; ///< Response cache, or null if caching is off.
 
     /// @brief Initializes SSL and sets up the SSL context.
     void initSSL();
@@ -91,27 +287,105 @@ private:
     void cleanSSL();
 
     /// @brief Creates an SSL connection over an existing socket.
+    /// A cached session for the origin is offered, so the handshake may be abbreviated.
     /// @param socket The socket file descriptor connected to the server.
     /// @param hostname The hostname of the server for SSL validation.
+    /// @param origin The origin key used to look up and store TLS sessions.
     /// @return A pointer to an SSL object representing the secure connection.
-    SSL* createSSLConnection(int socket, const std::string& hostname);
+    SSL* createSSLConnection(int socket, const std::string& hostname, const std::string& origin);
 
-    /// @brief Verifies the server's SSL certificate against the provided hostname.
+    /// @brief Verifies the server's SSL certificate, including the hostname set before the handshake.
     /// @param ssl The SSL object representing the established connection.
-    /// @param hostname The server's hostname for verification purposes.
     /// @return True if the certificate is verified successfully, false otherwise.
-    bool verifySSLCert(SSL* ssl, const std::string& hostname);
+    bool verifySSLCert(SSL* ssl);
 
     /// @brief Creates a socket and connects it to the specified server and port.
+    /// The name goes through the resolver cache and all of its IPv6 and IPv4 addresses are raced
+    /// with Happy Eyeballs, bounded by the connect timeout.
     /// @param hostname The server's hostname.
     /// @param port The port to connect to (usually 80 for HTTP or 443 for HTTPS).
+    /// @param timing Receives the name lookup and connect times.
     /// @return The socket file descriptor if the connection is successful.
     /// @throws std::runtime_error if the connection fails.
-    static int createSocket(const std::string& hostname, uint16_t port);
+    int createSocket(const std::string& hostname, uint16_t port, TransferTiming& timing);
 
     /// @brief Handles SSL errors during secure communication.
     /// @param ssl The SSL object representing the secure connection.
     /// @param result The result code from the SSL operation.
     /// @throws std::runtime_error if an SSL error occurs.
     static void handleSSLError(SSL* ssl, int result);
+
+    /// @brief Returns a pooled connection to the URL's origin, or opens a new one.
+    /// @param url The parsed URL whose protocol, host and port identify the origin.
+    /// @param timing Receives the lookup, connect and TLS handshake times.
+    /// @return A connected (and, for HTTPS, TLS-established) connection.
+    std::unique_ptr<Connection> openConnection(const ParsedUrl& url, TransferTiming& timing);
+
+    /// @brief Writes the whole request to the connection: with sendmsg over plain TCP, as one or two
+    /// TLS writes otherwise.
+    /// @throws std::runtime_error if the connection fails.
+    static void sendAll(Connection& conn, const SerializedRequest& request);
+
+    /// @brief Writes raw bytes to the connection, over TLS if it has a session.
+    /// @throws std::runtime_error if the connection fails.
+    static void sendRaw(Connection& conn, const std::string& data);
+
+    /// @brief Runs fetchEach(), optionally starting with an established HTTP/2 connection that the
+    /// event loop's multiplexer adopts, so requests to its origin become streams on it.
+    void fetchEachWith(const RequestSource& next, const ResultHandler& onResult, size_t maxConcurrent,
+                       bool keepBodies, std::unique_ptr<Connection> http2Connection);
+
+    /// @brief Runs the pipelined requests of one origin for fetchPipelined().
+    /// @param requests All requests of the fetch.
+    /// @param order Indices of this origin's requests, in the order they are sent.
+    /// @param depth Maximum number of requests awaiting a response.
+    /// @param results Receives the result of each of the origin's requests.
+    void pipelineOrigin(const std::vector<HttpRequest>& requests, const std::vector<size_t>& order, size_t depth,
+                        std::vector<FetchResult>& results);
+
+    /// @brief Writes the frames an HTTP/2 session has queued.
+    /// @throws std::runtime_error if the connection fails.
+    static void flushHttp2(Connection& conn);
+
+    /// @brief Reads up to `size` bytes from the connection.
+    /// @return The number of bytes read, or 0 once the peer has closed the connection.
+    /// @throws std::runtime_error if the read fails, e.g. because the connection was reset.
+    static int readSome(Connection& conn, char* buffer, size_t size);
+
+    /// @brief Downloads a file as parallel byte ranges written in place with pwrite.
+    /// @param request The download request.
+    /// @param verbose Flag to print progress information.
+    /// @param result Receives the probe's headers, with the timing and byte count of the whole download.
+    /// @return False if the server cannot serve ranges and a single stream must be used instead.
+    bool downloadSegmented(const HttpRequest& request, bool verbose, HttpResponse& result);
+
+    /// @brief Sends a request on a (possibly reused) connection and reads one complete response.
+    /// Body bytes are handed to `onBody` as they are read. The connection is returned to the pool
+    /// when the response is framed and neither side asked to close it.
+    /// @param request The HTTP request to send.
+    /// @param verbose Flag to print the request and response headers.
+    /// @param response Receives the status line, headers, body byte count and timing.
+    /// @param onBody Called with each piece of the decoded response body.
+    /// @param onHeaders Optional hook called once the headers are parsed. It may take over reading the
+    /// rest of the body from the connection, keeping the parser informed, and returns true if it did.
+    /// It is not called on HTTP/2 connections, whose body arrives in frames.
+    void performRequest(const HttpRequest& request, bool verbose, HttpResponse& response, const BodySink& onBody,
+                        const std::function<bool(Connection&, HttpResponseParser&)>& onHeaders = nullptr);
+
+    /// @brief Like performRequest(), but when redirects are followed it repeats the request for each
+    /// redirect until the final response. Only the final response's body reaches `onBody` and `onHeaders`.
+    void performFollowing(const HttpRequest& request, bool verbose, HttpResponse& response, const BodySink& onBody,
+                          const std::function<bool(Connection&, HttpResponseParser&)>& onHeaders = nullptr);
+
+    /// @brief Returns true if `response` is a redirect that will be followed.
+    bool willFollow(const HttpResponse& response) const;
+
+    /// @brief Builds the request that follows a redirect.
+    /// @param request The request that got the redirect.
+    /// @param response The redirect response.
+    /// @param redirects The number of redirects already followed.
+    /// @param next Receives the follow-up request.
+    /// @return False if the response is not a redirect to follow, so it is the final response.
+    /// @throws std::runtime_error if the Location is invalid or the redirect limit is reached.
+    bool nextRedirect(const HttpRequest& request, const HttpResponse& response, int redirects, HttpRequest& next) const;
 };
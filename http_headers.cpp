@@ -0,0 +1,119 @@
+//http_headers.cpp
+
+#include "http_headers.h"
+#include <cstdint>
+#include <stdexcept>
+#include <strings.h>
+
+namespace {
+
+/// @brief Names of the known headers, in KnownHeader order.
+const std::string_view knownNames[] = {
+    "Content-Length", "Transfer-Encoding", "Content-Encoding", "Content-Range", "Content-Type", "Connection",
+    "Location", "ETag", "Last-Modified", "Accept-Ranges", "Cache-Control", "Expires", "Date", "Age", "Vary",
+};
+static_assert(sizeof(knownNames) / sizeof(knownNames[0]) == static_cast<size_t>(KnownHeader::Other),
+              "every KnownHeader needs a name");
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return std::string_view();
+    }
+    size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+}
+
+/// @brief Parses a non-negative decimal number, or returns -1.
+int64_t parseLength(std::string_view text) {
+    if (text.empty() || text.size() > 18) {
+        return -1;
+    }
+    int64_t value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+} // namespace
+
+KnownHeader HttpHeaders::classify(std::string_view name) {
+    for (size_t i = 0; i < static_cast<size_t>(KnownHeader::Other); ++i) {
+        if (equalsIgnoreCase(name, knownNames[i])) {
+            return static_cast<KnownHeader>(i);
+        }
+    }
+    return KnownHeader::Other;
+}
+
+KnownHeader HttpHeaders::add(std::string_view name, std::string_view value) {
+    value = trim(value);
+    if (block.size() + name.size() + value.size() + 4 > UINT32_MAX) {
+        throw std::runtime_error("Response headers too large");
+    }
+    Entry entry;
+    entry.nameOffset = static_cast<uint32_t>(block.size());
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    block.append(name.data(), name.size());
+    block += ": ";
+    entry.valueOffset = static_cast<uint32_t>(block.size());
+    entry.valueLength = static_cast<uint32_t>(value.size());
+    block.append(value.data(), value.size());
+    block += "\r\n";
+
+    KnownHeader known = classify(name);
+    if (known != KnownHeader::Other && index[static_cast<size_t>(known)] < 0) {
+        index[static_cast<size_t>(known)] = static_cast<int32_t>(fields.size());
+        if (known == KnownHeader::ContentLength) {
+            length = parseLength(value);
+        }
+    }
+    fields.push_back(entry);
+    return known;
+}
+
+bool HttpHeaders::addLine(std::string_view line) {
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) {
+        return false;
+    }
+    add(line.substr(0, colon), line.substr(colon + 1));
+    return true;
+}
+
+void HttpHeaders::clear() {
+    block.clear();
+    fields.clear();
+    index.fill(-1);
+    length = -1;
+}
+
+int64_t HttpHeaders::find(std::string_view name) const {
+    KnownHeader known = classify(name);
+    if (known != KnownHeader::Other) {
+        return index[static_cast<size_t>(known)];
+    }
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (equalsIgnoreCase((*this)[i].name, name)) {
+            return static_cast<int64_t>(i);
+        }
+    }
+    return -1;
+}
+
+std::string_view HttpHeaders::get(std::string_view name) const {
+    int64_t i = find(name);
+    return i < 0 ? std::string_view() : (*this)[static_cast<size_t>(i)].value;
+}
+
+bool HttpHeaders::contains(std::string_view name) const {
+    return find(name) >= 0;
+}
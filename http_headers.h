@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Header fields with a fixed slot in HttpHeaders' index, looked up without scanning.
+enum class KnownHeader : uint8_t {
+    ContentLength,
+    TransferEncoding,
+    ContentEncoding,
+    ContentRange,
+    ContentType,
+    Connection,
+    Location,
+    ETag,
+    LastModified,
+    AcceptRanges,
+    CacheControl,
+    Expires,
+    Date,
+    Age,
+    Vary,
+    Other ///< Not a known header; also the number of known ones.
+};
+
+/// @brief The header (or trailer) fields of a response, stored in a single buffer.
+/// Fields are appended to one contiguous block of "Name: value\r\n" lines and exposed as string_view
+/// pairs into it, so a response costs one growing allocation instead of one string per line. The
+/// first occurrence of each KnownHeader is indexed for O(1) lookup; other names are found with a
+/// case-insensitive scan. Views stay valid until the next add() or clear().
+class HttpHeaders {
+public:
+    /// @brief A field as views into the header block.
+    struct Field {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    /// @brief Iterates over the fields in the order they were received.
+    class const_iterator {
+    public:
+        const_iterator(const HttpHeaders& headers, size_t index) : headers(&headers), index(index) {}
+        Field operator*() const { return (*headers)[index]; }
+        const_iterator& operator++() { ++index; return *this; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const HttpHeaders* headers;
+        size_t index;
+    };
+
+    HttpHeaders() { index.fill(-1); }
+
+    /// @brief Appends a field. Surrounding whitespace is removed from the value.
+    /// @return Which known header the name is, or KnownHeader::Other.
+    /// @throws std::runtime_error if the block would exceed 4 GiB.
+    KnownHeader add(std::string_view name, std::string_view value);
+
+    /// @brief Appends a field from a "Name: value" line.
+    /// @return False (and nothing is added) if the line has no colon or an empty name.
+    bool addLine(std::string_view line);
+
+    /// @brief Removes all fields.
+    void clear();
+
+    size_t size() const { return fields.size(); }
+    bool empty() const { return fields.empty(); }
+
+    /// @brief Returns field number `i` (in receive order).
+    Field operator[](size_t i) const {
+        const Entry& entry = fields[i];
+        return {std::string_view(block.data() + entry.nameOffset, entry.nameLength),
+                std::string_view(block.data() + entry.valueOffset, entry.valueLength)};
+    }
+
+    const_iterator begin() const { return const_iterator(*this, 0); }
+    const_iterator end() const { return const_iterator(*this, fields.size()); }
+
+    /// @brief Returns the value of the first field with a known name, or an empty view if absent.
+    std::string_view get(KnownHeader header) const {
+        int32_t i = index[static_cast<size_t>(header)];
+        return i < 0 ? std::string_view() : (*this)[static_cast<size_t>(i)].value;
+    }
+
+    /// @brief Case-insensitively returns the value of the first field called `name`, or an empty view.
+    std::string_view get(std::string_view name) const;
+
+    /// @brief Returns true if a field called `name` is present (its value may be empty).
+    bool contains(std::string_view name) const;
+
+    /// @brief Returns the Content-Length as a number, or -1 if it is absent or not a valid number.
+    int64_t contentLength() const { return length; }
+
+    /// @brief Returns all fields as "Name: value\r\n" lines.
+    const std::string& raw() const { return block; }
+
+    /// @brief Classifies a header name.
+    static KnownHeader classify(std::string_view name);
+
+private:
+    struct Entry {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+    };
+
+    std::string block;                 ///< Every field as "Name: value\r\n".
+    std::vector<Entry> fields;         ///< Offsets of each field in `block`.
+    std::array<int32_t, static_cast<size_t>(KnownHeader::Other)> index; ///< First field of each known name, -1 if none.
+    int64_t length = -1;               ///< Parsed Content-Length.
+
+    /// @brief Finds the first field called `name`, or returns -1.
+    int64_t find(std::string_view name) const;
+};
@@ -0,0 +1,37 @@
+//io_util.cpp
+
+#include "io_util.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+void writeAll(int fd, const char* data, size_t length, const char* what) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to write " + std::string(what) + ": " + strerror(errno));
+        }
+        data += n;
+        length -= n;
+    }
+}
+
+void pwriteAll(int fd, const char* data, size_t length, uint64_t offset, const char* what) {
+    while (length > 0) {
+        ssize_t n = pwrite(fd, data, length, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to write " + std::string(what) + ": " + strerror(errno));
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Writes a whole buffer to a file descriptor, retrying short writes and EINTR.
+/// @param what Names the destination in the error message, e.g. "output file".
+/// @throws std::runtime_error if the write fails.
+void writeAll(int fd, const char* data, size_t length, const char* what = "output file");
+
+/// @brief Writes a whole buffer to a file descriptor at the given offset, like writeAll().
+/// @throws std::runtime_error if the write fails.
+void pwriteAll(int fd, const char* data, size_t length, uint64_t offset, const char* what = "output file");
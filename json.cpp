@@ -0,0 +1,274 @@
+//json.cpp
+
+#include "json.h"
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+/// @brief Nesting limit, so hostile input cannot exhaust the stack.
+const int maxDepth = 64;
+
+/// @brief Recursive descent parser over one JSON document.
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : text(text) {}
+
+    JsonValue parseDocument() {
+        JsonValue value = parseValue(0);
+        skipWhitespace();
+        if (pos != text.size()) {
+            fail("unexpected trailing characters");
+        }
+        return value;
+    }
+
+private:
+    const std::string& text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("Invalid JSON at offset " + std::to_string(pos) + ": " + what);
+    }
+
+    void skipWhitespace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+            ++pos;
+        }
+    }
+
+    void expectLiteral(const char* literal) {
+        for (const char* c = literal; *c; ++c, ++pos) {
+            if (pos >= text.size() || text[pos] != *c) {
+                fail("invalid literal");
+            }
+        }
+    }
+
+    JsonValue parseValue(int depth) {
+        if (depth > maxDepth) {
+            fail("nested too deeply");
+        }
+        skipWhitespace();
+        if (pos >= text.size()) {
+            fail("unexpected end of input");
+        }
+        JsonValue value;
+        switch (text[pos]) {
+            case '{': parseObject(value, depth); break;
+            case '[': parseArray(value, depth); break;
+            case '"':
+                value.type = JsonValue::Type::String;
+                value.text = parseString();
+                break;
+            case 't': expectLiteral("true");  value.type = JsonValue::Type::Bool; value.boolean = true; break;
+            case 'f': expectLiteral("false"); value.type = JsonValue::Type::Bool; break;
+            case 'n': expectLiteral("null"); break;
+            default: parseNumber(value); break;
+        }
+        return value;
+    }
+
+    void parseObject(JsonValue& value, int depth) {
+        value.type = JsonValue::Type::Object;
+        ++pos;
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == '}') {
+            ++pos;
+            return;
+        }
+        while (true) {
+            skipWhitespace();
+            if (pos >= text.size() || text[pos] != '"') {
+                fail("expected a member name");
+            }
+            std::string name = parseString();
+            skipWhitespace();
+            if (pos >= text.size() || text[pos] != ':') {
+                fail("expected ':'");
+            }
+            ++pos;
+            value.fields[name] = parseValue(depth + 1);
+            skipWhitespace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+            } else if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return;
+            } else {
+                fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    void parseArray(JsonValue& value, int depth) {
+        value.type = JsonValue::Type::Array;
+        ++pos;
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == ']') {
+            ++pos;
+            return;
+        }
+        while (true) {
+            value.items.push_back(parseValue(depth + 1));
+            skipWhitespace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+            } else if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return;
+            } else {
+                fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    void parseNumber(JsonValue& value) {
+        size_t start = pos;
+        if (pos < text.size() && text[pos] == '-') ++pos;
+        auto digits = [this] {
+            size_t first = pos;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') ++pos;
+            return pos > first;
+        };
+        size_t integer = pos;
+        if (!digits()) fail("invalid value");
+        if (text[integer] == '0' && pos - integer > 1) fail("leading zero in number");
+        if (pos < text.size() && text[pos] == '.') {
+            ++pos;
+            if (!digits()) fail("invalid number");
+        }
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            ++pos;
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) ++pos;
+            if (!digits()) fail("invalid number");
+        }
+        value.type = JsonValue::Type::Number;
+        value.text = text.substr(start, pos - start);
+        value.number = std::strtod(value.text.c_str(), nullptr);
+    }
+
+    unsigned parseHex4() {
+        if (pos + 4 > text.size()) {
+            fail("truncated \\u escape");
+        }
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = text[pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else fail("invalid \\u escape");
+        }
+        return code;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+
+    std::string parseString() {
+        ++pos; // Opening quote
+        std::string out;
+        while (true) {
+            if (pos >= text.size()) {
+                fail("unterminated string");
+            }
+            char c = text[pos++];
+            if (c == '"') {
+                return out;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                fail("control character in string");
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos >= text.size()) {
+                fail("unterminated string");
+            }
+            switch (text[pos++]) {
+                case '"':  out.push_back('"');  break;
+                case '\\': out.push_back('\\'); break;
+                case '/':  out.push_back('/');  break;
+                case 'b':  out.push_back('\b'); break;
+                case 'f':  out.push_back('\f'); break;
+                case 'n':  out.push_back('\n'); break;
+                case 'r':  out.push_back('\r'); break;
+                case 't':  out.push_back('\t'); break;
+                case 'u': {
+                    unsigned code = parseHex4();
+                    if (code >= 0xD800 && code < 0xDC00 && pos + 6 <= text.size() &&
+                        text[pos] == '\\' && text[pos + 1] == 'u') {
+                        pos += 2;
+                        unsigned low = parseHex4();
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            fail("invalid surrogate pair");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+            }
+        }
+    }
+};
+
+} // namespace
+
+const JsonValue* JsonValue::find(const std::string& name) const {
+    if (type != Type::Object) {
+        return nullptr;
+    }
+    auto it = fields.find(name);
+    return it == fields.end() ? nullptr : &it->second;
+}
+
+JsonValue parseJson(const std::string& text) {
+    return JsonReader(text).parseDocument();
+}
+
+std::string jsonQuote(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    out.push_back('"');
+    for (char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[7];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out += escaped;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+    return out;
+}
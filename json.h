@@ -0,0 +1,28 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+/// @brief A parsed JSON value, just enough for reading request specs and writing result lines.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;                   ///< Value of a Bool.
+    double number = 0;                      ///< Value of a Number.
+    std::string text;                       ///< Value of a String, or the literal text of a Number.
+    std::vector<JsonValue> items;           ///< Elements of an Array.
+    std::map<std::string, JsonValue> fields; ///< Members of an Object (later duplicates win).
+
+    /// @brief Returns the member with the given name, or nullptr if this is not an object or lacks it.
+    const JsonValue* find(const std::string& name) const;
+};
+
+/// @brief Parses one complete JSON document.
+/// @param text The JSON text; surrounding whitespace is allowed, trailing content is not.
+/// @return The parsed value.
+/// @throws std::runtime_error on malformed JSON.
+JsonValue parseJson(const std::string& text);
+
+/// @brief Quotes and escapes a string as a JSON string literal.
+std::string jsonQuote(const std::string& text);
@@ -0,0 +1,71 @@
+//latency_histogram.cpp
+
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// @brief log2 of half the number of linear sub-buckets per power-of-two bucket.
+const int subBucketHalfCountMagnitude = 10;
+const uint64_t subBucketHalfCount = uint64_t(1) << subBucketHalfCountMagnitude;
+const uint64_t subBucketMask = (subBucketHalfCount << 1) - 1;
+
+/// @brief Number of power-of-two buckets; the largest trackable value is 2^(bucketCount + 10) - 1.
+const int bucketCount = 26;
+const uint64_t highestTrackableValue = (uint64_t(1) << (bucketCount + subBucketHalfCountMagnitude)) - 1;
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() : counts((bucketCount + 1) * subBucketHalfCount, 0) {}
+
+size_t LatencyHistogram::indexFor(uint64_t value) {
+    int bucket = 63 - __builtin_clzll(value | subBucketMask) - subBucketHalfCountMagnitude;
+    uint64_t subBucket = value >> bucket;
+    return (static_cast<size_t>(bucket + 1) << subBucketHalfCountMagnitude) + (subBucket - subBucketHalfCount);
+}
+
+uint64_t LatencyHistogram::highestValueAt(size_t index) {
+    int bucket = static_cast<int>(index >> subBucketHalfCountMagnitude) - 1;
+    uint64_t subBucket = (index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucket < 0) {
+        subBucket -= subBucketHalfCount;
+        bucket = 0;
+    }
+    return (subBucket << bucket) + ((uint64_t(1) << bucket) - 1);
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    micros = std::min(micros, highestTrackableValue);
+    ++counts[indexFor(micros)];
+    ++total;
+    sum += micros;
+    minValue = std::min(minValue, micros);
+    maxValue = std::max(maxValue, micros);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * total)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(highestValueAt(i), maxValue);
+        }
+    }
+    return maxValue;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief HDR-style histogram of latencies in microseconds.
+/// Values are counted in log-linear buckets: every power-of-two range is split into 1024 linear
+/// sub-buckets, so any recorded value is reproduced to within 0.1% (three significant digits) while
+/// memory stays fixed regardless of the number of samples. Values above the trackable maximum
+/// (about 19 hours) are clamped to it. Not thread-safe.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    /// @brief Counts one sample.
+    void record(uint64_t micros);
+
+    /// @brief Adds all samples of another histogram.
+    void merge(const LatencyHistogram& other);
+
+    /// @brief Returns the value at or below which `percentile` percent of the samples fall.
+    /// @param percentile A value in [0, 100].
+    /// @return The highest value equivalent to the bucket holding that sample, 0 if empty.
+    uint64_t valueAtPercentile(double percentile) const;
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+
+    /// @brief Returns the mean of the recorded values (exact, not bucketed).
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t minValue = UINT64_MAX;
+    uint64_t maxValue = 0;
+    uint64_t sum = 0;
+
+    static size_t indexFor(uint64_t value);
+
+    /// @brief Returns the largest value that maps to the same bucket as `index`.
+    static uint64_t highestValueAt(size_t index);
+};
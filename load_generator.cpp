@@ -0,0 +1,144 @@
+//load_generator.cpp
+
+#include "load_generator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief Formats a microsecond value as milliseconds.
+std::string millis(uint64_t micros) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f", micros / 1000.0);
+    return text;
+}
+
+/// @brief Formats a byte rate with a binary unit.
+std::string byteRate(double bytesPerSecond) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB"};
+    int unit = 0;
+    while (bytesPerSecond >= 1024 && unit < 3) {
+        bytesPerSecond /= 1024;
+        ++unit;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f %s/s", bytesPerSecond, units[unit]);
+    return text;
+}
+
+} // namespace
+
+LoadGenerator::LoadGenerator(HttpClient& client, const HttpRequest& request, const LoadOptions& options)
+    : client(client), request(request), options(options) {
+    if (this->options.totalRequests == 0 && this->options.duration.count() == 0) {
+        throw std::runtime_error("A load run needs a request count or a duration");
+    }
+    this->options.concurrency = std::max<size_t>(this->options.concurrency, 1);
+    if (this->options.totalRequests > 0) {
+        this->options.concurrency = std::min<uint64_t>(this->options.concurrency, this->options.totalRequests);
+    }
+    this->request.outputFile.clear();
+}
+
+LoadReport LoadGenerator::run() {
+    LoadReport report;
+    report.openLoop = options.rate > 0;
+    // Otherwise connections beyond the pool's per-host limit would be closed after every request.
+    client.connectionPool().setMaxIdlePerHost(std::max<size_t>(options.concurrency, 6));
+
+    std::mutex mutex; // Guards report
+    std::atomic<uint64_t> nextIndex{0};
+    const Clock::time_point start = Clock::now();
+    const bool hasDeadline = options.duration.count() > 0;
+    const Clock::time_point deadline = start + options.duration;
+
+    auto worker = [&] {
+        while (true) {
+            uint64_t index = nextIndex++;
+            if (options.totalRequests > 0 && index >= options.totalRequests) {
+                return;
+            }
+            Clock::time_point scheduled = Clock::now();
+            if (report.openLoop) {
+                scheduled = start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(index / options.rate));
+                std::this_thread::sleep_until(scheduled);
+            }
+            if (hasDeadline && scheduled >= deadline) {
+                return;
+            }
+
+            std::string error;
+            HttpResponse response;
+            try {
+                // Only the size of the body matters here, so it is dropped as it arrives.
+                response = client.sendRequest(request, false, [](const char*, size_t) {});
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - scheduled).count();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error.empty()) {
+                ++report.requests;
+                ++report.statusCodes[response.statusCode];
+                report.bodyBytes += response.bodyBytes;
+                report.latency.record(latency);
+            } else {
+                ++report.errors;
+                ++report.errorMessages[error];
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(options.concurrency);
+    for (size_t i = 0; i < options.concurrency; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    return report;
+}
+
+void LoadGenerator::printReport(const LoadReport& report, std::ostream& out) {
+    double seconds = std::max(report.elapsed.count() / 1e6, 1e-9);
+    char rate[32];
+    snprintf(rate, sizeof(rate), "%.2f", report.requests / seconds);
+
+    out << "Summary:" << std::endl;
+    out << "  Requests:      " << report.requests << " completed, " << report.errors << " failed" << std::endl;
+    out << "  Duration:      " << millis(report.elapsed.count()) << " ms" << std::endl;
+    out << "  Requests/sec:  " << rate << std::endl;
+    out << "  Transfer/sec:  " << byteRate(report.bodyBytes / seconds) << " (body)" << std::endl;
+
+    const LatencyHistogram& latency = report.latency;
+    out << "Latency (ms)" << (report.openLoop ? ", from scheduled start:" : ":") << std::endl;
+    out << "  min " << millis(latency.min()) << "  mean " << millis(static_cast<uint64_t>(latency.mean()))
+        << "  max " << millis(latency.max()) << std::endl;
+    out << "  p50 " << millis(latency.valueAtPercentile(50)) << "  p90 " << millis(latency.valueAtPercentile(90))
+        << "  p99 " << millis(latency.valueAtPercentile(99)) << "  p99.9 " << millis(latency.valueAtPercentile(99.9))
+        << std::endl;
+
+    if (!report.statusCodes.empty()) {
+        out << "Status codes:" << std::endl;
+        for (const auto& status : report.statusCodes) {
+            out << "  " << status.first << ": " << status.second << std::endl;
+        }
+    }
+    if (!report.errorMessages.empty()) {
+        out << "Errors:" << std::endl;
+        for (const auto& error : report.errorMessages) {
+            out << "  " << error.first << ": " << error.second << std::endl;
+        }
+    }
+}
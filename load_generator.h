@@ -0,0 +1,53 @@
+#pragma once
+#include "http_client.h"
+#include "latency_histogram.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+/// @brief How a load run is shaped.
+struct LoadOptions {
+    uint64_t totalRequests = 0;              ///< Stop after this many requests; 0 for no limit.
+    size_t concurrency = 10;                 ///< Number of requests in flight at once (one connection each).
+    std::chrono::milliseconds duration{0};   ///< Stop scheduling requests after this long; 0 for no limit.
+    double rate = 0;                         ///< Requests per second to schedule (open loop); 0 to send back to back.
+};
+
+/// @brief Aggregated outcome of a load run.
+struct LoadReport {
+    LatencyHistogram latency;                ///< Latency of completed requests, in microseconds.
+    uint64_t requests = 0;                   ///< Requests that produced a response.
+    uint64_t errors = 0;                     ///< Requests that failed without a response.
+    uint64_t bodyBytes = 0;                  ///< Response body bytes received.
+    std::chrono::microseconds elapsed{0};    ///< Wall time of the run.
+    std::map<int, uint64_t> statusCodes;     ///< Responses by status code.
+    std::map<std::string, uint64_t> errorMessages; ///< Failures by error message.
+    bool openLoop = false;                   ///< Latencies were measured from the scheduled start times.
+};
+
+/// @brief Sends one request repeatedly, measuring latency and throughput.
+/// Requests run on `concurrency` threads through HttpClient::sendRequest(), so every thread keeps its
+/// own persistent connection from the client's pool. With a rate, request i is scheduled at
+/// start + i / rate and its latency is measured from that time rather than from when a thread got
+/// around to sending it, so a stalled server shows up in the tail instead of silently lowering the
+/// request rate (coordinated omission).
+class LoadGenerator {
+public:
+    /// @param client The client to send with; its pool is resized to hold one connection per thread.
+    /// @param request The request sent on every iteration; its body is kept in memory, not in a file.
+    /// @param options The shape of the run.
+    LoadGenerator(HttpClient& client, const HttpRequest& request, const LoadOptions& options);
+
+    /// @brief Runs the load until the request count or duration is reached.
+    LoadReport run();
+
+    /// @brief Prints a human-readable summary of a report.
+    static void printReport(const LoadReport& report, std::ostream& out);
+
+private:
+    HttpClient& client;
+    HttpRequest request;
+    LoadOptions options;
+};
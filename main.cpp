@@ -1,9 +1,24 @@
 #include <iostream>
 #include "url_parser.h"
 #include "http_client.h"
+#include "batch_runner.h"
+#include "load_generator.h"
+#include "write_out.h"
+#include "request_serializer.h"
+#include "content_decoder.h"
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <stdexcept>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <strings.h>
 
 /// @brief Converts a given HTTP method string to an HttpMethod enum.
 /// @param methodStr The string representation of the HTTP method.
@@ -20,6 +35,52 @@ HttpMethod parseMethod(const std::string& methodStr) {
     throw std::runtime_error("Invalid HTTP method: " + methodStr);
 }
 
+/// @brief Returns true if the user supplied a header, whatever the case of its name.
+/// @param headers The command-line headers.
+/// @param name The header name, e.g. "Accept".
+bool hasHeader(const std::map<std::string, std::string>& headers, const char* name) {
+    return std::any_of(headers.begin(), headers.end(),
+                       [name](const auto& header) { return strcasecmp(header.first.c_str(), name) == 0; });
+}
+
+/// @brief Converts a duration such as "30", "30s", "500ms" or "2m" to milliseconds; plain numbers are seconds.
+/// @param text The duration string.
+/// @return The duration.
+/// @throws runtime_error if the duration is malformed or not positive.
+std::chrono::milliseconds parseDuration(const std::string& text) {
+    size_t consumed = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &consumed);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid duration: " + text);
+    }
+    std::string unit = text.substr(consumed);
+    double scale = unit.empty() || unit == "s" ? 1000 : unit == "ms" ? 1 : unit == "m" ? 60000 : unit == "h" ? 3600000 : -1;
+    if (scale < 0 || value <= 0) {
+        throw std::runtime_error("Invalid duration: " + text);
+    }
+    return std::chrono::milliseconds(static_cast<long long>(value * scale));
+}
+
+/// @brief Converts a positive whole number of MiB, such as "512", to bytes.
+/// @param text The size argument; nothing but decimal digits is accepted.
+/// @param bytes Receives the size in bytes.
+/// @return False if the size is malformed, zero, or too large to count in bytes.
+bool parseMebibytes(const char* text, uint64_t& bytes) {
+    if (!isdigit(static_cast<unsigned char>(text[0]))) {
+        return false; // strtoull would accept leading whitespace and wrap a negative number around.
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0 || value > (UINT64_MAX >> 20)) {
+        return false;
+    }
+    bytes = static_cast<uint64_t>(value) << 20;
+    return true;
+}
+
 /// @brief Main function to handle command-line input and perform HTTP requests.
 /// @param argc The count of command-line arguments.
 /// @param argv The command-line arguments array.
@@ -27,25 +88,60 @@ HttpMethod parseMethod(const std::string& methodStr) {
 int main(int argc, char *argv[]) {
     // Check for help option
     if (argc == 2 && strcmp(argv[1], "-h") == 0) {
-        std::cout << "Usage: " << argv[0] << " [-v] [-X <method>] [-H <header>] [-d <data>] [-o <output_file>] [-L] <URL>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " [-v] [-X <method>] [-H <header>] [-d <data>] [-o <output_file>] [-L] [-C -] [--splice] [--io-uring] [--segments <n>] [--tls-session-file <file>] [--cache-dir <dir>] [--cache-max-size <MiB>] [--url-file <file>] [--parallel-max <n>] [--pipeline <n>] [--connect-timeout <s>] [--http1.1] [--compressed] [--batch <file>] [-n <requests>] [-c <concurrency>] [-z <duration>] [--rate <r>] [-w <format>] <URL>..." << std::endl;
         std::cout << "Options:" << std::endl;
         std::cout << "  -v                : Verbose output (shows request and response details)" << std::endl;
-        std::cout << "  -X <method>       : Specify HTTP method to use (GET, POST, PUT, DELETE)" << std::endl;
+        std::cout << "  -X <method>       : Specify HTTP method to use (GET, POST, PUT, DELETE, HEAD)" << std::endl;
         std::cout << "  -H <header>       : Specify a custom header (format: 'Key: Value')" << std::endl;
         std::cout << "  -d <data>         : Send data in the request body (for POST/PUT requests)" << std::endl;
         std::cout << "  -o <output_file>  : Write response to the specified output file" << std::endl;
         std::cout << "  -L                : Follow redirects" << std::endl;
-        std::cout << "  <URL>             : The URL to send the request to" << std::endl;
+        std::cout << "  -C -              : With -o, resume a previously interrupted download" << std::endl;
+        std::cout << "  --splice          : With -o, move the body to the file with zero-copy splice() (HTTPS needs kernel TLS)" << std::endl;
+        std::cout << "  --io-uring        : With -o on plain HTTP, receive the body into the file with io_uring when the kernel supports it" << std::endl;
+        std::cout << "  --segments <n>    : With -o, download in up to n parallel byte ranges when the server supports it" << std::endl;
+        std::cout << "  --tls-session-file <file> : Keep TLS sessions in a file so later runs can resume them" << std::endl;
+        std::cout << "  --cache-dir <dir> : Cache GET responses in a directory and revalidate them when stale" << std::endl;
+        std::cout << "  --cache-max-size <MiB> : Evict the least recently used cache entries beyond this size (default 1024)" << std::endl;
+        std::cout << "  --url-file <file> : Read additional URLs from a file, one per line" << std::endl;
+        std::cout << "  --parallel-max <n>: Maximum number of concurrent transfers with several URLs (default 256)" << std::endl;
+        std::cout << "  --pipeline <n>    : With several URLs, pipeline up to n HTTP/1.1 requests per connection instead of fetching concurrently" << std::endl;
+        std::cout << "  --connect-timeout <s>: Maximum time in seconds to establish a connection (default 30)" << std::endl;
+        std::cout << "  --http1.1         : Do not offer HTTP/2 on TLS connections" << std::endl;
+        std::cout << "  --compressed      : Request a compressed response and decode it" << std::endl;
+        std::cout << "  --batch <file>    : Run the JSONL request specs in file ('-' for stdin) and print one JSON result per line" << std::endl;
+        std::cout << "  -n <requests>     : Load mode: send the request this many times and report latency percentiles" << std::endl;
+        std::cout << "  -c <concurrency>  : Load mode: number of requests in flight, one persistent connection each (default 10)" << std::endl;
+        std::cout << "  -z <duration>     : Load mode: keep sending for this long, e.g. 30s, 500ms, 2m" << std::endl;
+        std::cout << "  --rate <r>        : Load mode: schedule r requests per second (open loop) instead of back to back" << std::endl;
+        std::cout << "  -w <format>       : Print timing and transfer details after each response, e.g. '%{time_total}\\n' or '%{json}' (@file reads the format from a file)" << std::endl;
+        std::cout << "  <URL>...          : The URL(s) to send the request to; several URLs are fetched concurrently" << std::endl;
         return 0;
     }
 
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " [-v] [-X <method>] [-H <header>] [-d <data>] [-o <output_file>] [-L] <URL>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [-v] [-X <method>] [-H <header>] [-d <data>] [-o <output_file>] [-L] [-C -] [--splice] [--io-uring] [--segments <n>] [--tls-session-file <file>] [--cache-dir <dir>] [--cache-max-size <MiB>] [--url-file <file>] [--parallel-max <n>] [--pipeline <n>] [--connect-timeout <s>] [--http1.1] [--compressed] [--batch <file>] [-n <requests>] [-c <concurrency>] [-z <duration>] [--rate <r>] [-w <format>] <URL>..." << std::endl;
         return 1;
     }
 
     bool verbose = false;
     bool followsRedirects = false;
+    bool spliceDownloads = false;
+    bool uringDownloads = false;
+    size_t downloadSegments = 1;
+    bool resumeDownloads = false;
+    std::string tlsSessionFile;
+    std::string cacheDirectory;
+    uint64_t cacheMaxSize = 1024ull << 20;
+    size_t parallelMax = 256;
+    size_t pipelineDepth = 0;
+    double connectTimeout = 30;
+    bool http2 = true;
+    std::string batchFile;
+    std::string writeOut;
+    LoadOptions loadOptions;
+    bool loadMode = false;
+    std::vector<std::string> urls;
     HttpRequest request;
     request.method = HttpMethod::GET;  // Default method
 
@@ -96,31 +192,263 @@ int main(int argc, char *argv[]) {
                 std::cerr << "Error: -o option requires an output file argument." << std::endl;
                 return 1;
             }
+        } else if (strcmp(argv[i], "-C") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "-") == 0) {
+                ++i;
+                resumeDownloads = true;
+            } else {
+                std::cerr << "Error: -C option requires '-' (resume from the size of the output file)." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--splice") == 0) {
+            spliceDownloads = true;
+        } else if (strcmp(argv[i], "--io-uring") == 0) {
+            uringDownloads = true;
+        } else if (strcmp(argv[i], "--segments") == 0) {
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+                downloadSegments = std::atoi(argv[++i]);
+            } else {
+                std::cerr << "Error: --segments option requires a positive number." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tls-session-file") == 0) {
+            if (i + 1 < argc) {
+                tlsSessionFile = argv[++i];
+            } else {
+                std::cerr << "Error: --tls-session-file option requires a file argument." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 < argc) {
+                cacheDirectory = argv[++i];
+            } else {
+                std::cerr << "Error: --cache-dir option requires a directory argument." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cache-max-size") == 0) {
+            if (i + 1 < argc && parseMebibytes(argv[i + 1], cacheMaxSize)) {
+                ++i;
+            } else {
+                std::cerr << "Error: --cache-max-size option requires a positive number of MiB." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--url-file") == 0) {
+            if (i + 1 < argc) {
+                std::ifstream urlFile(argv[++i]);
+                if (!urlFile) {
+                    std::cerr << "Error: Failed to open URL file: " << argv[i] << std::endl;
+                    return 1;
+                }
+                std::string line;
+                while (std::getline(urlFile, line)) {
+                    line.erase(line.find_last_not_of(" \t\r") + 1);
+                    line.erase(0, line.find_first_not_of(" \t"));
+                    if (!line.empty() && line[0] != '#') {
+                        urls.push_back(line);
+                    }
+                }
+            } else {
+                std::cerr << "Error: --url-file option requires a file argument." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--parallel-max") == 0) {
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+                parallelMax = std::atoi(argv[++i]);
+            } else {
+                std::cerr << "Error: --parallel-max option requires a positive number." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+                pipelineDepth = std::atoi(argv[++i]);
+            } else {
+                std::cerr << "Error: --pipeline option requires a positive number." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--connect-timeout") == 0) {
+            if (i + 1 < argc && std::atof(argv[i + 1]) > 0) {
+                connectTimeout = std::atof(argv[++i]);
+            } else {
+                std::cerr << "Error: --connect-timeout option requires a positive number of seconds." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--http1.1") == 0) {
+            http2 = false;
+        } else if (strcmp(argv[i], "--compressed") == 0) {
+            request.compressed = true;
+        } else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--rate") == 0) {
+            if (i + 1 >= argc || std::atof(argv[i + 1]) <= 0) {
+                std::cerr << "Error: " << argv[i] << " option requires a positive number." << std::endl;
+                return 1;
+            }
+            if (argv[i][1] == 'n') {
+                loadOptions.totalRequests = std::strtoull(argv[++i], nullptr, 10);
+            } else if (argv[i][1] == 'c') {
+                loadOptions.concurrency = std::strtoull(argv[++i], nullptr, 10);
+            } else {
+                loadOptions.rate = std::atof(argv[++i]);
+            }
+            loadMode = true;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: -w option requires a format argument." << std::endl;
+                return 1;
+            }
+            writeOut = argv[++i];
+            if (!writeOut.empty() && writeOut[0] == '@') {
+                std::ifstream formatFile(writeOut.substr(1));
+                if (!formatFile) {
+                    std::cerr << "Error: Failed to open write-out file: " << writeOut.substr(1) << std::endl;
+                    return 1;
+                }
+                writeOut.assign(std::istreambuf_iterator<char>(formatFile), std::istreambuf_iterator<char>());
+            }
+        } else if (strcmp(argv[i], "-z") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: -z option requires a duration." << std::endl;
+                return 1;
+            }
+            try {
+                loadOptions.duration = parseDuration(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+            loadMode = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            if (i + 1 < argc) {
+                batchFile = argv[++i];
+            } else {
+                std::cerr << "Error: --batch option requires a file argument." << std::endl;
+                return 1;
+            }
         } else {
-            request.url = UrlParser::parse(argv[i]);
+            urls.push_back(argv[i]);
         }
     }
 
-    if (request.url.host.empty()) {
+    if (!batchFile.empty() && (!urls.empty() || !request.outputFile.empty())) {
+        std::cerr << "Error: --batch takes URLs and output files from the batch file." << std::endl;
+        return 1;
+    }
+    if (loadMode && (urls.size() != 1 || !batchFile.empty() || !request.outputFile.empty())) {
+        std::cerr << "Error: Load mode takes exactly one URL and no -o or --batch." << std::endl;
+        return 1;
+    }
+    if (loadMode && loadOptions.totalRequests == 0 && loadOptions.duration.count() == 0) {
+        std::cerr << "Error: Load mode needs -n or -z." << std::endl;
+        return 1;
+    }
+    if (urls.empty() && batchFile.empty()) {
         std::cerr << "Error: URL is required." << std::endl;
         return 1;
     }
+    if (urls.size() > 1 && !request.outputFile.empty()) {
+        std::cerr << "Error: -o can only be used with a single URL." << std::endl;
+        return 1;
+    }
+    if (pipelineDepth > 0 && followsRedirects) {
+        std::cerr << "Error: --pipeline cannot be combined with -L." << std::endl;
+        return 1;
+    }
+    if (request.compressed && resumeDownloads) {
+        std::cerr << "Error: -C cannot be combined with --compressed." << std::endl;
+        return 1;
+    }
 
     // Add default headers if not provided
-    if (request.headers.find("Accept") == request.headers.end()) {
+    if (!hasHeader(request.headers, "Accept")) {
         request.headers["Accept"] = "*/*";
     }
-    if (request.headers.find("Connection") == request.headers.end()) {
-        request.headers["Connection"] = "close";
+    if (request.compressed && !hasHeader(request.headers, "Accept-Encoding")) {
+        request.headers["Accept-Encoding"] = ContentDecoder::acceptEncoding();
+    }
+    // Encode the command-line headers once; every request made from this template shares them.
+    request.sharedHeaders = std::make_shared<const HeaderBlock>(request.headers);
+    request.headers.clear();
+
+    std::vector<HttpRequest> requests;
+    try {
+        for (const auto& url : urls) {
+            HttpRequest urlRequest = request;
+            urlRequest.url = UrlParser::parse(url);
+            requests.push_back(urlRequest);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!requests.empty()) {
+        request = requests.front();
     }
 
     try {
         HttpClient client;
-        if(!request.outputFile.empty()) {
-            client.downloadFile(request, verbose);
+        client.setSpliceDownloads(spliceDownloads);
+        client.setUringDownloads(uringDownloads);
+        client.setDownloadSegments(downloadSegments);
+        client.setResumeDownloads(resumeDownloads);
+        client.setFollowRedirects(followsRedirects);
+        client.setHttp2(http2);
+        client.setConnectTimeout(std::chrono::milliseconds(static_cast<long long>(connectTimeout * 1000)));
+        if (!tlsSessionFile.empty()) {
+            client.setTlsSessionFile(tlsSessionFile);
+        }
+        if (!cacheDirectory.empty()) {
+            client.setCacheDirectory(cacheDirectory, cacheMaxSize);
+        }
+        if (loadMode) {
+            LoadGenerator generator(client, request, loadOptions);
+            LoadReport report = generator.run();
+            LoadGenerator::printReport(report, std::cout);
+            return report.errors > 0 ? 1 : 0;
+        } else if (!batchFile.empty()) {
+            std::ifstream file;
+            if (batchFile != "-") {
+                file.open(batchFile);
+                if (!file) {
+                    std::cerr << "Error: Failed to open batch file: " << batchFile << std::endl;
+                    return 1;
+                }
+            }
+            BatchRunner runner(client, request);
+            size_t failures = runner.run(batchFile == "-" ? std::cin : file, std::cout, parallelMax);
+            return failures > 0 ? 1 : 0;
+        } else if (requests.size() > 1) {
+            std::vector<FetchResult> results = pipelineDepth > 0 ? client.fetchPipelined(requests, pipelineDepth)
+                                                                 : client.fetchAll(requests, parallelMax);
+            int status = 0;
+            for (size_t i = 0; i < results.size(); ++i) {
+                if (!results[i].error.empty()) {
+                    std::cerr << "Error: " << urls[i] << ": " << results[i].error << std::endl;
+                    status = 1;
+                    continue;
+                }
+                if (verbose) {
+                    std::cout << "< " << results[i].response.statusLine << std::endl;
+                    for (const auto& header : results[i].response.headers) {
+                        std::cout << "< " << header.name << ": " << header.value << std::endl;
+                    }
+                    std::cout << "<" << std::endl;
+                }
+                std::cout << results[i].response.body << std::endl;
+                if (!writeOut.empty()) {
+                    std::cout << formatWriteOut(writeOut, results[i].response, urls[i]) << std::flush;
+                }
+            }
+            return status;
+        } else if(!request.outputFile.empty()) {
+            HttpResponse response = client.downloadFile(request, verbose);
+            if (!writeOut.empty()) {
+                std::cout << formatWriteOut(writeOut, response, urls.front()) << std::flush;
+            }
         } else {
-            HttpResponse response = client.sendRequest(request, verbose);
-            std::cout << response.body << std::endl;
+            // Stream the body to stdout as it arrives rather than holding it until the end.
+            HttpResponse response = client.sendRequest(request, verbose, streamSink(std::cout));
+            std::cout << std::endl;
+            if (!writeOut.empty()) {
+                std::cout << formatWriteOut(writeOut, response, urls.front()) << std::flush;
+            }
         }
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,85 @@
+#pragma once
+#include "http_client.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/// @brief Builds the Authorization value for URL credentials ("user:password" becomes "Basic dXNlcjpwYXNzd29yZA==").
+std::string basicAuthorization(const std::string& userinfo);
+
+/// @brief Header fields encoded once ("Name: value\r\n" lines) so that many requests can send them
+/// without re-encoding. Attach one to HttpRequest::sharedHeaders.
+class HeaderBlock {
+public:
+    /// @brief Encodes the fields.
+    explicit HeaderBlock(const std::map<std::string, std::string>& fields);
+
+    /// @brief Returns the encoded fields.
+    const std::string& encoded() const { return wire; }
+
+    /// @brief Returns the fields the block was built from.
+    const std::map<std::string, std::string>& fields() const { return source; }
+
+    /// @brief Case-insensitively checks whether the block contains a field.
+    bool contains(const std::string& name) const;
+
+    /// @brief Returns a field's value (case-insensitive name), or nullptr if absent.
+    const std::string* find(const std::string& name) const;
+
+private:
+    std::map<std::string, std::string> source;
+    std::string wire;
+};
+
+/// @brief A request laid out as scatter-gather buffers instead of one string.
+/// The request line and Host are formatted per request, the shared header block is referenced as is,
+/// the request's own headers and framing follow, and the body is referenced in the caller's storage,
+/// so it is never copied on the way to writev/sendmsg. The HttpRequest (and its shared header block)
+/// must outlive this object.
+class SerializedRequest {
+public:
+    /// @brief Largest request sent as a single coalesced TLS write; bigger bodies are written from the
+    /// caller's buffer after the head.
+    static const size_t tlsCoalesceLimit = 16 * 1024;
+
+    explicit SerializedRequest(const HttpRequest& request);
+
+    SerializedRequest(const SerializedRequest&) = delete;
+    SerializedRequest& operator=(const SerializedRequest&) = delete;
+
+    /// @brief Returns the total size of the request in bytes.
+    size_t size() const { return total; }
+
+    /// @brief Returns the request as one string (for display or tests).
+    std::string flatten() const;
+
+    /// @brief Writes as much of the request as the socket accepts, starting at byte `offset`, with one sendmsg call.
+    /// @return The number of bytes written, or -1 with errno set.
+    ssize_t send(int sock, size_t offset) const;
+
+    /// @brief Plans the writes for a TLS connection, where each SSL_write becomes at least one record.
+    /// Small requests are coalesced into `storage` and written at once; large ones are written as the
+    /// coalesced head followed by the body straight from the caller's storage.
+    /// @param storage Holds the coalesced bytes; must outlive the returned views.
+    /// @return The buffers to hand to SSL_write, in order.
+    std::vector<std::string_view> tlsSegments(std::string& storage) const;
+
+private:
+    static const int maxParts = 4;
+
+    std::string head;                          ///< Request line, Host and, if needed, merged shared headers.
+    std::shared_ptr<const HeaderBlock> shared; ///< Shared header block sent as is, or null.
+    std::string tail;                          ///< The request's own headers, framing and the blank line.
+    std::string_view body;                     ///< The body, in the request's storage.
+    struct iovec parts[maxParts];
+    int partCount = 0;
+    size_t total = 0;
+
+    /// @brief Returns the head (everything but the body) as one string.
+    std::string headBytes() const;
+};
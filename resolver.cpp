@@ -0,0 +1,155 @@
+//resolver.cpp
+
+#include "resolver.h"
+#include "event_loop.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+Resolver::Resolver(std::chrono::milliseconds ttl) : ttl(ttl) {}
+
+bool Resolver::lookupCached(const std::string& host, uint16_t port, std::vector<ResolvedAddress>& addresses) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(host + ":" + std::to_string(port));
+    if (it == cache.end()) {
+        return false;
+    }
+    if (it->second.expires <= std::chrono::steady_clock::now()) {
+        cache.erase(it);
+        return false;
+    }
+    addresses = it->second.addresses;
+    return true;
+}
+
+std::vector<ResolvedAddress> Resolver::resolve(const std::string& host, uint16_t port) {
+    std::vector<ResolvedAddress> addresses;
+    if (lookupCached(host, port, addresses)) {
+        return addresses;
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(port);
+    int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+    if (rc != 0 || !result) {
+        throw std::runtime_error("Failed to resolve the hostname: " + host + " (" + gai_strerror(rc) + ")");
+    }
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        if ((ai->ai_family != AF_INET && ai->ai_family != AF_INET6) || ai->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+        ResolvedAddress address = {};
+        memcpy(&address.storage, ai->ai_addr, ai->ai_addrlen);
+        address.length = ai->ai_addrlen;
+        address.family = ai->ai_family;
+        addresses.push_back(address);
+    }
+    freeaddrinfo(result);
+    if (addresses.empty()) {
+        throw std::runtime_error("Failed to resolve the hostname: " + host);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache[host + ":" + service] = {addresses, std::chrono::steady_clock::now() + ttl};
+    return addresses;
+}
+
+void Resolver::setTtl(std::chrono::milliseconds ttl) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->ttl = ttl;
+}
+
+void Resolver::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.clear();
+}
+
+AsyncResolver::AsyncResolver(EventLoop& loop, Resolver& resolver, size_t maxThreads)
+    : loop(loop), resolver(resolver), maxThreads(maxThreads > 0 ? maxThreads : 1),
+      eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (eventFd == -1) {
+        throw std::runtime_error("Failed to create eventfd: " + std::string(strerror(errno)));
+    }
+    loop.add(eventFd, EPOLLIN, [this](uint32_t) { deliver(); });
+}
+
+AsyncResolver::~AsyncResolver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    loop.remove(eventFd);
+    close(eventFd);
+}
+
+void AsyncResolver::resolve(const std::string& host, uint16_t port, Callback callback) {
+    std::vector<ResolvedAddress> addresses;
+    if (resolver.lookupCached(host, port, addresses)) {
+        callback(addresses, "");
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back({host, port, std::move(callback), {}, ""});
+        // Threads are only started once lookups actually miss the cache.
+        if (workers.size() < maxThreads) {
+            workers.emplace_back(&AsyncResolver::work, this);
+        }
+    }
+    wake.notify_one();
+}
+
+void AsyncResolver::work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(pending.front());
+            pending.pop_front();
+        }
+        try {
+            job.addresses = resolver.resolve(job.host, job.port);
+        } catch (const std::exception& e) {
+            job.error = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(job));
+        }
+        uint64_t one = 1;
+        if (write(eventFd, &one, sizeof(one)) < 0) {
+            // The counter can only overflow after 2^64 - 1 unread signals; nothing to do.
+        }
+    }
+}
+
+void AsyncResolver::deliver() {
+    uint64_t count;
+    if (read(eventFd, &count, sizeof(count)) < 0) {
+        // EAGAIN: another wakeup already drained the counter.
+    }
+    std::deque<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(finished);
+    }
+    for (auto& job : ready) {
+        job.callback(job.addresses, job.error);
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+class EventLoop;
+
+/// @brief One socket address a host name resolved to.
+struct ResolvedAddress {
+    sockaddr_storage storage; ///< The address, including the port.
+    socklen_t length;         ///< Length of the address in `storage`.
+    int family;               ///< AF_INET or AF_INET6.
+
+    const sockaddr* addr() const { return reinterpret_cast<const sockaddr*>(&storage); }
+};
+
+/// @brief Name resolution through getaddrinfo (IPv4 and IPv6) with an in-process cache.
+/// getaddrinfo does not expose record TTLs, so entries live for a configurable time instead.
+/// Thread-safe.
+class Resolver {
+public:
+    /// @brief Constructs a resolver.
+    /// @param ttl How long resolved addresses are reused before the name is looked up again.
+    explicit Resolver(std::chrono::milliseconds ttl = std::chrono::seconds(60));
+
+    /// @brief Resolves a host name, answering from the cache when the entry is still fresh.
+    /// @param host Host name or IP literal.
+    /// @param port The port to put into the returned addresses.
+    /// @return All addresses, in the order getaddrinfo returned them.
+    /// @throws std::runtime_error if the name cannot be resolved.
+    std::vector<ResolvedAddress> resolve(const std::string& host, uint16_t port);
+
+    /// @brief Returns the cached addresses if the entry is fresh.
+    /// @return True on a cache hit.
+    bool lookupCached(const std::string& host, uint16_t port, std::vector<ResolvedAddress>& addresses);
+
+    void setTtl(std::chrono::milliseconds ttl);
+
+    /// @brief Forgets all cached entries.
+    void clear();
+
+private:
+    struct Entry {
+        std::vector<ResolvedAddress> addresses;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::chrono::milliseconds ttl;
+    std::map<std::string, Entry> cache; ///< Entries by "host:port".
+    std::mutex mutex;                   ///< Guards cache and ttl.
+};
+
+/// @brief Resolves names for an EventLoop without blocking it.
+/// Lookups that miss the cache run on a small pool of worker threads; results are handed back to
+/// the loop through an eventfd so callbacks always run on the loop's thread.
+class AsyncResolver {
+public:
+    using Callback = std::function<void(const std::vector<ResolvedAddress>& addresses, const std::string& error)>;
+
+    /// @brief Creates a resolver bound to a loop.
+    /// @param loop The loop on which callbacks run.
+    /// @param resolver The (shared) resolver and cache doing the actual lookups.
+    /// @param maxThreads Maximum number of lookups running at once.
+    AsyncResolver(EventLoop& loop, Resolver& resolver, size_t maxThreads = 4);
+
+    /// @brief Stops the workers; lookups still in progress are waited for but not reported.
+    ~AsyncResolver();
+
+    AsyncResolver(const AsyncResolver&) = delete;
+    AsyncResolver& operator=(const AsyncResolver&) = delete;
+
+    /// @brief Resolves a name. Cache hits call `callback` immediately.
+    void resolve(const std::string& host, uint16_t port, Callback callback);
+
+private:
+    struct Job {
+        std::string host;
+        uint16_t port;
+        Callback callback;
+        std::vector<ResolvedAddress> addresses;
+        std::string error;
+    };
+
+    EventLoop& loop;
+    Resolver& resolver;
+    size_t maxThreads;
+    int eventFd;                     ///< Signals the loop that results are ready.
+    std::vector<std::thread> workers;
+    std::deque<Job> pending;         ///< Lookups waiting for a worker.
+    std::deque<Job> finished;        ///< Results waiting to be delivered on the loop.
+    std::mutex mutex;                ///< Guards pending, finished and stopping.
+    std::condition_variable wake;    ///< Wakes workers when a job arrives or on shutdown.
+    bool stopping = false;
+
+    void work();
+
+    /// @brief Delivers finished lookups on the loop thread.
+    void deliver();
+};
@@ -0,0 +1,204 @@
+//response_parser.cpp
+
+#include "response_parser.h"
+#include "http_client.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <strings.h>
+
+/// @brief Longest status or header line accepted before the response is rejected.
+const size_t maxLineLength = 64 * 1024;
+
+namespace {
+
+/// @brief Case-insensitively checks whether a comma separated header value contains a token.
+bool hasToken(std::string_view value, const char* token) {
+    size_t tokenLength = strlen(token);
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t end = value.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = value.size();
+        }
+        size_t first = value.find_first_not_of(" \t", pos);
+        size_t last = value.find_last_not_of(" \t", end - 1);
+        if (first < end && last != std::string_view::npos && last >= first &&
+            last - first + 1 == tokenLength && strncasecmp(value.data() + first, token, tokenLength) == 0) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+HttpResponseParser::HttpResponseParser(HttpResponse& response, BodyCallback onBody)
+    : response(response), onBody(std::move(onBody)),
+      chunkedDecoder(
+          [this](const char* data, size_t length) { this->onBody(data, length); },
+          [this](const std::string& trailer) { this->response.trailers.addLine(trailer); }) {}
+
+size_t HttpResponseParser::feed(const char* data, size_t length) {
+    size_t pos = 0;
+    while (pos < length && state != State::Done) {
+        switch (state) {
+            case State::Body: {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, length - pos));
+                onBody(data + pos, n);
+                pos += n;
+                remaining -= n;
+                if (remaining == 0) {
+                    state = State::Done;
+                }
+                break;
+            }
+            case State::Chunked:
+                pos += chunkedDecoder.decode(data + pos, length - pos);
+                if (chunkedDecoder.done()) {
+                    state = State::Done;
+                }
+                break;
+            case State::BodyUntilClose:
+                onBody(data + pos, length - pos);
+                pos = length;
+                break;
+            default: {
+                // Line-oriented states: collect up to the next LF, carrying partial lines over.
+                const char* newline = static_cast<const char*>(memchr(data + pos, '\n', length - pos));
+                size_t end = newline ? static_cast<size_t>(newline - data) : length;
+                if (line.size() + (end - pos) > maxLineLength) {
+                    throw std::runtime_error("Response line too long");
+                }
+                line.append(data + pos, end - pos);
+                if (!newline) {
+                    return length;
+                }
+                pos = end + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                onLine(line);
+                line.clear();
+                break;
+            }
+        }
+    }
+    return pos;
+}
+
+void HttpResponseParser::finish() {
+    if (state == State::BodyUntilClose) {
+        state = State::Done;
+    }
+    if (state != State::Done) {
+        throw std::runtime_error(headersComplete()
+            ? "Connection closed before the response body was complete"
+            : "Connection closed before the response headers were received");
+    }
+}
+
+void HttpResponseParser::skipRawBody(uint64_t count) {
+    if (state != State::Body) {
+        return;
+    }
+    remaining -= std::min(count, remaining);
+    if (remaining == 0) {
+        state = State::Done;
+    }
+}
+
+void HttpResponseParser::onLine(const std::string& text) {
+    switch (state) {
+        case State::StatusLine:
+            if (!text.empty()) { // Tolerate stray blank lines before the status line
+                parseStatusLine(text);
+                state = State::Headers;
+            }
+            break;
+        case State::Headers:
+            if (text.empty()) {
+                beginBody();
+            } else {
+                parseHeader(text);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void HttpResponseParser::parseStatusLine(const std::string& text) {
+    // HTTP/1.1 200 OK
+    if (text.compare(0, 5, "HTTP/") != 0 || text.size() < 12 || text[8] != ' ' ||
+        !isdigit(static_cast<unsigned char>(text[9])) || !isdigit(static_cast<unsigned char>(text[10])) ||
+        !isdigit(static_cast<unsigned char>(text[11]))) {
+        throw std::runtime_error("Invalid status line: " + text);
+    }
+    response.statusLine = text;
+    response.statusCode = (text[9] - '0') * 100 + (text[10] - '0') * 10 + (text[11] - '0');
+    persistent = text.compare(5, 3, "1.1") == 0;
+}
+
+void HttpResponseParser::parseHeader(const std::string& text) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos || colon == 0) {
+        return; // Not a field; ignored.
+    }
+    std::string_view line(text);
+    KnownHeader kind = response.headers.add(line.substr(0, colon), line.substr(colon + 1));
+    std::string_view value = response.headers[response.headers.size() - 1].value;
+    switch (kind) {
+        case KnownHeader::ContentLength:
+            // Only the first Content-Length is indexed, so any repeat must agree with it.
+            length = response.headers.contentLength();
+            if (length < 0 || value != response.headers.get(KnownHeader::ContentLength)) {
+                throw std::runtime_error("Invalid Content-Length: " + std::string(value));
+            }
+            break;
+        case KnownHeader::TransferEncoding:
+            chunked = chunked || hasToken(value, "chunked");
+            break;
+        case KnownHeader::Connection:
+            if (hasToken(value, "close")) {
+                persistent = false;
+            } else if (hasToken(value, "keep-alive")) {
+                persistent = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void HttpResponseParser::beginBody() {
+    int status = response.statusCode;
+    if (status >= 100 && status < 200 && status != 101) {
+        // Interim response (e.g. 100 Continue); the final response follows.
+        response.statusLine.clear();
+        response.statusCode = 0;
+        response.headers.clear();
+        length = -1;
+        chunked = false;
+        state = State::StatusLine;
+        return;
+    }
+    if (onHeaders) {
+        onHeaders();
+    }
+    if (noBody || status == 204 || status == 304 || status == 101) {
+        state = State::Done;
+    } else if (chunked) {
+        state = State::Chunked;
+    } else if (length >= 0) {
+        remaining = static_cast<uint64_t>(length);
+        state = remaining == 0 ? State::Done : State::Body;
+    } else {
+        closeDelimited = true;
+        state = State::BodyUntilClose;
+    }
+}
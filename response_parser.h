@@ -0,0 +1,102 @@
+#pragma once
+#include "chunked_decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+struct HttpResponse;
+
+/// @brief Incremental HTTP/1.x response parser.
+/// Bytes are fed as they arrive from the transport; the status line, headers and trailers are stored
+/// in an HttpResponse and body bytes are handed to a callback without being buffered. The end of the
+/// response is found from Content-Length or chunked framing, so the connection does not have to be
+/// closed to delimit it. Bodies without framing run until finish() is called at end of stream.
+class HttpResponseParser {
+public:
+    using BodyCallback = std::function<void(const char*, size_t)>;
+
+    /// @brief Creates a parser for one response.
+    /// @param response Receives the status line, status code, headers and trailers.
+    /// @param onBody Called with each piece of the decoded body.
+    HttpResponseParser(HttpResponse& response, BodyCallback onBody);
+    // The chunked decoder's callbacks point back at this parser, so it stays where it was created.
+    HttpResponseParser(const HttpResponseParser&) = delete;
+    HttpResponseParser& operator=(const HttpResponseParser&) = delete;
+    HttpResponseParser(HttpResponseParser&&) = delete;
+    HttpResponseParser& operator=(HttpResponseParser&&) = delete;
+
+    /// @brief Parses the next bytes of the response.
+    /// Parsing stops at the end of the response, so any bytes after it are not consumed.
+    /// @param data The received bytes.
+    /// @param length Number of bytes in `data`.
+    /// @return The number of bytes consumed.
+    /// @throws std::runtime_error on a malformed response.
+    size_t feed(const char* data, size_t length);
+
+    /// @brief Signals that the peer closed the connection.
+    /// Completes a close-delimited body.
+    /// @throws std::runtime_error if the response is still incomplete.
+    void finish();
+
+    /// @brief Sets a callback invoked once the final response's headers are parsed, before any body bytes.
+    void setHeadersCallback(std::function<void()> onHeaders) { this->onHeaders = std::move(onHeaders); }
+
+    /// @brief Tells the parser the response has no body regardless of its headers (e.g. a HEAD response).
+    void setNoBody(bool noBody) { this->noBody = noBody; }
+
+    /// @brief Returns true once the status line and all headers have been parsed.
+    bool headersComplete() const { return state > State::Headers; }
+
+    /// @brief Returns true once the whole response has been parsed.
+    bool done() const { return state == State::Done; }
+
+    /// @brief Returns true if the connection may carry another request after this response.
+    bool keepAlive() const { return persistent && !closeDelimited; }
+
+    /// @brief Returns the announced Content-Length, or -1 if there was none.
+    int64_t contentLength() const { return length; }
+
+    /// @brief Returns true while the rest of the body is sent as-is on the wire (Content-Length or
+    /// close delimited), so a caller may move it without going through feed().
+    bool rawBodyPending() const { return state == State::Body || state == State::BodyUntilClose; }
+
+    /// @brief Returns the number of raw body bytes still expected, or -1 for a close-delimited body.
+    int64_t rawBodyRemaining() const { return state == State::Body ? static_cast<int64_t>(remaining) : -1; }
+
+    /// @brief Records that `count` raw body bytes were consumed outside the parser.
+    /// For a close-delimited body, call finish() once the connection has closed instead.
+    void skipRawBody(uint64_t count);
+
+private:
+    enum class State {
+        StatusLine,     ///< Reading the status line.
+        Headers,        ///< Reading header lines up to the blank line.
+        Body,           ///< Reading a Content-Length delimited body.
+        BodyUntilClose, ///< Reading a body delimited by the connection closing.
+        Chunked,        ///< Decoding a chunked body, trailers included.
+        Done            ///< The response is complete.
+    };
+
+    HttpResponse& response;
+    BodyCallback onBody;
+    std::function<void()> onHeaders; ///< Optional notification that the headers are complete.
+    ChunkedDecoder chunkedDecoder; ///< Decodes chunked bodies straight into onBody.
+    State state = State::StatusLine;
+    std::string line;            ///< Partial line carried over between feed() calls.
+    uint64_t remaining = 0;      ///< Bytes left in a Content-Length body.
+    int64_t length = -1;         ///< Content-Length header value.
+    bool chunked = false;        ///< Transfer-Encoding includes chunked.
+    bool persistent = false;     ///< Connection persistence from the protocol version and Connection header.
+    bool closeDelimited = false; ///< The body runs until the connection closes.
+    bool noBody = false;         ///< The request does not allow a body in the response.
+
+    /// @brief Handles a complete line (without its line terminator) in a line-oriented state.
+    void onLine(const std::string& text);
+
+    void parseStatusLine(const std::string& text);
+    void parseHeader(const std::string& text);
+
+    /// @brief Chooses the body framing once the blank line after the headers is seen.
+    void beginBody();
+};
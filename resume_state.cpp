@@ -0,0 +1,54 @@
+//resume_state.cpp
+
+#include "resume_state.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+std::string ResumeState::pathFor(const std::string& outputFile) {
+    return outputFile + ".lurc-resume";
+}
+
+bool ResumeState::load(const std::string& outputFile) {
+    std::ifstream in(pathFor(outputFile));
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(": ");
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, colon);
+        std::string value = line.substr(colon + 2);
+        if (key == "url") {
+            url = value;
+        } else if (key == "validator") {
+            validator = value;
+        } else if (key == "size") {
+            totalSize = std::strtoull(value.c_str(), nullptr, 10);
+        }
+    }
+    return !url.empty();
+}
+
+void ResumeState::save(const std::string& outputFile) const {
+    // Write to a temporary file first so an interrupted save never leaves a torn state file.
+    std::string path = pathFor(outputFile);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "url: " << url << "\n";
+        out << "validator: " << validator << "\n";
+        out << "size: " << totalSize << "\n";
+        if (!out) {
+            return; // Resuming is best effort; the download itself should not fail because of it.
+        }
+    }
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+void ResumeState::remove(const std::string& outputFile) {
+    std::remove(pathFor(outputFile).c_str());
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/// @brief Progress state kept next to a partially downloaded file so that a later run can resume it.
+/// Stored as "key: value" lines in `<output file>.lurc-resume` and removed once the download completes.
+struct ResumeState {
+    std::string url;        ///< The URL the partial file was downloaded from.
+    std::string validator;  ///< Strong ETag or Last-Modified value, sent back as If-Range.
+    uint64_t totalSize = 0; ///< Full size of the resource, 0 if unknown.
+
+    /// @brief Returns the path of the state file for an output file.
+    static std::string pathFor(const std::string& outputFile);
+
+    /// @brief Reads the state saved for an output file.
+    /// @return True if a state file exists and could be parsed.
+    bool load(const std::string& outputFile);
+
+    /// @brief Writes the state for an output file, replacing any previous state.
+    void save(const std::string& outputFile) const;
+
+    /// @brief Deletes the state file of an output file, if any.
+    static void remove(const std::string& outputFile);
+};
@@ -0,0 +1,168 @@
+//splice_transfer.cpp
+
+#include "splice_transfer.h"
+#include "io_util.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// @brief Pipe capacity requested for splicing; larger pipes mean fewer splice calls per byte.
+const int splicePipeSize = 1 << 20;
+
+namespace {
+
+/// @brief Closes both ends of a pipe on scope exit.
+struct Pipe {
+    int fds[2] = {-1, -1};
+    ~Pipe() {
+        if (fds[0] != -1) close(fds[0]);
+        if (fds[1] != -1) close(fds[1]);
+    }
+};
+
+/// @brief Copies through a user-space buffer when splicing is not possible.
+uint64_t copySocketToFile(int sock, int fd, int64_t length) {
+    char buffer[65536];
+    uint64_t moved = 0;
+    while (length < 0 || moved < static_cast<uint64_t>(length)) {
+        size_t want = sizeof(buffer);
+        if (length >= 0) {
+            want = static_cast<size_t>(std::min<uint64_t>(want, static_cast<uint64_t>(length) - moved));
+        }
+        ssize_t n = recv(sock, buffer, want, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to receive response: " + std::string(strerror(errno)));
+        }
+        if (n == 0) {
+            break;
+        }
+        writeAll(fd, buffer, n);
+        moved += n;
+    }
+    if (length >= 0 && moved < static_cast<uint64_t>(length)) {
+        throw std::runtime_error("Connection closed before the response body was complete");
+    }
+    return moved;
+}
+
+/// @brief Moves `in` bytes from the pipe into the file, leaving the pipe empty.
+/// @return False if the file cannot be spliced into; the bytes were then copied through user space.
+bool drainPipe(int pipeFd, int fd, size_t in) {
+    while (in > 0) {
+        ssize_t out = splice(pipeFd, nullptr, fd, nullptr, in, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (out < 0 && errno == EINTR) {
+            continue;
+        }
+        if (out < 0 && errno == EINVAL) {
+            char buffer[65536];
+            while (in > 0) {
+                ssize_t n = read(pipeFd, buffer, std::min(sizeof(buffer), in));
+                if (n <= 0) {
+                    throw std::runtime_error("Failed to drain splice pipe");
+                }
+                writeAll(fd, buffer, n);
+                in -= n;
+            }
+            return false;
+        }
+        if (out <= 0) {
+            throw std::runtime_error("splice to file failed: " + std::string(strerror(errno)));
+        }
+        in -= out;
+    }
+    return true;
+}
+
+/// @brief Creates a pipe for splicing and returns its capacity, or 0 if no pipe could be made.
+int openPipe(Pipe& pipe) {
+    if (pipe2(pipe.fds, O_CLOEXEC) == -1) {
+        return 0;
+    }
+    int pipeSize = fcntl(pipe.fds[1], F_SETPIPE_SZ, splicePipeSize);
+    if (pipeSize <= 0) {
+        pipeSize = fcntl(pipe.fds[1], F_GETPIPE_SZ);
+    }
+    return std::max(pipeSize, 0);
+}
+
+} // namespace
+
+uint64_t spliceSocketToFile(int sock, int fd, int64_t length) {
+    Pipe pipe;
+    int pipeSize = openPipe(pipe);
+    if (pipeSize == 0) {
+        return copySocketToFile(sock, fd, length);
+    }
+
+    uint64_t moved = 0;
+    while (length < 0 || moved < static_cast<uint64_t>(length)) {
+        size_t want = static_cast<size_t>(pipeSize);
+        if (length >= 0) {
+            want = static_cast<size_t>(std::min<uint64_t>(want, static_cast<uint64_t>(length) - moved));
+        }
+        ssize_t in = splice(sock, nullptr, pipe.fds[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in < 0 && errno == EINTR) {
+            continue;
+        }
+        if (in < 0 && moved == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            return copySocketToFile(sock, fd, length);
+        }
+        if (in < 0) {
+            throw std::runtime_error("splice from socket failed: " + std::string(strerror(errno)));
+        }
+        if (in == 0) {
+            break;
+        }
+        moved += in;
+        if (!drainPipe(pipe.fds[0], fd, static_cast<size_t>(in))) {
+            // The output file cannot be spliced into: copy the rest.
+            int64_t rest = length < 0 ? -1 : length - static_cast<int64_t>(moved);
+            return moved + copySocketToFile(sock, fd, rest);
+        }
+    }
+    if (length >= 0 && moved < static_cast<uint64_t>(length)) {
+        throw std::runtime_error("Connection closed before the response body was complete");
+    }
+    return moved;
+}
+
+uint64_t spliceKtlsToFile(int sock, int fd, uint64_t length) {
+    Pipe pipe;
+    int pipeSize = openPipe(pipe);
+    if (pipeSize == 0) {
+        return 0;
+    }
+
+    uint64_t moved = 0;
+    while (moved < length) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(static_cast<uint64_t>(pipeSize), length - moved));
+        ssize_t in = splice(sock, nullptr, pipe.fds[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in < 0 && errno == EINTR) {
+            continue;
+        }
+        // The kernel refuses to splice a record that is not application data (EINVAL) and leaves it
+        // queued; EIO/ENOSYS mean this socket cannot be spliced at all. Either way SSL_read takes over.
+        if (in < 0 && (errno == EINVAL || errno == EIO || errno == ENOSYS)) {
+            break;
+        }
+        if (in < 0) {
+            throw std::runtime_error("splice from socket failed: " + std::string(strerror(errno)));
+        }
+        if (in == 0) {
+            break;
+        }
+        moved += in;
+        if (!drainPipe(pipe.fds[0], fd, static_cast<size_t>(in))) {
+            break;
+        }
+    }
+    return moved;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+/// @brief Moves bytes from a socket into a file with splice(2) through a pipe, so the data is never
+/// copied into user space. Falls back to a read/write loop if the file system does not support splicing.
+/// @param sock The source socket; bytes already read from it are not included.
+/// @param fd The destination file, written at its current offset.
+/// @param length Number of bytes to move, or -1 to move everything until the peer closes the connection.
+/// @return The number of bytes moved.
+/// @throws std::runtime_error on I/O errors, or if the connection closes before `length` bytes arrived.
+uint64_t spliceSocketToFile(int sock, int fd, int64_t length);
+
+/// @brief Moves decrypted bytes from a socket whose TLS records the kernel decrypts (kTLS receive
+/// offload) into a file with splice(2). Splicing stops early at the first record that is not
+/// application data (e.g. a TLS alert or post-handshake message), which is left in the socket for
+/// SSL_read to handle, and at end of stream.
+/// @param sock The source socket, with kTLS receive enabled and no data pending inside OpenSSL.
+/// @param fd The destination file, written at its current offset.
+/// @param length Maximum number of bytes to move.
+/// @return The number of bytes moved, which may be less than `length` (even zero).
+/// @throws std::runtime_error on I/O errors other than those that end splicing early.
+uint64_t spliceKtlsToFile(int sock, int fd, uint64_t length);
@@ -0,0 +1,206 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <dirent.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+namespace {
+
+/// @brief Serves resources whose bodies and validators the test changes, and counts requests per path.
+struct Origin {
+    std::mutex mutex;
+    std::map<std::string, int> hits;
+    std::map<std::string, std::string> conditions; ///< Last If-None-Match seen per path.
+    std::string version = "v1";
+    std::string cacheControl = "max-age=60";
+
+    std::string operator()(const std::string& head) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string target = targetOf(head);
+        ++hits[target];
+        conditions[target] = headerOf(head, "If-None-Match");
+        if (target == "/moved") {
+            return makeResponse("302 Found", "Location: /target\r\nCache-Control: max-age=60\r\n", "moved");
+        }
+        std::string etag = "\"" + version + "\"";
+        std::string headers = "Cache-Control: " + cacheControl + "\r\nETag: " + etag + "\r\n";
+        if (conditions[target] == etag) {
+            return "HTTP/1.1 304 Not Modified\r\n" + headers + "\r\n";
+        }
+        std::string padding(target.compare(0, 5, "/big/") == 0 ? 20000 : 0, '.');
+        return makeResponse("200 OK", headers, version + " of " + target + padding);
+    }
+
+    int hitsOf(const std::string& target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits[target];
+    }
+};
+
+HttpRequest get(const LoopbackServer& server, const std::string& path) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url() + path);
+    return request;
+}
+
+/// @brief Returns the number of entries (meta files) in a cache directory.
+size_t entriesIn(const std::string& directory) {
+    size_t count = 0;
+    DIR* dir = opendir(directory.c_str());
+    while (dirent* item = dir ? readdir(dir) : nullptr) {
+        std::string name = item->d_name;
+        count += name.size() > 5 && name.compare(name.size() - 5, 5, ".meta") == 0;
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    return count;
+}
+
+/// @brief Returns the total size of the files in a directory.
+uint64_t bytesIn(const std::string& directory) {
+    uint64_t total = 0;
+    DIR* dir = opendir(directory.c_str());
+    while (dirent* item = dir ? readdir(dir) : nullptr) {
+        struct stat info;
+        if (item->d_name[0] != '.' && stat((directory + "/" + item->d_name).c_str(), &info) == 0) {
+            total += info.st_size;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    return total;
+}
+
+/// @brief Lets file modification times move on, so least recently used order is well defined.
+void tick() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+} // namespace
+
+TEST(Cache, FreshEntryIsServedWithoutTheServer) {
+    Origin origin;
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    HttpClient client;
+    client.setCacheDirectory(dir.file("cache"));
+
+    EXPECT_EQ(client.sendRequest(get(server, "file"), false).body, "v1 of /file");
+    HttpResponse cached = client.sendRequest(get(server, "file"), false);
+    EXPECT_EQ(cached.statusCode, 200);
+    EXPECT_EQ(cached.body, "v1 of /file");
+    EXPECT_EQ(origin.hitsOf("/file"), 1);
+}
+
+TEST(Cache, StaleEntryIsRevalidatedWithItsETag) {
+    Origin origin;
+    origin.cacheControl = "max-age=0";
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    HttpClient client;
+    client.setCacheDirectory(dir.file("cache"));
+
+    client.sendRequest(get(server, "file"), false);
+    HttpResponse revalidated = client.sendRequest(get(server, "file"), false);
+    EXPECT_EQ(origin.hitsOf("/file"), 2);
+    EXPECT_EQ(origin.conditions["/file"], "\"v1\"");
+    EXPECT_EQ(revalidated.statusCode, 200);
+    EXPECT_EQ(revalidated.body, "v1 of /file");
+
+    // A changed resource replaces the entry, and the next revalidation uses the new ETag.
+    origin.version = "v2";
+    EXPECT_EQ(client.sendRequest(get(server, "file"), false).body, "v2 of /file");
+    EXPECT_EQ(client.sendRequest(get(server, "file"), false).body, "v2 of /file");
+    EXPECT_EQ(origin.conditions["/file"], "\"v2\"");
+    EXPECT_EQ(entriesIn(dir.file("cache")), 1u);
+}
+
+TEST(Cache, RevalidatedDownloadIsCopiedFromTheCache) {
+    Origin origin;
+    origin.cacheControl = "max-age=0";
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    HttpClient client;
+    client.setCacheDirectory(dir.file("cache"));
+
+    HttpRequest request = get(server, "file");
+    request.outputFile = dir.file("first");
+    client.downloadFile(request, false);
+    request.outputFile = dir.file("second");
+    client.downloadFile(request, false);
+    EXPECT_EQ(origin.conditions["/file"], "\"v1\"");
+    EXPECT_EQ(readFile(dir.file("second")), "v1 of /file");
+}
+
+TEST(Cache, RedirectedResponseIsNotStoredUnderTheOriginalUrl) {
+    Origin origin;
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    HttpClient client;
+    client.setFollowRedirects(true);
+    client.setCacheDirectory(dir.file("cache"));
+
+    EXPECT_EQ(client.sendRequest(get(server, "moved"), false).body, "v1 of /target");
+    origin.version = "v2";
+    HttpResponse again = client.sendRequest(get(server, "moved"), false);
+    EXPECT_EQ(again.body, "v2 of /target");
+    EXPECT_EQ(again.redirects, 1);
+    EXPECT_EQ(origin.hitsOf("/moved"), 2);
+    EXPECT_EQ(entriesIn(dir.file("cache")), 0u);
+}
+
+TEST(Cache, RedirectedDownloadIsNotStoredUnderTheOriginalUrl) {
+    Origin origin;
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    HttpClient client;
+    client.setFollowRedirects(true);
+    client.setCacheDirectory(dir.file("cache"));
+
+    HttpRequest request = get(server, "moved");
+    request.outputFile = dir.file("out");
+    client.downloadFile(request, false);
+    origin.version = "v2";
+    client.downloadFile(request, false);
+    EXPECT_EQ(readFile(dir.file("out")), "v2 of /target");
+    EXPECT_EQ(origin.hitsOf("/moved"), 2);
+}
+
+TEST(Cache, LeastRecentlyUsedEntriesAreEvicted) {
+    Origin origin;
+    LoopbackServer server([&origin](const std::string& head) { return origin(head); });
+    TempDir dir;
+    std::string cache = dir.file("cache");
+    HttpClient client;
+    // Room for three entries with 20 kB bodies, not four.
+    client.setCacheDirectory(cache, 70000);
+
+    for (const char* path : {"big/1", "big/2", "big/3"}) {
+        client.sendRequest(get(server, path), false);
+        tick();
+    }
+    client.sendRequest(get(server, "big/1"), false); // A hit, which makes /big/2 the least recently used.
+    tick();
+    client.sendRequest(get(server, "big/4"), false);
+    EXPECT_EQ(entriesIn(cache), 3u);
+    EXPECT_LE(bytesIn(cache), 70000u);
+
+    for (const char* path : {"big/1", "big/3", "big/4"}) {
+        client.sendRequest(get(server, path), false);
+    }
+    EXPECT_EQ(origin.hitsOf("/big/1"), 1);
+    EXPECT_EQ(origin.hitsOf("/big/3"), 1);
+    EXPECT_EQ(origin.hitsOf("/big/4"), 1);
+    client.sendRequest(get(server, "big/2"), false);
+    EXPECT_EQ(origin.hitsOf("/big/2"), 2);
+}
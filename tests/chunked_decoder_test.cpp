@@ -0,0 +1,53 @@
+#include "chunked_decoder.h"
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Decoded {
+    std::string body;
+    std::vector<std::string> trailers;
+    ChunkedDecoder decoder{[this](const char* data, size_t length) { body.append(data, length); },
+                           [this](const std::string& field) { trailers.push_back(field); }};
+};
+
+} // namespace
+
+TEST(ChunkedDecoder, DecodesChunksAndTrailers) {
+    Decoded decoded;
+    std::string input = "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Checksum: abc\r\nX-Other: 1\r\n\r\nnext";
+    // One byte at a time, so every state is entered across a buffer boundary.
+    size_t used = 0;
+    while (!decoded.decoder.done() && used < input.size()) {
+        used += decoded.decoder.decode(input.data() + used, 1);
+    }
+    EXPECT_TRUE(decoded.decoder.done());
+    EXPECT_EQ(used, input.size() - 4);
+    EXPECT_EQ(decoded.body, "hello world");
+    EXPECT_EQ(decoded.trailers, (std::vector<std::string>{"X-Checksum: abc", "X-Other: 1"}));
+}
+
+TEST(ChunkedDecoder, RejectsAnOverlongTrailerField) {
+    Decoded decoded;
+    std::string input = "0\r\nX: " + std::string(70 * 1024, 'y');
+    EXPECT_THROW(decoded.decoder.decode(input.data(), input.size()), std::runtime_error);
+}
+
+TEST(ChunkedDecoder, RejectsAnEndlessTrailerSection) {
+    Decoded decoded;
+    std::string input = "0\r\n";
+    decoded.decoder.decode(input.data(), input.size());
+    std::string field = "X: y\r\n";
+    bool rejected = false;
+    for (size_t sent = 0; sent < (1 << 20) && !rejected; sent += field.size()) {
+        try {
+            decoded.decoder.decode(field.data(), field.size());
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+    }
+    EXPECT_TRUE(rejected);
+    EXPECT_LT(decoded.trailers.size(), 1u << 16);
+}
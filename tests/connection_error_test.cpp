@@ -0,0 +1,75 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+/// @brief Accepts one connection, answers with a close-delimited response that is cut short, and
+/// resets the connection instead of closing it.
+class ResettingServer {
+public:
+    ResettingServer() {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (listener == -1 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+            listen(listener, 1) == -1 || getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == -1) {
+            throw std::runtime_error("Failed to set up the test server");
+        }
+        port = ntohs(address.sin_port);
+        thread = std::thread([this] { serve(); });
+    }
+
+    ~ResettingServer() {
+        thread.join();
+        close(listener);
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port) + "/"; }
+
+private:
+    int listener = -1;
+    int port = 0;
+    std::thread thread;
+
+    void serve() {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd == -1) {
+            return;
+        }
+        char buffer[4096];
+        std::string head;
+        while (head.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            head.append(buffer, n);
+        }
+        std::string reply = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\npartial body";
+        send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        linger reset{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        close(fd);
+    }
+};
+
+} // namespace
+
+TEST(ConnectionErrors, ResetDuringCloseDelimitedBodyFails) {
+    ResettingServer server;
+    HttpClient client;
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+
+    EXPECT_THROW(client.sendRequest(request, false), std::runtime_error);
+}
@@ -0,0 +1,45 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+HttpRequest download(const LoopbackServer& server, const std::string& path, const std::string& out) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url() + path);
+    request.outputFile = out;
+    return request;
+}
+
+} // namespace
+
+TEST(ConcurrentFetch, WritesBodiesToOutputFiles) {
+    std::string body = patternBody(300000);
+    LoopbackServer server([&body](const std::string&) { return makeResponse("200 OK", "", body); });
+    TempDir dir;
+    HttpClient client;
+
+    std::vector<FetchResult> results =
+        client.fetchAll({download(server, "a", dir.file("a")), download(server, "b", dir.file("b"))}, 2);
+    for (const FetchResult& result : results) {
+        EXPECT_EQ(result.error, "");
+        EXPECT_EQ(result.bodyBytes, body.size());
+    }
+    EXPECT_EQ(readFile(dir.file("a")), body);
+    EXPECT_EQ(readFile(dir.file("b")), body);
+}
+
+TEST(ConcurrentFetch, ReportsOutputFileWriteErrors) {
+    std::string body = patternBody(300000);
+    LoopbackServer server([&body](const std::string&) { return makeResponse("200 OK", "", body); });
+    HttpClient client;
+
+    // Every write to /dev/full fails with ENOSPC, like a full disk.
+    std::vector<FetchResult> results = client.fetchAll({download(server, "a", "/dev/full")}, 1);
+    EXPECT_EQ(results[0].error.rfind("Failed to write output file: ", 0), 0u) << results[0].error;
+}
@@ -0,0 +1,117 @@
+#include "hpack.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string fromHex(const std::string& hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+std::vector<HeaderField> decode(HpackDecoder& decoder, const std::string& block) {
+    return decoder.decode(block.data(), block.size());
+}
+
+const std::vector<HeaderField> firstRequest = {
+    {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+
+} // namespace
+
+// Requests of RFC 7541 appendix C.3, sharing one decoder so the second relies on the dynamic table.
+TEST(Hpack, DecodesRfcExamplesWithoutHuffman) {
+    HpackDecoder decoder;
+    EXPECT_EQ(decode(decoder, fromHex("828684410f7777772e6578616d706c652e636f6d")), firstRequest);
+
+    std::vector<HeaderField> second = firstRequest;
+    second.emplace_back("cache-control", "no-cache");
+    EXPECT_EQ(decode(decoder, fromHex("828684be58086e6f2d6361636865")), second);
+}
+
+// RFC 7541 appendix C.4.1.
+TEST(Hpack, DecodesRfcExampleWithHuffman) {
+    HpackDecoder decoder;
+    EXPECT_EQ(decode(decoder, fromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff")), firstRequest);
+}
+
+TEST(Hpack, HuffmanRoundTrip) {
+    std::string encoded;
+    huffmanEncode("www.example.com", encoded);
+    EXPECT_EQ(encoded, fromHex("f1e3c2e5f23a6ba0ab90f4ff"));
+    EXPECT_EQ(huffmanEncodedLength("www.example.com"), encoded.size());
+
+    std::string everyByte;
+    for (int c = 0; c < 256; ++c) {
+        everyByte.push_back(static_cast<char>(c));
+    }
+    encoded.clear();
+    huffmanEncode(everyByte, encoded);
+    EXPECT_EQ(encoded.size(), huffmanEncodedLength(everyByte));
+    EXPECT_EQ(huffmanDecode(encoded.data(), encoded.size()), everyByte);
+}
+
+TEST(Hpack, RejectsInvalidHuffmanPadding) {
+    // A whole byte of padding is longer than the 7 bits allowed.
+    std::string encoded;
+    huffmanEncode("a", encoded);
+    encoded.push_back(static_cast<char>(0xff));
+    EXPECT_THROW(huffmanDecode(encoded.data(), encoded.size()), std::runtime_error);
+}
+
+TEST(Hpack, EncoderRoundTripsAcrossBlocks) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    std::vector<HeaderField> fields = {
+        {":method", "GET"}, {":scheme", "https"}, {":authority", "example.com"}, {":path", "/index.html"},
+        {"user-agent", "lurc/1.0"}, {"accept", "*/*"}, {"x-empty", ""}, {"x-binary", std::string("a\0b", 3)}};
+    std::string first;
+    encoder.encode(fields, first);
+    EXPECT_EQ(decode(decoder, first), fields);
+
+    // Repeated fields come from the dynamic table, so the second block is much smaller.
+    std::string second;
+    encoder.encode(fields, second);
+    EXPECT_EQ(decode(decoder, second), fields);
+    EXPECT_LT(second.size(), first.size() / 2);
+}
+
+TEST(Hpack, TableSizeUpdateKeepsPeersInSync) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    std::vector<HeaderField> fields = {{":method", "GET"}, {"x-token", std::string(100, 't')}};
+    std::string block;
+    encoder.encode(fields, block);
+    EXPECT_EQ(decode(decoder, block), fields);
+    std::string indexed;
+    encoder.encode(fields, indexed);
+    EXPECT_EQ(decode(decoder, indexed), fields);
+
+    // A table of size 0 turns every field back into a literal.
+    encoder.setMaxTableSize(0);
+    block.clear();
+    encoder.encode(fields, block);
+    EXPECT_EQ(static_cast<unsigned char>(block[0]), 0x20); // Dynamic table size update to 0
+    EXPECT_EQ(decode(decoder, block), fields);
+    EXPECT_GT(block.size(), indexed.size() + 20);
+}
+
+TEST(Hpack, RejectsTableSizeAboveTheLimit) {
+    HpackDecoder decoder(4096);
+    std::string block = fromHex("3fe21f"); // Size update to 4096 + 1
+    EXPECT_THROW(decode(decoder, block), std::runtime_error);
+}
+
+TEST(Hpack, DynamicTableEvictsOldestEntries) {
+    HpackDynamicTable table(100);
+    table.add("a", std::string(30, 'x')); // 63 bytes with the per-entry overhead
+    table.add("b", std::string(30, 'y'));
+    ASSERT_EQ(table.count(), 1u);
+    EXPECT_EQ(table.at(0)->first, "b");
+
+    table.add("c", std::string(200, 'z')); // Larger than the table: empties it
+    EXPECT_EQ(table.count(), 0u);
+}
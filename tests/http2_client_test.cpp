@@ -0,0 +1,70 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "http2_test_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief A client that trusts the test server's certificate, and the server.
+class Http2ClientTest : public ::testing::Test {
+protected:
+    TempDir dir;
+    Http2TestServer server{dir.file("cert.pem"), [](const std::string& path) {
+        return std::make_pair(200, "body of " + path);
+    }};
+    std::unique_ptr<HttpClient> client;
+
+    void SetUp() override {
+        // Read when the client's TLS context loads its trust store.
+        setenv("SSL_CERT_FILE", dir.file("cert.pem").c_str(), 1);
+        client = std::make_unique<HttpClient>();
+        client->setHttp2(true);
+    }
+
+    std::vector<HttpRequest> requests(size_t count) {
+        std::vector<HttpRequest> list(count);
+        for (size_t i = 0; i < count; ++i) {
+            list[i].method = HttpMethod::GET;
+            list[i].url = UrlParser::parse(server.url() + "item/" + std::to_string(i));
+        }
+        return list;
+    }
+
+    void expectBodies(const std::vector<FetchResult>& results) {
+        for (size_t i = 0; i < results.size(); ++i) {
+            EXPECT_EQ(results[i].error, "") << "request " << i;
+            EXPECT_EQ(results[i].response.statusCode, 200) << "request " << i;
+            EXPECT_EQ(results[i].response.body, "body of /item/" + std::to_string(i));
+        }
+    }
+};
+
+} // namespace
+
+TEST_F(Http2ClientTest, SendRequestUsesHttp2) {
+    HttpRequest request = requests(1)[0];
+    HttpResponse response = client->sendRequest(request, false);
+    EXPECT_EQ(response.statusLine, "HTTP/2 200");
+    EXPECT_EQ(response.body, "body of /item/0");
+}
+
+TEST_F(Http2ClientTest, FetchAllSharesOneConnection) {
+    std::vector<FetchResult> results = client->fetchAll(requests(16), 16);
+    expectBodies(results);
+    EXPECT_EQ(server.connections(), 1);
+    EXPECT_EQ(server.streams(), 16);
+}
+
+TEST_F(Http2ClientTest, PipelinedFetchHandsTheNegotiatedConnectionToStreams) {
+    std::vector<FetchResult> results = client->fetchPipelined(requests(20), 4);
+    ASSERT_EQ(results.size(), 20u);
+    expectBodies(results);
+    // The connection that negotiated h2 carries every stream; nothing reconnects.
+    EXPECT_EQ(server.connections(), 1);
+    EXPECT_EQ(server.streams(), 20);
+}
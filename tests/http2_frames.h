@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hand-built HTTP/2 frames for the scripted server side of the HTTP/2 tests.
+
+namespace h2 {
+
+enum : uint8_t { Data = 0x0, Headers = 0x1, RstStream = 0x3, Settings = 0x4, Ping = 0x6, GoAway = 0x7,
+                 WindowUpdate = 0x8 };
+const uint8_t endStream = 0x1;
+const uint8_t ack = 0x1;
+const uint8_t endHeaders = 0x4;
+const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t prefaceLength = sizeof(preface) - 1;
+
+inline uint32_t readUint32(const std::string& bytes, size_t offset) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(bytes.data() + offset);
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+inline std::string uint32Bytes(uint32_t value) {
+    return {static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8),
+            static_cast<char>(value)};
+}
+
+inline std::string frame(uint8_t type, uint8_t flags, uint32_t stream, const std::string& payload = "") {
+    size_t length = payload.size();
+    std::string bytes = {static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length),
+                         static_cast<char>(type), static_cast<char>(flags)};
+    return bytes + uint32Bytes(stream) + payload;
+}
+
+inline std::string setting(uint16_t id, uint32_t value) {
+    return std::string{static_cast<char>(id >> 8), static_cast<char>(id)} + uint32Bytes(value);
+}
+
+/// @brief Returns the length of the first frame in `bytes`, or 0 if its header is incomplete.
+inline size_t frameLength(const std::string& bytes, size_t offset) {
+    if (bytes.size() - offset < 9) {
+        return 0;
+    }
+    return 9 + ((size_t(uint8_t(bytes[offset])) << 16) | (size_t(uint8_t(bytes[offset + 1])) << 8) |
+                uint8_t(bytes[offset + 2]));
+}
+
+} // namespace h2
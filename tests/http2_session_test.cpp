@@ -0,0 +1,268 @@
+#include "http2_session.h"
+#include "hpack.h"
+#include "url_parser.h"
+#include "http2_frames.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Drives an Http2Session against a scripted server: frames written by the session are parsed from its
+// output, and server frames are built by hand and fed back.
+
+namespace {
+
+using namespace h2;
+
+struct Frame {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream;
+    std::string payload;
+};
+
+/// @brief What one stream reported.
+struct Outcome {
+    bool headers = false;
+    std::string body;
+    bool closed = false;
+    std::string error;
+};
+
+/// @brief A session and the server side of its connection.
+class Http2SessionTest : public ::testing::Test {
+protected:
+    Http2Session session;
+    HpackEncoder serverEncoder;
+    HpackDecoder serverDecoder;
+    bool prefaceSeen = false;
+    // Requests and responses must outlive their streams.
+    std::vector<std::unique_ptr<HttpRequest>> requests;
+    std::vector<std::unique_ptr<HttpResponse>> responses;
+    std::vector<std::unique_ptr<Outcome>> outcomes;
+
+    /// @brief Returns the frames the session wrote since the last call.
+    std::vector<Frame> written() {
+        std::string out(session.output());
+        session.consume(out.size());
+        size_t pos = 0;
+        if (!prefaceSeen) {
+            EXPECT_EQ(out.compare(0, sizeof(preface) - 1, preface), 0);
+            pos = sizeof(preface) - 1;
+            prefaceSeen = true;
+        }
+        std::vector<Frame> frames;
+        while (pos + 9 <= out.size()) {
+            size_t length = (size_t(uint8_t(out[pos])) << 16) | (size_t(uint8_t(out[pos + 1])) << 8) |
+                            uint8_t(out[pos + 2]);
+            frames.push_back({uint8_t(out[pos + 3]), uint8_t(out[pos + 4]), readUint32(out, pos + 5) & 0x7fffffff,
+                              out.substr(pos + 9, length)});
+            pos += 9 + length;
+        }
+        EXPECT_EQ(pos, out.size());
+        return frames;
+    }
+
+    void feed(const std::string& bytes) { session.feed(bytes.data(), bytes.size()); }
+
+    /// @brief Sends the server's SETTINGS and returns the frames the session answered with.
+    std::vector<Frame> handshake(const std::string& settings = "") {
+        written();
+        feed(frame(Settings, 0, 0, settings));
+        return written();
+    }
+
+    /// @brief Submits a request and returns the outcome its handler fills in.
+    Outcome& submit(HttpMethod method, const std::string& url, const std::string& body = "") {
+        requests.push_back(std::make_unique<HttpRequest>());
+        requests.back()->method = method;
+        requests.back()->url = UrlParser::parse(url);
+        requests.back()->data = body;
+        responses.push_back(std::make_unique<HttpResponse>());
+        outcomes.push_back(std::make_unique<Outcome>());
+        Outcome* outcome = outcomes.back().get();
+        Http2Session::StreamHandler handler;
+        handler.onHeaders = [outcome]() { outcome->headers = true; };
+        handler.onData = [outcome](const char* data, size_t length) { outcome->body.append(data, length); };
+        handler.onClose = [outcome](const std::string& error) {
+            outcome->closed = true;
+            outcome->error = error;
+        };
+        session.submit(*requests.back(), *responses.back(), std::move(handler));
+        return *outcome;
+    }
+
+    std::string responseHeaders(uint32_t stream, const std::vector<HeaderField>& fields, uint8_t flags = endHeaders) {
+        std::string block;
+        serverEncoder.encode(fields, block);
+        return frame(Headers, flags, stream, block);
+    }
+};
+
+std::vector<Frame> ofType(const std::vector<Frame>& frames, uint8_t type) {
+    std::vector<Frame> matching;
+    for (const auto& f : frames) {
+        if (f.type == type) {
+            matching.push_back(f);
+        }
+    }
+    return matching;
+}
+
+} // namespace
+
+TEST_F(Http2SessionTest, SendsPrefaceSettingsAndAcknowledgesServerSettings) {
+    std::vector<Frame> frames = written();
+    ASSERT_GE(frames.size(), 2u);
+    EXPECT_EQ(frames[0].type, Settings);
+    EXPECT_EQ(frames[0].flags, 0);
+    EXPECT_NE(frames[0].payload.find(setting(0x2, 0)), std::string::npos); // Push disabled
+    EXPECT_EQ(frames[1].type, WindowUpdate);
+    EXPECT_EQ(frames[1].stream, 0u);
+
+    feed(frame(Settings, 0, 0, setting(0x3, 10)));
+    frames = written();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, Settings);
+    EXPECT_EQ(frames[0].flags, ack);
+    EXPECT_TRUE(frames[0].payload.empty());
+}
+
+TEST_F(Http2SessionTest, ExchangesHeadersAndData) {
+    handshake();
+    Outcome& outcome = submit(HttpMethod::GET, "https://example.com/path?q=1");
+    std::vector<Frame> frames = written();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, Headers);
+    EXPECT_EQ(frames[0].stream, 1u);
+    EXPECT_EQ(frames[0].flags, endHeaders | endStream);
+    std::vector<HeaderField> fields = serverDecoder.decode(frames[0].payload.data(), frames[0].payload.size());
+    ASSERT_GE(fields.size(), 4u);
+    EXPECT_EQ(fields[0], HeaderField(":method", "GET"));
+    EXPECT_EQ(fields[1], HeaderField(":scheme", "https"));
+    EXPECT_EQ(fields[2], HeaderField(":authority", "example.com"));
+    EXPECT_EQ(fields[3], HeaderField(":path", "/path?q=1"));
+
+    feed(responseHeaders(1, {{":status", "200"}, {"content-type", "text/plain"}}));
+    EXPECT_TRUE(outcome.headers);
+    EXPECT_EQ(responses[0]->statusCode, 200);
+    EXPECT_EQ(responses[0]->headers.get("Content-Type"), "text/plain");
+    feed(frame(Data, 0, 1, "hello ") + frame(Data, endStream, 1, "world"));
+    EXPECT_EQ(outcome.body, "hello world");
+    EXPECT_TRUE(outcome.closed);
+    EXPECT_EQ(outcome.error, "");
+    EXPECT_EQ(session.activeStreams(), 0u);
+}
+
+TEST_F(Http2SessionTest, SendsRequestBodyWithinFlowControlWindows) {
+    handshake(setting(0x4, 1000)); // SETTINGS_INITIAL_WINDOW_SIZE
+    std::string body(100000, 'b');
+    submit(HttpMethod::POST, "https://example.com/upload", body);
+    std::vector<Frame> frames = written();
+    ASSERT_EQ(ofType(frames, Headers).size(), 1u);
+    EXPECT_EQ(ofType(frames, Headers)[0].flags & endStream, 0);
+    std::vector<Frame> data = ofType(frames, Data);
+    ASSERT_EQ(data.size(), 1u);
+    EXPECT_EQ(data[0].payload.size(), 1000u); // The stream window
+
+    // The stream window grows past the connection window (65535 - 1000 left), which now limits.
+    feed(frame(WindowUpdate, 0, 1, uint32Bytes(200000)));
+    size_t sent = 0;
+    for (const auto& f : ofType(written(), Data)) {
+        EXPECT_LE(f.payload.size(), 16384u); // The default maximum frame size
+        EXPECT_EQ(f.flags & endStream, 0);
+        sent += f.payload.size();
+    }
+    EXPECT_EQ(sent, 65535u - 1000u);
+
+    feed(frame(WindowUpdate, 0, 0, uint32Bytes(100000)));
+    std::vector<Frame> rest = ofType(written(), Data);
+    sent = 0;
+    for (const auto& f : rest) {
+        sent += f.payload.size();
+    }
+    EXPECT_EQ(sent, body.size() - 65535u);
+    ASSERT_FALSE(rest.empty());
+    EXPECT_EQ(rest.back().flags & endStream, endStream);
+}
+
+TEST_F(Http2SessionTest, ReplenishesReceiveWindows) {
+    handshake();
+    Outcome& outcome = submit(HttpMethod::GET, "https://example.com/large");
+    written();
+    feed(responseHeaders(1, {{":status", "200"}}));
+    // The session advertises a 16 MiB stream window and acknowledges once half of it was consumed.
+    std::string chunk(16384, 'd');
+    size_t received = 0;
+    uint32_t streamIncrement = 0;
+    while (received < (8u << 20)) {
+        feed(frame(Data, 0, 1, chunk));
+        received += chunk.size();
+        for (const auto& f : ofType(written(), WindowUpdate)) {
+            if (f.stream == 1) {
+                streamIncrement += readUint32(f.payload, 0);
+            }
+        }
+    }
+    EXPECT_EQ(streamIncrement, 8u << 20);
+    EXPECT_EQ(outcome.body.size(), received);
+    EXPECT_FALSE(outcome.closed);
+}
+
+TEST_F(Http2SessionTest, QueuesStreamsBeyondTheServerLimit) {
+    handshake(setting(0x3, 1)); // SETTINGS_MAX_CONCURRENT_STREAMS
+    Outcome& first = submit(HttpMethod::GET, "https://example.com/1");
+    Outcome& second = submit(HttpMethod::GET, "https://example.com/2");
+    std::vector<Frame> headers = ofType(written(), Headers);
+    ASSERT_EQ(headers.size(), 1u);
+    EXPECT_EQ(headers[0].stream, 1u);
+
+    feed(responseHeaders(1, {{":status", "204"}}, endHeaders | endStream));
+    EXPECT_TRUE(first.closed);
+    headers = ofType(written(), Headers);
+    ASSERT_EQ(headers.size(), 1u);
+    EXPECT_EQ(headers[0].stream, 3u);
+    EXPECT_FALSE(second.closed);
+}
+
+TEST_F(Http2SessionTest, GoAwayFailsUnprocessedStreamsAndLetsOthersFinish) {
+    handshake(setting(0x3, 2));
+    Outcome& processed = submit(HttpMethod::GET, "https://example.com/1");
+    Outcome& refused = submit(HttpMethod::GET, "https://example.com/2");
+    Outcome& queued = submit(HttpMethod::GET, "https://example.com/3");
+    EXPECT_EQ(ofType(written(), Headers).size(), 2u);
+
+    feed(frame(GoAway, 0, 0, uint32Bytes(1) + uint32Bytes(0)));
+    EXPECT_FALSE(session.acceptsStreams());
+    EXPECT_FALSE(processed.closed);
+    EXPECT_TRUE(refused.closed);
+    EXPECT_NE(refused.error.find("before processing"), std::string::npos);
+    EXPECT_TRUE(queued.closed);
+    EXPECT_NE(queued.error.find("before processing"), std::string::npos);
+    EXPECT_THROW(submit(HttpMethod::GET, "https://example.com/4"), std::runtime_error);
+
+    feed(responseHeaders(1, {{":status", "200"}}) + frame(Data, endStream, 1, "done"));
+    EXPECT_TRUE(processed.closed);
+    EXPECT_EQ(processed.error, "");
+    EXPECT_EQ(processed.body, "done");
+}
+
+TEST_F(Http2SessionTest, ResetStreamEndsOnlyThatStream) {
+    handshake();
+    Outcome& reset = submit(HttpMethod::GET, "https://example.com/1");
+    Outcome& other = submit(HttpMethod::GET, "https://example.com/2");
+    written();
+    feed(frame(RstStream, 0, 1, uint32Bytes(0x7))); // REFUSED_STREAM
+    EXPECT_TRUE(reset.closed);
+    EXPECT_NE(reset.error.find("REFUSED_STREAM"), std::string::npos);
+    EXPECT_FALSE(other.closed);
+}
+
+TEST_F(Http2SessionTest, ConnectionErrorQueuesGoAway) {
+    handshake();
+    // DATA on a stream the client never opened is a connection error.
+    EXPECT_THROW(feed(frame(Data, 0, 5, "x")), std::runtime_error);
+    std::vector<Frame> goAway = ofType(written(), GoAway);
+    ASSERT_EQ(goAway.size(), 1u);
+    EXPECT_EQ(readUint32(goAway[0].payload, 4), 0x1u); // PROTOCOL_ERROR
+}
@@ -0,0 +1,208 @@
+//http2_test_server.cpp
+
+#include "http2_test_server.h"
+#include "http2_frames.h"
+#include "hpack.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+namespace {
+
+/// @brief Selects h2 when the client offers it.
+int selectProtocol(SSL*, const unsigned char** out, unsigned char* outLength, const unsigned char* in,
+                   unsigned int inLength, void*) {
+    static const unsigned char h2[] = "\x02h2";
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, outLength, h2, sizeof(h2) - 1, in, inLength) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+/// @brief Creates a self-signed certificate for "localhost" and installs it with its key.
+void installCertificate(SSL_CTX* ctx, const std::string& certFile) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    bool ok = key && cert;
+    if (ok) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"),
+                                   -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509V3_CTX v3;
+        X509V3_set_ctx_nodb(&v3);
+        X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+        X509_EXTENSION* san = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, "DNS:localhost");
+        ok = san && X509_add_ext(cert, san, -1) == 1;
+        X509_EXTENSION_free(san);
+        ok = ok && X509_sign(cert, key, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, cert) == 1 &&
+             SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    }
+    FILE* out = ok ? fopen(certFile.c_str(), "w") : nullptr;
+    ok = out && PEM_write_X509(out, cert) == 1;
+    if (out) {
+        fclose(out);
+    }
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    if (!ok) {
+        throw std::runtime_error("Failed to create the test certificate");
+    }
+}
+
+/// @brief Reads from a TLS connection into `in`; returns false at end of stream or on error.
+bool readMore(SSL* ssl, std::string& in) {
+    char buffer[16384];
+    int n = SSL_read(ssl, buffer, sizeof(buffer));
+    if (n <= 0) {
+        return false;
+    }
+    in.append(buffer, n);
+    return true;
+}
+
+bool writeAll(SSL* ssl, const std::string& data) {
+    return data.empty() || SSL_write(ssl, data.data(), static_cast<int>(data.size())) > 0;
+}
+
+} // namespace
+
+Http2TestServer::Http2TestServer(const std::string& certFile, Handler handler) : handler(std::move(handler)) {
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        throw std::runtime_error("Failed to create the server TLS context");
+    }
+    SSL_CTX_set_alpn_select_cb(ctx, selectProtocol, nullptr);
+    try {
+        installCertificate(ctx, certFile);
+    } catch (...) {
+        SSL_CTX_free(ctx);
+        throw;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (listenFd == -1 || bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        listen(listenFd, 64) == -1 || getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &length) == -1) {
+        std::string error = strerror(errno);
+        if (listenFd != -1) {
+            close(listenFd);
+        }
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("Failed to listen: " + error);
+    }
+    port = ntohs(addr.sin_port);
+    acceptThread = std::thread(&Http2TestServer::acceptLoop, this);
+}
+
+Http2TestServer::~Http2TestServer() {
+    stopping = true;
+    shutdown(listenFd, SHUT_RDWR);
+    acceptThread.join();
+    close(listenFd);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& worker : workers) {
+            shutdown(worker.fd, SHUT_RDWR);
+        }
+    }
+    for (auto& worker : workers) {
+        worker.thread.join();
+        close(worker.fd);
+    }
+    SSL_CTX_free(ctx);
+}
+
+std::string Http2TestServer::url() const {
+    return "https://localhost:" + std::to_string(port) + "/";
+}
+
+void Http2TestServer::acceptLoop() {
+    while (!stopping) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return; // Listening socket shut down
+        }
+        ++accepted;
+        std::lock_guard<std::mutex> lock(mutex);
+        workers.emplace_back();
+        workers.back().fd = fd;
+        workers.back().thread = std::thread(&Http2TestServer::serve, this, fd);
+    }
+}
+
+void Http2TestServer::serve(int fd) {
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    std::string in;
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    bool ok = SSL_accept(ssl) == 1;
+    while (ok && in.size() < h2::prefaceLength) {
+        ok = readMore(ssl, in);
+    }
+    ok = ok && in.compare(0, h2::prefaceLength, h2::preface) == 0 && writeAll(ssl, h2::frame(h2::Settings, 0, 0));
+    size_t pos = h2::prefaceLength;
+    while (ok) {
+        size_t length = h2::frameLength(in, pos);
+        if (length == 0 || in.size() - pos < length) {
+            ok = readMore(ssl, in);
+            continue;
+        }
+        uint8_t type = static_cast<uint8_t>(in[pos + 3]);
+        uint8_t flags = static_cast<uint8_t>(in[pos + 4]);
+        uint32_t stream = h2::readUint32(in, pos + 5) & 0x7fffffff;
+        std::string payload = in.substr(pos + 9, length - 9);
+        pos += length;
+        std::string reply;
+        if (type == h2::Settings && !(flags & h2::ack)) {
+            reply = h2::frame(h2::Settings, h2::ack, 0);
+        } else if (type == h2::Ping && !(flags & h2::ack)) {
+            reply = h2::frame(h2::Ping, h2::ack, 0, payload);
+        } else if (type == h2::Headers) {
+            // Requests from the client fit one frame and carry no padding or priority.
+            std::string path;
+            for (const auto& field : decoder.decode(payload.data(), payload.size())) {
+                if (field.first == ":path") {
+                    path = field.second;
+                }
+            }
+            std::pair<int, std::string> response = handler(path);
+            std::string block;
+            encoder.encode({{":status", std::to_string(response.first)},
+                            {"content-length", std::to_string(response.second.size())}}, block);
+            reply = h2::frame(h2::Headers, h2::endHeaders, stream, block) +
+                    h2::frame(h2::Data, h2::endStream, stream, response.second);
+            ++answered;
+        } else if (type == h2::GoAway) {
+            break;
+        }
+        ok = writeAll(ssl, reply);
+        if (pos > 65536) {
+            in.erase(0, pos);
+            pos = 0;
+        }
+    }
+    SSL_free(ssl);
+}
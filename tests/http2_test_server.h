@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <openssl/ssl.h>
+
+/// @brief In-process HTTPS server on 127.0.0.1 that negotiates h2 with ALPN and answers every stream
+/// through a handler. It speaks just enough HTTP/2 for the client tests: SETTINGS (acknowledged),
+/// HEADERS in a single frame, one DATA frame per response (so bodies up to 16 KiB), PING and GOAWAY. Its certificate is
+/// self-signed for "localhost" and written to a file that the client is told to trust.
+class Http2TestServer {
+public:
+    /// @brief Returns the status and body for a request path.
+    using Handler = std::function<std::pair<int, std::string>(const std::string& path)>;
+
+    /// @brief Starts listening on an ephemeral port.
+    /// @param certFile Where to write the certificate in PEM format.
+    /// @throws std::runtime_error if the key, certificate or socket cannot be set up.
+    Http2TestServer(const std::string& certFile, Handler handler);
+
+    /// @brief Stops accepting, shuts every connection down and joins the threads.
+    ~Http2TestServer();
+
+    Http2TestServer(const Http2TestServer&) = delete;
+    Http2TestServer& operator=(const Http2TestServer&) = delete;
+
+    /// @brief Returns the base URL, e.g. "https://localhost:40123/".
+    std::string url() const;
+
+    /// @brief Returns the number of connections accepted so far.
+    int connections() const { return accepted; }
+
+    /// @brief Returns the number of streams answered so far.
+    int streams() const { return answered; }
+
+private:
+    struct Worker {
+        int fd = -1;
+        std::thread thread;
+    };
+
+    SSL_CTX* ctx = nullptr;
+    int listenFd = -1;
+    uint16_t port = 0;
+    Handler handler;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> accepted{0};
+    std::atomic<int> answered{0};
+    std::thread acceptThread;
+    std::list<Worker> workers;
+    std::mutex mutex; ///< Guards workers.
+
+    void acceptLoop();
+    void serve(int fd);
+};
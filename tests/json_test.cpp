@@ -0,0 +1,24 @@
+#include "json.h"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+TEST(Json, ParsesNumbers) {
+    for (const char* text : {"0", "-0", "10", "0.5", "-0.25e3", "1E+2", "0e0"}) {
+        JsonValue value = parseJson(text);
+        EXPECT_EQ(value.type, JsonValue::Type::Number) << text;
+        EXPECT_EQ(value.text, text);
+    }
+    EXPECT_EQ(parseJson("[0,1]").items.size(), 2u);
+}
+
+TEST(Json, RejectsLeadingZeros) {
+    for (const char* text : {"01", "-00", "00.5", "-012e1", "{\"id\": 007}"}) {
+        EXPECT_THROW(parseJson(text), std::runtime_error) << text;
+    }
+}
+
+TEST(Json, RejectsMalformedNumbers) {
+    for (const char* text : {"-", "1.", ".5", "1e", "+1"}) {
+        EXPECT_THROW(parseJson(text), std::runtime_error) << text;
+    }
+}
@@ -0,0 +1,104 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief Answers each path with a body of its own, sized by the path so responses differ in length.
+std::string echoPath(const std::string& head, const std::string& extraHeaders = "") {
+    std::string target = targetOf(head);
+    std::string body = "body of " + target + std::string(target.size() * 97, '.');
+    return makeResponse("200 OK", extraHeaders, body, methodOf(head) == "HEAD");
+}
+
+std::string expectedBody(const std::string& target) {
+    return "body of " + target + std::string(target.size() * 97, '.');
+}
+
+std::vector<HttpRequest> requestsFor(const std::string& base, size_t count) {
+    std::vector<HttpRequest> requests(count);
+    for (size_t i = 0; i < count; ++i) {
+        requests[i].method = HttpMethod::GET;
+        requests[i].url = UrlParser::parse(base + "r" + std::to_string(i));
+    }
+    return requests;
+}
+
+} // namespace
+
+TEST(Pipelining, ResponsesMatchRequestsInOrder) {
+    LoopbackServer server([](const std::string& head) { return echoPath(head); });
+    HttpClient client;
+    std::vector<HttpRequest> requests = requestsFor(server.url(), 40);
+    requests[7].method = HttpMethod::HEAD;
+
+    std::vector<FetchResult> results = client.fetchPipelined(requests, 8);
+    ASSERT_EQ(results.size(), requests.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::string target = "/r" + std::to_string(i);
+        ASSERT_EQ(results[i].error, "") << target;
+        EXPECT_EQ(results[i].response.statusCode, 200) << target;
+        EXPECT_EQ(results[i].response.body, i == 7 ? "" : expectedBody(target)) << target;
+    }
+    EXPECT_EQ(server.connectionsAccepted(), 1u);
+}
+
+TEST(Pipelining, InterleavedOriginsKeepTheirPositions) {
+    LoopbackServer first([](const std::string& head) { return echoPath(head, "X-Origin: first\r\n"); });
+    LoopbackServer second([](const std::string& head) { return echoPath(head, "X-Origin: second\r\n"); });
+    HttpClient client;
+    std::vector<HttpRequest> requests = requestsFor(first.url(), 20);
+    for (size_t i = 1; i < requests.size(); i += 2) {
+        requests[i].url = UrlParser::parse(second.url() + "r" + std::to_string(i));
+    }
+
+    std::vector<FetchResult> results = client.fetchPipelined(requests, 4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::string target = "/r" + std::to_string(i);
+        ASSERT_EQ(results[i].error, "") << target;
+        EXPECT_EQ(results[i].response.body, expectedBody(target)) << target;
+        EXPECT_EQ(results[i].response.headers.get("X-Origin"), i % 2 ? "second" : "first") << target;
+    }
+}
+
+TEST(Pipelining, UnansweredRequestsAreReplayedAfterConnectionClose) {
+    LoopbackServer server([](const std::string& head) {
+        return echoPath(head, targetOf(head) == "/r5" ? "Connection: close\r\n" : "");
+    });
+    HttpClient client;
+    std::vector<HttpRequest> requests = requestsFor(server.url(), 16);
+
+    std::vector<FetchResult> results = client.fetchPipelined(requests, 8);
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::string target = "/r" + std::to_string(i);
+        ASSERT_EQ(results[i].error, "") << target;
+        EXPECT_EQ(results[i].response.body, expectedBody(target)) << target;
+    }
+    EXPECT_EQ(server.connectionsAccepted(), 2u);
+}
+
+TEST(Pipelining, UnansweredRequestsAreReplayedAfterDroppedConnection) {
+    std::atomic<bool> dropped{false};
+    LoopbackServer server([&dropped](const std::string& head) {
+        if (targetOf(head) == "/r9" && !dropped.exchange(true)) {
+            return std::string();
+        }
+        return echoPath(head);
+    });
+    HttpClient client;
+    std::vector<HttpRequest> requests = requestsFor(server.url(), 16);
+
+    std::vector<FetchResult> results = client.fetchPipelined(requests, 8);
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::string target = "/r" + std::to_string(i);
+        ASSERT_EQ(results[i].error, "") << target;
+        EXPECT_EQ(results[i].response.body, expectedBody(target)) << target;
+    }
+    EXPECT_TRUE(dropped);
+    EXPECT_EQ(server.connectionsAccepted(), 2u);
+}
@@ -0,0 +1,111 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// @brief Serves /a -> /b -> /c, where /c is a 200. `closeOn` names a redirect that closes its connection.
+struct RedirectChain {
+    std::string closeOn;
+    std::mutex mutex;
+    std::vector<std::string> heads;
+
+    std::string operator()(const std::string& head) {
+        std::string target = targetOf(head);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            heads.push_back(head);
+        }
+        std::string close = target == closeOn ? "Connection: close\r\n" : "";
+        if (target == "/a") {
+            return makeResponse("302 Found", "Location: /b\r\n" + close, "moved");
+        }
+        if (target == "/b") {
+            return makeResponse("301 Moved Permanently", "Location: /c\r\n" + close, "");
+        }
+        return makeResponse("200 OK", "", "final " + target);
+    }
+};
+
+HttpRequest get(const std::string& url) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(url);
+    return request;
+}
+
+} // namespace
+
+TEST(Redirects, ConcurrentFetchFollowsSameOriginHopsOnOneConnection) {
+    RedirectChain chain;
+    LoopbackServer server([&chain](const std::string& head) { return chain(head); });
+    HttpClient client;
+    client.setFollowRedirects(true);
+
+    std::vector<FetchResult> results = client.fetchAll({get(server.url() + "a")}, 1);
+    ASSERT_EQ(results[0].error, "");
+    EXPECT_EQ(results[0].response.body, "final /c");
+    EXPECT_EQ(results[0].response.redirects, 2);
+    EXPECT_EQ(results[0].response.effectiveUrl, server.url() + "c");
+    EXPECT_EQ(server.connectionsAccepted(), 1u);
+    for (const auto& head : chain.heads) {
+        EXPECT_EQ(headerOf(head, "Connection"), "");
+    }
+}
+
+TEST(Redirects, ConcurrentFetchReconnectsAfterConnectionClose) {
+    RedirectChain chain;
+    chain.closeOn = "/a";
+    LoopbackServer server([&chain](const std::string& head) { return chain(head); });
+    HttpClient client;
+    client.setFollowRedirects(true);
+
+    std::vector<FetchResult> results = client.fetchAll({get(server.url() + "a")}, 1);
+    ASSERT_EQ(results[0].error, "");
+    EXPECT_EQ(results[0].response.body, "final /c");
+    EXPECT_EQ(server.connectionsAccepted(), 2u);
+}
+
+TEST(Redirects, ConcurrentFetchConnectsToEachOrigin) {
+    LoopbackServer target([](const std::string& head) { return makeResponse("200 OK", "", "at " + targetOf(head)); });
+    std::string location = target.url() + "landing";
+    LoopbackServer origin([&location](const std::string&) {
+        return makeResponse("307 Temporary Redirect", "Location: " + location + "\r\n", "");
+    });
+    HttpClient client;
+    client.setFollowRedirects(true);
+
+    std::vector<FetchResult> results = client.fetchAll({get(origin.url() + "start")}, 1);
+    ASSERT_EQ(results[0].error, "");
+    EXPECT_EQ(results[0].response.body, "at /landing");
+    EXPECT_EQ(origin.connectionsAccepted(), 1u);
+    EXPECT_EQ(target.connectionsAccepted(), 1u);
+}
+
+TEST(Redirects, ConcurrentFetchWithoutFollowingClosesConnections) {
+    RedirectChain chain;
+    LoopbackServer server([&chain](const std::string& head) { return chain(head); });
+    HttpClient client;
+
+    std::vector<FetchResult> results = client.fetchAll({get(server.url() + "a")}, 1);
+    ASSERT_EQ(results[0].error, "");
+    EXPECT_EQ(results[0].response.statusCode, 302);
+    EXPECT_EQ(headerOf(chain.heads.at(0), "Connection"), "close");
+}
+
+TEST(Redirects, BlockingRequestFollowsOnPooledConnection) {
+    RedirectChain chain;
+    LoopbackServer server([&chain](const std::string& head) { return chain(head); });
+    HttpClient client;
+    client.setFollowRedirects(true);
+
+    HttpResponse response = client.sendRequest(get(server.url() + "a"), false);
+    EXPECT_EQ(response.body, "final /c");
+    EXPECT_EQ(response.redirects, 2);
+    EXPECT_EQ(server.connectionsAccepted(), 1u);
+}
@@ -0,0 +1,148 @@
+#include "http_client.h"
+#include "resume_state.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const size_t bodySize = 256 << 10;
+
+/// @brief A resource that honours Range with If-Range. While `interrupt` is set, full responses
+/// are cut off after `cutAt` bytes of body, as if the connection dropped.
+struct ResumableResource {
+    std::string body = patternBody(bodySize);
+    std::string validatorHeaders = "ETag: \"v1\"\r\n";
+    std::string etag = "\"v1\"";
+    bool interrupt = true;
+    size_t cutAt = 100000;
+    std::mutex mutex;
+    std::vector<std::string> heads; ///< Every request head received.
+
+    std::string operator()(const std::string& head) {
+        std::lock_guard<std::mutex> lock(mutex);
+        heads.push_back(head);
+        std::string range = headerOf(head, "Range");
+        if (!range.empty() && headerOf(head, "If-Range") == etag) {
+            uint64_t first = std::strtoull(range.c_str() + 6, nullptr, 10);
+            std::string headers = validatorHeaders + "Content-Range: bytes " + std::to_string(first) + "-" +
+                                  std::to_string(body.size() - 1) + "/" + std::to_string(body.size()) + "\r\n";
+            return makeResponse("206 Partial Content", headers, body.substr(first));
+        }
+        std::string response = makeResponse("200 OK", validatorHeaders, body);
+        if (interrupt) {
+            // The close header makes the server drop the connection after the truncated response.
+            response = "HTTP/1.1 200 OK\r\nConnection: close\r\n" + response.substr(response.find("\r\n") + 2);
+            response.resize(response.size() - body.size() + cutAt);
+        }
+        return response;
+    }
+
+    std::string lastHead() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return heads.back();
+    }
+};
+
+HttpRequest download(const LoopbackServer& server, const std::string& path, const std::string& outputFile) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url() + path);
+    request.outputFile = outputFile;
+    return request;
+}
+
+} // namespace
+
+TEST(ResumeDownload, ContinuesWithRangeAndIfRange) {
+    TempDir dir;
+    ResumableResource resource;
+    LoopbackServer server([&resource](const std::string& head) { return resource(head); });
+    HttpClient client;
+    client.setResumeDownloads(true);
+    std::string out = dir.file("out");
+
+    EXPECT_THROW(client.downloadFile(download(server, "file", out), false), std::runtime_error);
+    EXPECT_EQ(readFile(out), resource.body.substr(0, resource.cutAt));
+    EXPECT_TRUE(fileExists(ResumeState::pathFor(out)));
+
+    resource.interrupt = false;
+    HttpResponse response = client.downloadFile(download(server, "file", out), false);
+    EXPECT_EQ(response.statusCode, 206);
+    EXPECT_EQ(headerOf(resource.lastHead(), "Range"), "bytes=" + std::to_string(resource.cutAt) + "-");
+    EXPECT_EQ(headerOf(resource.lastHead(), "If-Range"), "\"v1\"");
+    EXPECT_TRUE(readFile(out) == resource.body);
+    EXPECT_FALSE(fileExists(ResumeState::pathFor(out)));
+}
+
+TEST(ResumeDownload, RestartsWithoutResumeState) {
+    TempDir dir;
+    ResumableResource resource;
+    resource.interrupt = false;
+    LoopbackServer server([&resource](const std::string& head) { return resource(head); });
+    HttpClient client;
+    client.setResumeDownloads(true);
+    std::string out = dir.file("out");
+    writeFile(out, "bytes of some other download");
+
+    client.downloadFile(download(server, "file", out), false);
+    EXPECT_EQ(headerOf(resource.lastHead(), "Range"), "");
+    EXPECT_TRUE(readFile(out) == resource.body);
+}
+
+TEST(ResumeDownload, RestartsWhenStateIsForAnotherUrl) {
+    TempDir dir;
+    ResumableResource resource;
+    LoopbackServer server([&resource](const std::string& head) { return resource(head); });
+    HttpClient client;
+    client.setResumeDownloads(true);
+    std::string out = dir.file("out");
+
+    EXPECT_THROW(client.downloadFile(download(server, "one", out), false), std::runtime_error);
+    resource.interrupt = false;
+    client.downloadFile(download(server, "two", out), false);
+    EXPECT_EQ(headerOf(resource.lastHead(), "Range"), "");
+    EXPECT_TRUE(readFile(out) == resource.body);
+}
+
+TEST(ResumeDownload, RestartsWhenStateHasNoValidator) {
+    TempDir dir;
+    ResumableResource resource;
+    resource.validatorHeaders.clear();
+    LoopbackServer server([&resource](const std::string& head) { return resource(head); });
+    HttpClient client;
+    client.setResumeDownloads(true);
+    std::string out = dir.file("out");
+
+    EXPECT_THROW(client.downloadFile(download(server, "file", out), false), std::runtime_error);
+    resource.interrupt = false;
+    client.downloadFile(download(server, "file", out), false);
+    EXPECT_EQ(headerOf(resource.lastHead(), "Range"), "");
+    EXPECT_TRUE(readFile(out) == resource.body);
+}
+
+TEST(ResumeDownload, RestartsWhenResourceChanged) {
+    TempDir dir;
+    ResumableResource resource;
+    LoopbackServer server([&resource](const std::string& head) { return resource(head); });
+    HttpClient client;
+    client.setResumeDownloads(true);
+    std::string out = dir.file("out");
+
+    EXPECT_THROW(client.downloadFile(download(server, "file", out), false), std::runtime_error);
+    {
+        std::lock_guard<std::mutex> lock(resource.mutex);
+        resource.interrupt = false;
+        resource.etag = "\"v2\"";
+        resource.validatorHeaders = "ETag: \"v2\"\r\n";
+        resource.body = patternBody(bodySize + 1);
+    }
+    HttpResponse response = client.downloadFile(download(server, "file", out), false);
+    EXPECT_EQ(response.statusCode, 200);
+    EXPECT_EQ(headerOf(resource.lastHead(), "If-Range"), "\"v1\"");
+    EXPECT_TRUE(readFile(out) == resource.body);
+}
@@ -0,0 +1,142 @@
+#include "http_client.h"
+#include "resume_state.h"
+#include "url_parser.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t bodySize = 4 << 20;
+
+/// @brief Serves `body` with byte ranges. `shift` moves the start announced in Content-Range of every
+/// range that does not start at 0, as a misbehaving server would.
+LoopbackServer::Handler rangeServer(const std::string& body, std::atomic<int>& ranges, uint64_t shift = 0,
+                                    bool acceptRanges = true) {
+    return [&body, &ranges, shift, acceptRanges](const std::string& head) {
+        std::string headers = "ETag: \"v1\"\r\n";
+        if (acceptRanges) {
+            headers += "Accept-Ranges: bytes\r\n";
+        }
+        if (methodOf(head) == "HEAD") {
+            return makeResponse("200 OK", headers, body, true);
+        }
+        std::string range = headerOf(head, "Range");
+        if (range.empty() || headerOf(head, "If-Range") != "\"v1\"") {
+            return makeResponse("200 OK", headers, body);
+        }
+        ++ranges;
+        char* end;
+        uint64_t first = std::strtoull(range.c_str() + 6, &end, 10);
+        uint64_t last = std::strtoull(end + 1, nullptr, 10);
+        uint64_t announced = first == 0 ? 0 : first + shift;
+        headers += "Content-Range: bytes " + std::to_string(announced) + "-" + std::to_string(last) + "/" +
+                   std::to_string(body.size()) + "\r\n";
+        return makeResponse("206 Partial Content", headers, body.substr(first, last - first + 1));
+    };
+}
+
+HttpRequest download(const LoopbackServer& server, const std::string& outputFile) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url());
+    request.outputFile = outputFile;
+    return request;
+}
+
+} // namespace
+
+TEST(SegmentedDownload, WritesEveryRangeInPlace) {
+    TempDir dir;
+    std::string body = patternBody(bodySize);
+    std::atomic<int> ranges{0};
+    LoopbackServer server(rangeServer(body, ranges));
+    HttpClient client;
+    client.setDownloadSegments(4);
+
+    HttpResponse response = client.downloadFile(download(server, dir.file("out")), false);
+    EXPECT_EQ(response.bodyBytes, bodySize);
+    EXPECT_EQ(ranges, 4);
+    EXPECT_TRUE(readFile(dir.file("out")) == body);
+}
+
+TEST(SegmentedDownload, FileReachesFullSizeOnlyWhenComplete) {
+    TempDir dir;
+    std::string body = patternBody(bodySize);
+    std::atomic<int> ranges{0};
+    LoopbackServer::Handler serve = rangeServer(body, ranges);
+    // The last of four segments is held back until the test has looked at the partial file.
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::string lastRange = "bytes=" + std::to_string(bodySize * 3 / 4) + "-";
+    LoopbackServer server([&](const std::string& head) {
+        if (headerOf(head, "Range").compare(0, lastRange.size(), lastRange) == 0) {
+            released.wait_for(std::chrono::seconds(10));
+        }
+        return serve(head);
+    });
+    HttpClient client;
+    client.setDownloadSegments(4);
+
+    std::thread download([&] { client.downloadFile(::download(server, dir.file("out")), false); });
+    struct stat info{};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((stat(dir.file("out").c_str(), &info) != 0 || static_cast<uint64_t>(info.st_size) < bodySize * 3 / 4) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    uint64_t partialSize = static_cast<uint64_t>(info.st_size);
+    release.set_value();
+    download.join();
+    EXPECT_EQ(partialSize, bodySize * 3 / 4);
+    EXPECT_TRUE(readFile(dir.file("out")) == body);
+}
+
+TEST(SegmentedDownload, UsesOneStreamWithoutAcceptRanges) {
+    TempDir dir;
+    std::string body = patternBody(bodySize);
+    std::atomic<int> ranges{0};
+    LoopbackServer server(rangeServer(body, ranges, 0, false));
+    HttpClient client;
+    client.setDownloadSegments(4);
+
+    client.downloadFile(download(server, dir.file("out")), false);
+    EXPECT_EQ(ranges, 0);
+    EXPECT_TRUE(readFile(dir.file("out")) == body);
+}
+
+TEST(SegmentedDownload, RejectsMisplacedContentRange) {
+    TempDir dir;
+    std::string body = patternBody(bodySize);
+    std::atomic<int> ranges{0};
+    LoopbackServer server(rangeServer(body, ranges, 1));
+    HttpClient client;
+    client.setDownloadSegments(4);
+
+    EXPECT_THROW(client.downloadFile(download(server, dir.file("out")), false), std::runtime_error);
+    // Only the first segment arrived where it belongs; the file is cut back to it.
+    EXPECT_EQ(readFile(dir.file("out")), body.substr(0, bodySize / 4));
+    EXPECT_FALSE(fileExists(ResumeState::pathFor(dir.file("out"))));
+}
+
+TEST(SegmentedDownload, SavesResumeStateOnFailureWhenResuming) {
+    TempDir dir;
+    std::string body = patternBody(bodySize);
+    std::atomic<int> ranges{0};
+    LoopbackServer server(rangeServer(body, ranges, 1));
+    HttpClient client;
+    client.setDownloadSegments(4);
+    client.setResumeDownloads(true);
+
+    EXPECT_THROW(client.downloadFile(download(server, dir.file("out")), false), std::runtime_error);
+    ResumeState state;
+    ASSERT_TRUE(state.load(dir.file("out")));
+    EXPECT_EQ(state.validator, "\"v1\"");
+    EXPECT_EQ(state.totalSize, bodySize);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Helpers shared by the loopback tests: scripted responses for LoopbackServer and scratch files.
+
+/// @brief Returns the value of a request header in a request head, or an empty string if absent.
+inline std::string headerOf(const std::string& head, const std::string& name) {
+    size_t lineStart = head.find("\r\n");
+    while (lineStart != std::string::npos) {
+        lineStart += 2;
+        size_t lineEnd = head.find("\r\n", lineStart);
+        if (lineEnd == std::string::npos) {
+            break;
+        }
+        size_t colon = head.find(':', lineStart);
+        if (colon < lineEnd && colon - lineStart == name.size() &&
+            strncasecmp(head.c_str() + lineStart, name.c_str(), name.size()) == 0) {
+            size_t value = head.find_first_not_of(" \t", colon + 1);
+            return value < lineEnd ? head.substr(value, lineEnd - value) : std::string();
+        }
+        lineStart = lineEnd;
+    }
+    return std::string();
+}
+
+/// @brief Returns the method of a request head, e.g. "GET".
+inline std::string methodOf(const std::string& head) {
+    return head.substr(0, head.find(' '));
+}
+
+/// @brief Returns the request target of a request head, e.g. "/a".
+inline std::string targetOf(const std::string& head) {
+    size_t start = head.find(' ') + 1;
+    return head.substr(start, head.find(' ', start) - start);
+}
+
+/// @brief Builds a complete response with a Content-Length.
+/// @param status Status code and reason, e.g. "200 OK".
+/// @param headers Extra header lines, each ending in "\r\n".
+inline std::string makeResponse(const std::string& status, const std::string& headers, const std::string& body,
+                                bool headOnly = false) {
+    return "HTTP/1.1 " + status + "\r\n" + headers + "Content-Length: " + std::to_string(body.size()) +
+           "\r\n\r\n" + (headOnly ? std::string() : body);
+}
+
+/// @brief A scratch directory removed with its contents when the test ends.
+class TempDir {
+public:
+    TempDir() {
+        const char* base = std::getenv("TMPDIR");
+        std::string pattern = std::string(base ? base : "/tmp") + "/lurc_test_XXXXXX";
+        if (mkdtemp(&pattern[0]) == nullptr) {
+            throw std::runtime_error("Failed to create a temporary directory");
+        }
+        path = pattern;
+    }
+    ~TempDir() {
+        std::string command = "rm -rf '" + path + "'";
+        if (std::system(command.c_str()) != 0) {
+            // Leaving scratch files behind does not fail the test.
+        }
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    /// @brief Returns the path of a file in the directory.
+    std::string file(const std::string& name) const { return path + "/" + name; }
+
+    std::string path;
+};
+
+/// @brief Reads a whole file; returns an empty string if it cannot be opened.
+inline std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/// @brief Writes a whole file, replacing it.
+inline void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+}
+
+/// @brief Returns true if a file exists.
+inline bool fileExists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+/// @brief Returns a body of `size` bytes whose content depends on the offset, so misplaced ranges show.
+inline std::string patternBody(size_t size) {
+    std::string body(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        body[i] = static_cast<char>('a' + (i / 7 + i) % 26);
+    }
+    return body;
+}
@@ -0,0 +1,94 @@
+#include "http_client.h"
+#include "url_parser.h"
+#include "uring_transfer.h"
+#include "bench/loopback_server.h"
+#include "test_util.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+/// @brief Serves `body` at every path, with a Content-Length unless the target is /unsized, which
+/// closes the connection to end the body instead.
+LoopbackServer::Handler bodyServer(const std::string& body) {
+    return [body](const std::string& head) {
+        if (targetOf(head) == "/unsized") {
+            return "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + body;
+        }
+        return makeResponse("200 OK", "", body);
+    };
+}
+
+HttpRequest download(const LoopbackServer& server, const std::string& path, const std::string& out) {
+    HttpRequest request;
+    request.method = HttpMethod::GET;
+    request.url = UrlParser::parse(server.url() + path);
+    request.outputFile = out;
+    return request;
+}
+
+/// @brief Downloads with io_uring enabled and returns what the client printed.
+std::string verboseDownload(HttpClient& client, const HttpRequest& request) {
+    testing::internal::CaptureStdout();
+    try {
+        client.downloadFile(request, true);
+    } catch (...) {
+        testing::internal::GetCapturedStdout();
+        throw;
+    }
+    return testing::internal::GetCapturedStdout();
+}
+
+const char* uringNote = "* Receiving body with io_uring";
+
+} // namespace
+
+TEST(UringDownload, WritesTheExactBodyAndKeepsTheConnection) {
+    if (!uringAvailable()) {
+        GTEST_SKIP() << "io_uring is not available here";
+    }
+    // Several times the receive buffer ring, and not a multiple of a buffer.
+    std::string body = patternBody((3 << 20) + 1234);
+    LoopbackServer server(bodyServer(body));
+    TempDir dir;
+    HttpClient client;
+    client.setUringDownloads(true);
+
+    EXPECT_NE(verboseDownload(client, download(server, "first", dir.file("first"))).find(uringNote),
+              std::string::npos);
+    client.downloadFile(download(server, "second", dir.file("second")), false);
+    EXPECT_EQ(readFile(dir.file("first")), body);
+    EXPECT_EQ(readFile(dir.file("second")), body);
+    EXPECT_EQ(server.connectionsAccepted(), 1u);
+}
+
+TEST(UringDownload, ReadsAnUnsizedBodyUntilTheConnectionCloses) {
+    if (!uringAvailable()) {
+        GTEST_SKIP() << "io_uring is not available here";
+    }
+    std::string body = patternBody((1 << 20) + 77);
+    LoopbackServer server(bodyServer(body));
+    TempDir dir;
+    HttpClient client;
+    client.setUringDownloads(true);
+
+    EXPECT_NE(verboseDownload(client, download(server, "unsized", dir.file("out"))).find(uringNote),
+              std::string::npos);
+    EXPECT_EQ(readFile(dir.file("out")), body);
+}
+
+TEST(UringDownload, FallsBackToTheReadLoopWhenUnavailable) {
+    setenv("LURC_NO_IO_URING", "1", 1);
+    EXPECT_FALSE(uringAvailable());
+    std::string body = patternBody((2 << 20) + 99);
+    LoopbackServer server(bodyServer(body));
+    TempDir dir;
+    HttpClient client;
+    client.setUringDownloads(true);
+
+    std::string output = verboseDownload(client, download(server, "file", dir.file("out")));
+    unsetenv("LURC_NO_IO_URING");
+    EXPECT_EQ(output.find(uringNote), std::string::npos);
+    EXPECT_EQ(readFile(dir.file("out")), body);
+}
@@ -0,0 +1,162 @@
+//tls_session_cache.cpp
+
+#include "tls_session_cache.h"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+
+namespace {
+
+/// @brief Frees the origin string attached to an SSL object.
+void freeOrigin(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+    delete static_cast<std::string*>(ptr);
+}
+
+/// @brief Returns true if the session can still be offered to the server.
+bool isFresh(const SSL_SESSION* session) {
+    return SSL_SESSION_is_resumable(session) &&
+           SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) > std::time(nullptr);
+}
+
+} // namespace
+
+int TlsSessionCache::originIndex() {
+    static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, freeOrigin);
+    return index;
+}
+
+TlsSessionCache::TlsSessionCache(SSL_CTX* ctx) : ctx(ctx) {
+    // Sessions live in this cache, not in OpenSSL's internal one, so they can be keyed by origin.
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_set_app_data(ctx, this);
+    SSL_CTX_sess_set_new_cb(ctx, onNewSession);
+}
+
+TlsSessionCache::~TlsSessionCache() {
+    save();
+    SSL_CTX_sess_set_new_cb(ctx, nullptr);
+    SSL_CTX_set_app_data(ctx, nullptr);
+    for (auto& entry : sessions) {
+        SSL_SESSION_free(entry.second);
+    }
+}
+
+void TlsSessionCache::setSessionFile(const std::string& path) {
+    sessionFile = path;
+    load();
+}
+
+void TlsSessionCache::prepare(SSL* ssl, const std::string& origin) {
+    auto* cache = static_cast<TlsSessionCache*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (!cache) {
+        return;
+    }
+    SSL_set_ex_data(ssl, originIndex(), new std::string(origin));
+    SSL_SESSION* session = cache->lookup(origin);
+    if (session) {
+        SSL_set_session(ssl, session);
+        SSL_SESSION_free(session);
+    }
+}
+
+int TlsSessionCache::onNewSession(SSL* ssl, SSL_SESSION* session) {
+    auto* cache = static_cast<TlsSessionCache*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    auto* origin = static_cast<std::string*>(SSL_get_ex_data(ssl, originIndex()));
+    if (!cache || !origin) {
+        return 0;
+    }
+    cache->store(*origin, session);
+    return 1; // We keep the reference OpenSSL handed us.
+}
+
+void TlsSessionCache::store(const std::string& origin, SSL_SESSION* session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SSL_SESSION*& slot = sessions[origin];
+    if (slot) {
+        SSL_SESSION_free(slot);
+    }
+    slot = session;
+}
+
+SSL_SESSION* TlsSessionCache::lookup(const std::string& origin) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(origin);
+    if (it == sessions.end()) {
+        return nullptr;
+    }
+    if (!isFresh(it->second)) {
+        SSL_SESSION_free(it->second);
+        sessions.erase(it);
+        return nullptr;
+    }
+    SSL_SESSION_up_ref(it->second);
+    return it->second;
+}
+
+void TlsSessionCache::save() {
+    if (sessionFile.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // One "origin base64(DER)" line per session.
+    std::string contents;
+    for (const auto& entry : sessions) {
+        if (!isFresh(entry.second)) {
+            continue;
+        }
+        int length = i2d_SSL_SESSION(entry.second, nullptr);
+        if (length <= 0) {
+            continue;
+        }
+        std::vector<unsigned char> der(length);
+        unsigned char* out = der.data();
+        i2d_SSL_SESSION(entry.second, &out);
+        std::vector<unsigned char> encoded(4 * ((length + 2) / 3) + 1);
+        int encodedLength = EVP_EncodeBlock(encoded.data(), der.data(), length);
+        contents += entry.first + " " + std::string(reinterpret_cast<char*>(encoded.data()), encodedLength) + "\n";
+    }
+
+    std::string tmp = sessionFile + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return; // Persistence is an optimisation; never fail a request over it.
+    }
+    bool ok = write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size());
+    ok = close(fd) == 0 && ok;
+    if (ok) {
+        std::rename(tmp.c_str(), sessionFile.c_str());
+    } else {
+        std::remove(tmp.c_str());
+    }
+}
+
+void TlsSessionCache::load() {
+    std::ifstream in(sessionFile);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        std::string origin = line.substr(0, space);
+        std::string encoded = line.substr(space + 1);
+        std::vector<unsigned char> der(3 * (encoded.size() / 4) + 3);
+        int length = EVP_DecodeBlock(der.data(), reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size());
+        if (length <= 0) {
+            continue;
+        }
+        // EVP_DecodeBlock counts base64 padding as zero bytes; DER parsing ignores the excess.
+        const unsigned char* cursor = der.data();
+        SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &cursor, length);
+        if (session && isFresh(session)) {
+            store(origin, session);
+        } else if (session) {
+            SSL_SESSION_free(session);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+#include <openssl/ssl.h>
+
+/// @brief Client-side TLS session cache keyed by origin ("https://host:port").
+/// Installs itself on an SSL_CTX so that every session or TLS 1.3 ticket the server issues is kept,
+/// and offers the latest one on the next connection to the same origin, turning full handshakes
+/// into abbreviated ones. Sessions can optionally be persisted to a file so that separate runs
+/// resume as well. Thread-safe.
+class TlsSessionCache {
+public:
+    /// @brief Installs the cache on an SSL context. The cache must outlive every SSL made from it.
+    explicit TlsSessionCache(SSL_CTX* ctx);
+
+    /// @brief Saves the sessions to the session file (if one is set) and frees them.
+    ~TlsSessionCache();
+
+    TlsSessionCache(const TlsSessionCache&) = delete;
+    TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+    /// @brief Persists sessions in a file, loading whatever it already holds.
+    /// The file is written with owner-only permissions because it contains session secrets.
+    /// @param path The session file path.
+    void setSessionFile(const std::string& path);
+
+    /// @brief Writes all resumable sessions to the session file, if one is set.
+    void save();
+
+    /// @brief Prepares a new SSL object for a handshake with an origin: remembers the origin for
+    /// sessions issued on this connection and offers a cached session, if there is one.
+    /// Does nothing if no cache is installed on the SSL's context.
+    /// @param ssl The SSL object, before SSL_connect.
+    /// @param origin The origin key, e.g. from ConnectionPool::originKey().
+    static void prepare(SSL* ssl, const std::string& origin);
+
+private:
+    SSL_CTX* ctx;
+    std::map<std::string, SSL_SESSION*> sessions; ///< Latest session per origin, one reference held each.
+    std::string sessionFile;                      ///< Where sessions are persisted, empty for memory only.
+    std::mutex mutex;                             ///< Guards sessions.
+
+    /// @brief Stores a session issued by a server, replacing the previous one for the origin.
+    void store(const std::string& origin, SSL_SESSION* session);
+
+    /// @brief Returns a referenced session for the origin if one is still resumable, else nullptr.
+    SSL_SESSION* lookup(const std::string& origin);
+
+    /// @brief Reads sessions from the session file.
+    void load();
+
+    /// @brief OpenSSL new-session callback.
+    static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+    /// @brief Index of the SSL ex_data slot holding the origin of a connection.
+    static int originIndex();
+};
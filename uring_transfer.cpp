@@ -0,0 +1,438 @@
+//uring_transfer.cpp
+
+#include "uring_transfer.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef LURC_HAVE_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+/// @brief Number of receive buffers; the buffer ring needs a power of two.
+const unsigned bufferCount = 16;
+/// @brief Size of each receive buffer.
+const unsigned bufferSize = 64 << 10;
+/// @brief Submission queue size: one receive, a write per buffer and a cancel fit without waiting.
+const unsigned ringEntries = 64;
+/// @brief Buffer group the receive buffers are provided under.
+const uint16_t bufferGroup = 0;
+/// @brief user_data of the receive request; writes use their buffer id instead.
+const uint64_t recvTag = UINT64_MAX;
+/// @brief user_data of the request that cancels the receive.
+const uint64_t cancelTag = UINT64_MAX - 1;
+
+std::string errorText(int error) {
+    return std::string(strerror(error));
+}
+
+/// @brief A minimal io_uring instance: the submission and completion rings mapped from the kernel,
+/// driven with raw system calls.
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            throw std::runtime_error("io_uring_setup failed: " + errorText(errno));
+        }
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            close(fd);
+            throw std::runtime_error("io_uring is too old (no single mmap)");
+        }
+        ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMap = ring == MAP_FAILED ? MAP_FAILED
+            : mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqesMap == MAP_FAILED) {
+            int error = errno;
+            if (ring != MAP_FAILED) {
+                munmap(ring, ringSize);
+            }
+            close(fd);
+            throw std::runtime_error("Failed to map io_uring: " + errorText(error));
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesMap);
+
+        char* base = static_cast<char*>(ring);
+        sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        unsigned* sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        for (unsigned i = 0; i < sqEntries; ++i) {
+            sqArray[i] = i;
+        }
+        cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        localTail = *sqTail;
+    }
+
+    ~Ring() {
+        munmap(sqes, sqesSize);
+        munmap(ring, ringSize);
+        close(fd);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    /// @brief Returns a cleared submission entry, submitting the queued ones first if the queue is full.
+    io_uring_sqe* nextSqe() {
+        if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+            submitAndWait(0);
+        }
+        io_uring_sqe* sqe = &sqes[localTail & sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        ++localTail;
+        ++queued;
+        return sqe;
+    }
+
+    /// @brief Submits the queued entries and waits until at least `count` completions are available,
+    /// all in one system call.
+    void submitAndWait(unsigned count) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (queued > 0 || count > 0) {
+            long submitted = syscall(__NR_io_uring_enter, fd, queued, count, count > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                     nullptr, 0);
+            if (submitted < 0 && errno == EINTR) {
+                continue;
+            }
+            if (submitted < 0) {
+                throw std::runtime_error("io_uring_enter failed: " + errorText(errno));
+            }
+            queued -= static_cast<unsigned>(submitted);
+            count = 0;
+        }
+    }
+
+    /// @brief Takes the next completion, if any.
+    bool nextCompletion(io_uring_cqe& cqe) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /// @brief Calls io_uring_register.
+    /// @throws std::runtime_error if the kernel refuses.
+    void registerObject(unsigned opcode, const void* arg, unsigned count, const char* what) {
+        if (syscall(__NR_io_uring_register, fd, opcode, arg, count) < 0) {
+            throw std::runtime_error(std::string("Failed to register io_uring ") + what + ": " + errorText(errno));
+        }
+    }
+
+private:
+    int fd;
+    void* ring;
+    size_t ringSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned localTail;      ///< Tail including entries not yet published to the kernel.
+    unsigned queued = 0;     ///< Entries filled in but not yet submitted.
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+};
+
+/// @brief Anonymous memory mapping released on scope exit.
+struct Mapping {
+    void* data;
+    size_t size;
+
+    explicit Mapping(size_t size) : size(size) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Failed to allocate io_uring buffers: " + errorText(errno));
+        }
+    }
+    ~Mapping() { munmap(data, size); }
+
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+};
+
+/// @brief One socket-to-file transfer. The receive buffers live in one arena that is both the
+/// provided buffer ring's memory (for receives) and a registered fixed buffer (for writes).
+class Transfer {
+public:
+    Transfer() : ring(ringEntries), arena(bufferCount * bufferSize),
+                 bufferRing(std::max<size_t>(bufferCount * sizeof(io_uring_buf), sysconf(_SC_PAGESIZE))) {
+        iovec whole{arena.data, arena.size};
+        ring.registerObject(IORING_REGISTER_BUFFERS, &whole, 1, "buffers");
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing.data);
+        reg.ring_entries = bufferCount;
+        reg.bgid = bufferGroup;
+        ring.registerObject(IORING_REGISTER_PBUF_RING, &reg, 1, "buffer ring");
+        provided = static_cast<io_uring_buf_ring*>(bufferRing.data);
+        slots.resize(bufferCount);
+        for (uint16_t id = 0; id < bufferCount; ++id) {
+            idle.push_back(id);
+        }
+    }
+
+    /// @brief Waits for the requests still in flight, so the kernel is done with the buffers
+    /// before they are unmapped.
+    ~Transfer() {
+        try {
+            if (recvArmed && !cancelSent) {
+                cancelRecv();
+            }
+            io_uring_cqe cqe;
+            while (recvArmed || writesInFlight > 0) {
+                ring.submitAndWait(1);
+                while (ring.nextCompletion(cqe)) {
+                    if (cqe.user_data == recvTag) {
+                        recvArmed = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                    } else if (cqe.user_data < bufferCount) {
+                        --writesInFlight;
+                    }
+                }
+            }
+        } catch (const std::exception&) {
+            // The ring is closed next, which cancels whatever is left.
+        }
+    }
+
+    Transfer(const Transfer&) = delete;
+    Transfer& operator=(const Transfer&) = delete;
+
+    uint64_t run(int sock, int fd, int64_t length) {
+        off_t start = lseek(fd, 0, SEEK_CUR);
+        if (start < 0) {
+            throw std::runtime_error("Output file is not seekable: " + errorText(errno));
+        }
+        this->sock = sock;
+        this->fd = fd;
+        this->length = length;
+        fileOffset = static_cast<uint64_t>(start);
+
+        refill();
+        armRecv();
+        io_uring_cqe cqe;
+        while (!finished() || recvArmed || writesInFlight > 0) {
+            ring.submitAndWait(1);
+            while (ring.nextCompletion(cqe)) {
+                if (cqe.user_data == recvTag) {
+                    onReceived(cqe);
+                } else if (cqe.user_data < bufferCount) {
+                    onWritten(static_cast<uint16_t>(cqe.user_data), cqe.res);
+                }
+            }
+            refill();
+            if (finished()) {
+                if (recvArmed && !cancelSent) {
+                    cancelRecv();
+                }
+            } else if (!recvArmed && inRing > 0) {
+                armRecv();
+            }
+        }
+        if (length >= 0 && received < static_cast<uint64_t>(length)) {
+            throw std::runtime_error("Connection closed before the response body was complete");
+        }
+        if (lseek(fd, static_cast<off_t>(fileOffset), SEEK_SET) < 0) {
+            throw std::runtime_error("Failed to seek output file: " + errorText(errno));
+        }
+        return received;
+    }
+
+private:
+    /// @brief A receive buffer's progress through a write.
+    struct Slot {
+        uint32_t ringLength = 0;  ///< Length the buffer was provided with.
+        uint32_t written = 0;     ///< Bytes of the received data already in the file.
+        uint32_t filled = 0;      ///< Bytes received into the buffer.
+        uint64_t offset = 0;      ///< File offset of the buffer's first byte.
+    };
+
+    Ring ring;
+    Mapping arena;
+    Mapping bufferRing;
+    io_uring_buf_ring* provided;
+    uint16_t providedTail = 0;
+    std::vector<Slot> slots;
+    std::vector<uint16_t> idle;   ///< Buffers neither in the ring nor being written.
+    uint64_t inRing = 0;          ///< Total length of the buffers the kernel may receive into.
+    int sock = -1;
+    int fd = -1;
+    int64_t length = -1;
+    uint64_t received = 0;
+    uint64_t fileOffset = 0;
+    unsigned writesInFlight = 0;
+    bool recvArmed = false;
+    bool multishot = true;
+    bool cancelSent = false;
+    bool closed = false;
+
+    bool finished() const {
+        return closed || (length >= 0 && received == static_cast<uint64_t>(length));
+    }
+
+    /// @brief Hands idle buffers back to the kernel. For a known length the buffers offered never add up
+    /// to more than what is still expected, so the kernel cannot read into the next response.
+    void refill() {
+        while (!idle.empty()) {
+            uint32_t size = bufferSize;
+            if (length >= 0) {
+                uint64_t room = static_cast<uint64_t>(length) - received - inRing;
+                if (room == 0) {
+                    break;
+                }
+                size = static_cast<uint32_t>(std::min<uint64_t>(size, room));
+            }
+            uint16_t id = idle.back();
+            idle.pop_back();
+            slots[id].ringLength = size;
+            // Not provided->bufs: in C++ the header's flexible array member does not start at offset 0.
+            io_uring_buf* entry = static_cast<io_uring_buf*>(bufferRing.data) + (providedTail & (bufferCount - 1));
+            entry->addr = reinterpret_cast<uint64_t>(static_cast<char*>(arena.data) + id * bufferSize);
+            entry->len = size;
+            entry->bid = id;
+            ++providedTail;
+            inRing += size;
+        }
+        __atomic_store_n(&provided->tail, providedTail, __ATOMIC_RELEASE);
+    }
+
+    void armRecv() {
+        io_uring_sqe* sqe = ring.nextSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sock;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bufferGroup;
+        sqe->ioprio = multishot ? IORING_RECV_MULTISHOT : 0;
+        sqe->user_data = recvTag;
+        recvArmed = true;
+    }
+
+    void cancelRecv() {
+        io_uring_sqe* sqe = ring.nextSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = recvTag;
+        sqe->user_data = cancelTag;
+        cancelSent = true;
+    }
+
+    void submitWrite(uint16_t id) {
+        const Slot& slot = slots[id];
+        io_uring_sqe* sqe = ring.nextSqe();
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(static_cast<char*>(arena.data) + id * bufferSize + slot.written);
+        sqe->len = slot.filled - slot.written;
+        sqe->off = slot.offset + slot.written;
+        sqe->buf_index = 0;
+        sqe->user_data = id;
+    }
+
+    void onReceived(const io_uring_cqe& cqe) {
+        recvArmed = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            inRing -= slots[id].ringLength;
+            if (cqe.res > 0) {
+                Slot& slot = slots[id];
+                slot.filled = static_cast<uint32_t>(cqe.res);
+                slot.written = 0;
+                slot.offset = fileOffset;
+                fileOffset += static_cast<uint64_t>(cqe.res);
+                received += static_cast<uint64_t>(cqe.res);
+                submitWrite(id);
+                ++writesInFlight;
+                return;
+            }
+            idle.push_back(id);
+        }
+        if (cqe.res == 0) {
+            closed = true;
+        } else if (cqe.res == -EINVAL && multishot && received == 0) {
+            // Kernels before 6.0 have provided buffer rings but no multishot receive.
+            multishot = false;
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -EINTR) {
+            throw std::runtime_error("Failed to receive response: " + errorText(-cqe.res));
+        }
+    }
+
+    void onWritten(uint16_t id, int result) {
+        Slot& slot = slots[id];
+        if (result <= 0) {
+            --writesInFlight;
+            throw std::runtime_error("Failed to write output file: " + errorText(result < 0 ? -result : ENOSPC));
+        }
+        slot.written += static_cast<uint32_t>(result);
+        if (slot.written < slot.filled) {
+            submitWrite(id);
+            return;
+        }
+        --writesInFlight;
+        idle.push_back(id);
+    }
+};
+
+/// @brief Returns true if LURC_NO_IO_URING is set to a non-empty value.
+bool disabledByEnvironment() {
+    const char* value = std::getenv("LURC_NO_IO_URING");
+    return value != nullptr && *value != '\0';
+}
+
+} // namespace
+
+bool uringAvailable() {
+    if (disabledByEnvironment()) {
+        return false;
+    }
+    static const bool available = [] {
+        try {
+            Transfer probe;
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }();
+    return available;
+}
+
+uint64_t uringSocketToFile(int sock, int fd, int64_t length) {
+    Transfer transfer;
+    return transfer.run(sock, fd, length);
+}
+
+#else
+
+bool uringAvailable() {
+    return false;
+}
+
+uint64_t uringSocketToFile(int, int, int64_t) {
+    throw std::runtime_error("io_uring support was not built in");
+}
+
+#endif
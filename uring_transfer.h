@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+/// @brief Returns true if the running kernel supports everything uringSocketToFile() needs
+/// (io_uring with provided buffer rings). The kernel check runs once per process; setting the
+/// environment variable LURC_NO_IO_URING to a non-empty value makes this return false.
+bool uringAvailable();
+
+/// @brief Moves bytes from a socket into a file with io_uring. Receives are multishot into a ring of
+/// kernel-provided buffers that are also registered for fixed-buffer file writes, and every wait
+/// submits all pending writes and re-arms in one io_uring_enter, so the transfer takes far fewer
+/// system calls than a recv/write loop. Never reads past `length` bytes from the socket.
+/// @param sock The source socket; bytes already read from it are not included.
+/// @param fd The destination regular file, written from its current offset, which is advanced past the data.
+/// @param length Number of bytes to move, or -1 to move everything until the peer closes the connection.
+/// @return The number of bytes moved.
+/// @throws std::runtime_error on I/O errors, if the ring cannot be set up, or if the connection closes
+/// before `length` bytes arrived.
+uint64_t uringSocketToFile(int sock, int fd, int64_t length);
@@ -1,70 +1,280 @@
 #include "url_parser.h"
-#include <regex>
+#include <cctype>
 #include <stdexcept>
 #include <limits>
+#include <strings.h>
+#include <vector>
+
+
+namespace {
+
+/// @brief Returns true for characters that may never appear in a URL (controls and space).
+bool isForbidden(char c) {
+    return static_cast<unsigned char>(c) <= 0x20 || c == 0x7f;
+}
+
+bool isHexDigit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+int hexValue(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+/// @brief Decodes %XX escapes; malformed escapes are kept as they are.
+std::string percentDecode(std::string_view text) {
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() && isHexDigit(text[i + 1]) && isHexDigit(text[i + 2])) {
+            decoded.push_back(static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+            i += 2;
+        } else {
+            decoded.push_back(text[i]);
+        }
+    }
+    return decoded;
+}
+
+[[noreturn]] void invalidUrl() {
+    throw std::runtime_error("INVALID URL FORMAT!");
+}
+
+/// @brief Removes "." and ".." segments from an absolute path.
+std::string removeDotSegments(std::string_view path) {
+    std::vector<std::string_view> segments;
+    size_t pos = 1;
+    while (true) {
+        size_t end = path.find('/', pos);
+        bool last = end == std::string_view::npos;
+        std::string_view segment = path.substr(pos, last ? std::string_view::npos : end - pos);
+        if (segment == "..") {
+            if (!segments.empty()) {
+                segments.pop_back();
+            }
+        } else if (segment != ".") {
+            segments.push_back(segment);
+        }
+        if (last) {
+            // A trailing "." or ".." still names a directory.
+            if (segment == "." || segment == "..") {
+                segments.push_back(std::string_view());
+            }
+            break;
+        }
+        pos = end + 1;
+    }
+    std::string result;
+    for (std::string_view segment : segments) {
+        result += '/';
+        result.append(segment);
+    }
+    return result.empty() ? "/" : result;
+}
+
+} // namespace
 
 
 ///This can probably be improved by making a enum of existing/supported protocols. and map them to each other than assuming port exists in our map.
 ///Should add a precheck in protocol only before getting and validating port.
 
 /// @brief Validates and converts a protocol string to a uint16_t value i.e the default port.
-/// @param protocol The port string from the URL.
+/// @param protocol The port string from the URL, matched case-insensitively.
 /// @return The default port `[HTTP:80]` or `[HTTPS:443]`against the given string
 /// @throws runtime_error if the port number is not a default port of an existing protocol
-std::uint16_t UrlParser::getDefaultPort(const std::string & protocol) {
-    // Use the `find` method to safely access the port number associated with the protocol.
-    auto it = protocolToPort.find(protocol);
-    if (it != protocolToPort.end()) {
-        return it->second;
+std::uint16_t UrlParser::getDefaultPort(std::string_view protocol) {
+    // Compare without building a key string; the map only holds a couple of entries.
+    for (const auto& entry : protocolToPort) {
+        if (entry.first.size() == protocol.size() &&
+            strncasecmp(entry.first.data(), protocol.data(), protocol.size()) == 0) {
+            return entry.second;
+        }
     }
-    // Return a default port value if the protocol is not found.
-    throw std::runtime_error("Unknown protocol: " + protocol);
+    throw std::runtime_error("Unknown protocol: " + std::string(protocol));
 }
 
 /// @brief Validates and converts a port string to a uint16_t value.
 /// @param portStr The port string from the URL.
 /// @return The validated port number or the default port (80)/(443) if the string is empty.
 /// @throws runtime_error if the port number is invalid or out of range.
-uint16_t UrlParser::validatePort(const std::string &protocol, const std::string& portStr) {
+uint16_t UrlParser::validatePort(std::string_view protocol, std::string_view portStr) {
+    uint16_t defaultPort = getDefaultPort(protocol);
     if (portStr.empty()) {
-        return getDefaultPort(protocol);  // Default port of that protocl
+        return defaultPort;  // Default port of that protocl
+    }
+
+    unsigned long port = 0;
+    for (char c : portStr) {
+        if (c < '0' || c > '9' || port > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Invalid port number: " + std::string(portStr));
+        }
+        port = port * 10 + static_cast<unsigned long>(c - '0');
+    }
+    if (port > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("Invalid port number: " + std::string(portStr));
+    }
+    return static_cast<uint16_t>(port);
+}
+
+/// @brief Splits the URL in one left-to-right pass:
+/// protocol "://" [userinfo "@"] host [":" port] [path] ["?" query] ["#" fragment]
+UrlView UrlParser::parseView(std::string_view url) {
+    UrlView view;
+    for (char c : url) {
+        if (isForbidden(c)) {
+            invalidUrl();
+        }
+    }
+
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string_view::npos || schemeEnd == 0) {
+        invalidUrl();
+    }
+    view.protocol = url.substr(0, schemeEnd);
+
+    // The authority runs up to the first '/', '?' or '#'.
+    size_t authorityStart = schemeEnd + 3;
+    size_t authorityEnd = url.find_first_of("/?#", authorityStart);
+    if (authorityEnd == std::string_view::npos) {
+        authorityEnd = url.size();
+    }
+    std::string_view authority = url.substr(authorityStart, authorityEnd - authorityStart);
+
+    size_t at = authority.rfind('@');
+    if (at != std::string_view::npos) {
+        view.userinfo = authority.substr(0, at);
+        authority.remove_prefix(at + 1);
     }
 
-    try {
-        long port = std::stol(portStr);
-        if (port < 0 || port > std::numeric_limits<uint16_t>::max()) {
-            throw std::out_of_range("Port number out of range");
+    std::string_view portStr;
+    if (!authority.empty() && authority.front() == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string_view::npos) {
+            invalidUrl();
+        }
+        view.host = authority.substr(1, close - 1);
+        view.ipv6 = true;
+        for (char c : view.host) {
+            if (!isHexDigit(c) && c != ':' && c != '.') {
+                invalidUrl();
+            }
+        }
+        std::string_view rest = authority.substr(close + 1);
+        if (!rest.empty()) {
+            if (rest.front() != ':') {
+                invalidUrl();
+            }
+            portStr = rest.substr(1);
         }
-        return static_cast<uint16_t>(port);
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Invalid port number: " + portStr);
+    } else {
+        size_t colon = authority.find(':');
+        view.host = authority.substr(0, colon);
+        if (colon != std::string_view::npos) {
+            portStr = authority.substr(colon + 1);
+        }
+        if (view.host.find_first_of("[]@") != std::string_view::npos) {
+            invalidUrl();
+        }
+    }
+    if (view.host.empty()) {
+        invalidUrl();
     }
+    view.port = validatePort(view.protocol, portStr);
+
+    std::string_view rest = url.substr(authorityEnd);
+    size_t hash = rest.find('#');
+    if (hash != std::string_view::npos) {
+        view.fragment = rest.substr(hash + 1);
+        rest = rest.substr(0, hash);
+    }
+    size_t question = rest.find('?');
+    if (question != std::string_view::npos) {
+        view.query = rest.substr(question + 1);
+        rest = rest.substr(0, question);
+    }
+    view.path = rest.empty() ? std::string_view("/") : rest;
+    return view;
 }
 
 /// @brief Parses the given URL and extracts its components.
 /// @param url The URL string to parse.
-/// @return A ParsedUrl struct containing the protocol, host, port, and path.
+/// @return A ParsedUrl struct containing the protocol, host, port, path, query, fragment and userinfo.
 /// @throws runtime_error if the URL format is invalid.
 ParsedUrl UrlParser::parse(const std::string& url) {
+    UrlView view = parseView(url);
     ParsedUrl result;
-    //change the regex for https
-    std::regex urlRegex("(https?)://([^/ :]+):?([^/ ]*)(/?[^ #?]*)");
-    std::smatch match;
-
-    if (std::regex_match(url, match, urlRegex)) {
-        result.protocol = match[1];
-        result.host = match[2];
-        result.port = validatePort(result.protocol,match[3]);
-        //Can be made into a ternary operation! TODO!
-        if(match[4].length() == 0) {
-            result.path = "/";
-        }
-        else {
-            result.path = match[4];
+    // Schemes and host names are case-insensitive; store them lowercase so they make stable pool keys.
+    result.protocol.assign(view.protocol);
+    for (char& c : result.protocol) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    result.host.assign(view.host);
+    for (char& c : result.host) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    result.port = view.port;
+    result.path.assign(view.path);
+    result.query.assign(view.query);
+    result.fragment.assign(view.fragment);
+    if (!view.userinfo.empty()) {
+        result.userinfo = percentDecode(view.userinfo);
+    }
+    return result;
+}
+
+ParsedUrl UrlParser::resolve(const ParsedUrl& base, const std::string& reference) {
+    size_t schemeEnd = reference.find("://");
+    if (schemeEnd != std::string::npos && reference.find_first_of("/?#") > schemeEnd) {
+        return parse(reference);
+    }
+    if (reference.compare(0, 2, "//") == 0) {
+        return parse(base.protocol + ":" + reference);
+    }
+    for (char c : reference) {
+        if (isForbidden(c)) {
+            invalidUrl();
         }
-    } else {
-        throw std::runtime_error("INVALID URL FORMAT!");
     }
 
+    ParsedUrl result = base;
+    std::string_view rest(reference);
+    size_t hash = rest.find('#');
+    if (hash != std::string_view::npos) {
+        result.fragment.assign(rest.substr(hash + 1));
+        rest = rest.substr(0, hash);
+    }
+    size_t question = rest.find('?');
+    std::string_view path = rest.substr(0, question);
+    if (question != std::string_view::npos) {
+        result.query.assign(rest.substr(question + 1));
+    } else if (!path.empty()) {
+        result.query.clear();
+    }
+    if (!path.empty()) {
+        if (path.front() == '/') {
+            result.path = removeDotSegments(path);
+        } else {
+            std::string merged = base.path.substr(0, base.path.rfind('/') + 1);
+            merged.append(path);
+            result.path = removeDotSegments(merged);
+        }
+    }
     return result;
 }
+
+std::string ParsedUrl::target() const {
+    return query.empty() ? path : path + "?" + query;
+}
+
+std::string ParsedUrl::authority() const {
+    std::string value = host.find(':') != std::string::npos ? "[" + host + "]" : host;
+    auto it = protocolToPort.find(protocol);
+    if (it == protocolToPort.end() || it->second != port) {
+        value += ":" + std::to_string(port);
+    }
+    return value;
+}
+
+std::string ParsedUrl::toString() const {
+    return protocol + "://" + authority() + target();
+}
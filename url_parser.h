@@ -1,5 +1,7 @@
     #pragma once
+    #include <cstdint>
     #include <string>
+    #include <string_view>
     #include <map>
 
 
@@ -10,16 +12,45 @@
         {"https",443}
     };
 
+    /// @brief Non-owning view of a URL split into its components.
+    /// Every member refers into the string given to UrlParser::parseView(), which must outlive the view.
+    struct UrlView {
+        std::string_view protocol; ///< Scheme as written, e.g. "https".
+        std::string_view userinfo; ///< "user:password" before the '@', still percent-encoded; empty if absent.
+        std::string_view host;     ///< Host name or IP address; IPv6 literals without the brackets.
+        uint16_t port = 0;         ///< Explicit port, or the protocol's default port.
+        std::string_view path;     ///< Path, "/" if the URL has none.
+        std::string_view query;    ///< Query without the leading '?'.
+        std::string_view fragment; ///< Fragment without the leading '#'.
+        bool ipv6 = false;         ///< The host was a bracketed IPv6 literal.
+    };
+
     /// @brief Struct representing a parsed URL.
-    /// @param protocol The protocol used, expected to be HTTP.
-    /// @param host The hostname or domain of the URL.
+    /// @param protocol The protocol used, "http" or "https".
+    /// @param host The hostname or domain of the URL (IPv6 literals without brackets).
     /// @param port The port number, defaulting to 80 for HTTP if not specified.
     /// @param path The path component of the URL.
+    /// @param query The query component, without the leading '?'.
+    /// @param fragment The fragment, without the leading '#'. It is never sent to the server.
+    /// @param userinfo The percent-decoded "user:password" part, empty if absent.
     struct ParsedUrl {
         std::string protocol;
         std::string host;
         uint16_t port;
         std::string path;
+        std::string query;
+        std::string fragment;
+        std::string userinfo;
+
+        /// @brief Returns the request target sent on the request line: the path plus "?query" if any.
+        std::string target() const;
+
+        /// @brief Returns the value for the Host header: the host (bracketed if IPv6) and the port
+        /// unless it is the protocol's default.
+        std::string authority() const;
+
+        /// @brief Returns the URL as a string, without userinfo or fragment.
+        std::string toString() const;
     };
 
     class UrlParser {
@@ -29,11 +60,26 @@
         /// @return A ParsedUrl struct containing the parsed URL components.
         static ParsedUrl parse(const std::string& url);
 
+        /// @brief Splits a URL into its components without copying or allocating.
+        /// @param url The URL to parse; the returned view points into it.
+        /// @return The components of the URL.
+        /// @throws runtime_error if the URL is malformed or its protocol or port is invalid.
+        static UrlView parseView(std::string_view url);
+
+        /// @brief Resolves a URL reference, such as a Location header, against a base URL (RFC 3986 section 5).
+        /// Absolute references are parsed as they are; relative ones take the base's protocol, userinfo, host
+        /// and port, with "." and ".." path segments removed. A reference without a fragment keeps the base's.
+        /// @param base The URL the reference appeared in.
+        /// @param reference The absolute or relative reference.
+        /// @return The resolved URL.
+        /// @throws runtime_error if the resulting URL is malformed.
+        static ParsedUrl resolve(const ParsedUrl& base, const std::string& reference);
+
     private:
         /// @brief Validates the port string and converts it to a port number.
         /// @param portStr The string representation of the port.
         /// @return A valid port number (uint16_t).
         /// @throws runtime_error if the port is out of range or invalid.
-        static uint16_t getDefaultPort(const std::string& protocol);
-        static uint16_t validatePort(const std::string& protocol,const std::string& portStr);
+        static uint16_t getDefaultPort(std::string_view protocol);
+        static uint16_t validatePort(std::string_view protocol, std::string_view portStr);
     };
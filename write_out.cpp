@@ -0,0 +1,111 @@
+//write_out.cpp
+
+#include "write_out.h"
+#include "json.h"
+#include <cstdio>
+
+namespace {
+
+/// @brief Formats a duration in seconds with microsecond precision, like curl.
+std::string seconds(std::chrono::microseconds value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.6f", value.count() / 1e6);
+    return text;
+}
+
+std::string speed(const HttpResponse& response) {
+    double total = response.timing.total.count() / 1e6;
+    char text[32];
+    snprintf(text, sizeof(text), "%.0f", total > 0 ? response.bodyBytes / total : 0.0);
+    return text;
+}
+
+/// @brief Looks up one write-out variable.
+/// @return False if the variable is unknown.
+bool variable(const std::string& name, const HttpResponse& response, const std::string& url, std::string& value) {
+    const TransferTiming& timing = response.timing;
+    if (name == "http_code" || name == "response_code") {
+        char code[8];
+        snprintf(code, sizeof(code), "%03d", response.statusCode);
+        value = code;
+    } else if (name == "url") {
+        value = url;
+    } else if (name == "url_effective") {
+        value = response.effectiveUrl.empty() ? url : response.effectiveUrl;
+    } else if (name == "num_redirects") {
+        value = std::to_string(response.redirects);
+    } else if (name == "size_download") {
+        value = std::to_string(response.bodyBytes);
+    } else if (name == "speed_download") {
+        value = speed(response);
+    } else if (name == "num_connects") {
+        value = timing.connectionReused ? "0" : "1";
+    } else if (name == "time_namelookup") {
+        value = seconds(timing.nameLookup);
+    } else if (name == "time_connect") {
+        value = seconds(timing.connect);
+    } else if (name == "time_appconnect") {
+        value = seconds(timing.tlsHandshake);
+    } else if (name == "time_pretransfer") {
+        value = seconds(timing.requestSent);
+    } else if (name == "time_starttransfer") {
+        value = seconds(timing.firstByte);
+    } else if (name == "time_total") {
+        value = seconds(timing.total);
+    } else if (name == "json") {
+        value = writeOutJson(response, url);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string writeOutJson(const HttpResponse& response, const std::string& url) {
+    const TransferTiming& timing = response.timing;
+    return "{\"url_effective\":" + jsonQuote(response.effectiveUrl.empty() ? url : response.effectiveUrl) +
+           ",\"http_code\":" + std::to_string(response.statusCode) +
+           ",\"size_download\":" + std::to_string(response.bodyBytes) +
+           ",\"speed_download\":" + speed(response) +
+           ",\"num_connects\":" + (timing.connectionReused ? "0" : "1") +
+           ",\"num_redirects\":" + std::to_string(response.redirects) +
+           ",\"time_namelookup\":" + seconds(timing.nameLookup) +
+           ",\"time_connect\":" + seconds(timing.connect) +
+           ",\"time_appconnect\":" + seconds(timing.tlsHandshake) +
+           ",\"time_pretransfer\":" + seconds(timing.requestSent) +
+           ",\"time_starttransfer\":" + seconds(timing.firstByte) +
+           ",\"time_total\":" + seconds(timing.total) + "}";
+}
+
+std::string formatWriteOut(const std::string& format, const HttpResponse& response, const std::string& url) {
+    std::string out;
+    for (size_t i = 0; i < format.size(); ++i) {
+        char c = format[i];
+        if (c == '\\' && i + 1 < format.size()) {
+            char next = format[i + 1];
+            if (next == 'n' || next == 'r' || next == 't' || next == '\\') {
+                out.push_back(next == 'n' ? '\n' : next == 'r' ? '\r' : next == 't' ? '\t' : '\\');
+                ++i;
+                continue;
+            }
+        } else if (c == '%' && i + 1 < format.size()) {
+            if (format[i + 1] == '%') {
+                out.push_back('%');
+                ++i;
+                continue;
+            }
+            size_t close = format.find('}', i + 2);
+            if (format[i + 1] == '{' && close != std::string::npos) {
+                std::string value;
+                if (variable(format.substr(i + 2, close - i - 2), response, url, value)) {
+                    out += value;
+                    i = close;
+                    continue;
+                }
+            }
+        }
+        out.push_back(c);
+    }
+    return out;
+}
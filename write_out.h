@@ -0,0 +1,19 @@
+#pragma once
+#include "http_client.h"
+#include <string>
+
+/// @brief Expands a curl-style `-w` format string for a finished request.
+/// `%{name}` is replaced by the variable's value and `\n`, `\r`, `\t` and `\\` by the characters they
+/// name; `%%` is a literal '%'. Times are in seconds from the start of the request. Supported
+/// variables: http_code (or response_code), url, url_effective (the final URL after redirects),
+/// size_download, speed_download, num_connects, num_redirects, time_namelookup, time_connect, time_appconnect, time_pretransfer,
+/// time_starttransfer, time_total and json (all of the above as a JSON object).
+/// Unknown variables are left as they are.
+/// @param format The format string.
+/// @param response The response, with its timing and byte count.
+/// @param url The URL the request went to.
+/// @return The expanded text.
+std::string formatWriteOut(const std::string& format, const HttpResponse& response, const std::string& url);
+
+/// @brief Formats every write-out variable of a request as a single-line JSON object.
+std::string writeOutJson(const HttpResponse& response, const std::string& url);